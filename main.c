@@ -14,9 +14,8 @@
 	vvLexer *lex = vv_newLexer( src, ".", VV_CHAR_BUFFER_DEFAULT_LEN, tbl );
 	vvParser *par = vv_newParser( lex );
 
-	vvSyntaxContainer *stmt = vv_newSyntaxContainer( );
+	vvSyntaxContainer *stmt = vv_newSyntaxContainer( par );
 	parseStatement( par, stmt );
-	vv_freeSyntaxContainer( stmt );
 
 	vv_freeParser( par );
 	vv_freeLexer( lex );
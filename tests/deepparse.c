@@ -0,0 +1,186 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Times the explicit-stack parser against the recursive one on ordinary code,
+both must build the same tree. Then parses inputs nested a million levels
+deep in explicit mode: parentheses, unary chains, blocks, calls and when
+branches. The recursive path needs a few C frames a level and overflows the
+default stack long before that; outside Windows a child process runs one of
+them recursively to show that it still would.
+
+	cc -O2 -I. tests/deepparse.c vvparser.c vvopt.c vvop.c vvlex.c vvcom.c vvscan.c vvthread.c -lm -lpthread
+*/
+
+#include "vvparser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#define FLAT_STMTS 200000
+#define DEPTH 1000000
+#define RUNS 3
+
+static double now( )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// the tree of src, NULL on an error
+static vvSyntaxTree *parse( char *src, int explicitStack, double *time )
+{
+	vvLexTable *tbl = vv_newLexTable( );
+	vvLexer *lex = vv_newLexer( src, "deepparse", VV_CHAR_BUFFER_DEFAULT_LEN, tbl );
+	vvParser *p = vv_newParser( lex );
+	vvSyntaxTree *tree;
+	vvError err;
+
+	p->explicitStack = explicitStack;
+
+	double t = now( );
+	if ( vv_parseModule( p, &tree, &err ) != VV_OK )
+		printf( "%zu:%zu %s\n", err.row, err.col, err.msg );
+	*time = now( ) - t;
+
+	vv_freeParser( p );
+	vv_freeLexer( lex );
+	vv_freeLexTable( tbl );
+
+	return tree;
+}
+
+static char *repeat( const char *head, const char *open, const char *mid, const char *close )
+{
+	size_t openLen = strlen( open ), closeLen = strlen( close );
+	char *src = ( char * ) malloc( strlen( head ) + DEPTH * ( openLen + closeLen ) + strlen( mid ) + 1 ), *p = src;
+
+	p += sprintf( p, "%s", head );
+
+	for ( size_t i = 0; i < DEPTH; i++, p += openLen )
+		memcpy( p, open, openLen );
+
+	p += sprintf( p, "%s", mid );
+
+	for ( size_t i = 0; i < DEPTH; i++, p += closeLen )
+		memcpy( p, close, closeLen );
+
+	*p = '\0';
+
+	return src;
+}
+
+int main( )
+{
+	int failed = 0;
+
+	char *src = ( char * ) malloc( FLAT_STMTS * 80 ), *p = src;
+
+	for ( size_t i = 0; i < FLAT_STMTS; i++ )
+		p += sprintf( p, i % 4 == 3 ? "when v%c > 2 { w := $(f, v%c, (1 + 2) * 3) }\n" : "v%c := -v%c * (3 + w) / 2\n",
+					  'a' + ( int ) ( i % 26 ), 'a' + ( int ) ( i * 7 % 26 ) );
+
+	double recursive = 1e9, explicitStack = 1e9, t;
+	vvSyntaxTree *a = NULL, *b = NULL;
+
+	for ( int r = 0; r < RUNS; r++ )
+	{
+		free( a );
+		free( b );
+
+		a = parse( src, 0, &t );
+		recursive = t < recursive ? t : recursive;
+		b = parse( src, 1, &t );
+		explicitStack = t < explicitStack ? t : explicitStack;
+	}
+
+	int same = a && b && a->size == b->size && !memcmp( a, b, a->size );
+
+	printf( "%zu bytes: recursive %.1f ms, explicit stack %.1f ms%s\n", strlen( src ), recursive * 1e3,
+			explicitStack * 1e3, same ? "" : ", trees differ" );
+
+	failed |= !same;
+	free( a );
+	free( b );
+	free( src );
+
+	char *deep[] = {
+		repeat( "x := ", "(", "1", ")" ),
+		repeat( "x := ", "-", "1", "" ),
+		repeat( "", "when x {\n", "y := 1\n", "}\n" ),
+		repeat( "x := ", "$(f, ", "1", ")" ),
+		repeat( "", "when x { y := 1 } { ", "y := 2", " }" ),
+		repeat( "x := ", "1 + (2 * ", "3", ")" ),
+	};
+
+	for ( size_t i = 0; i < sizeof( deep ) / sizeof( deep[ 0 ] ); i++ )
+	{
+		vvSyntaxTree *tree = parse( deep[ i ], 1, &t );
+
+		printf( "nested %d levels, input %zu: %s in %.1f ms\n", DEPTH, i, tree ? "parsed" : "failed", t * 1e3 );
+
+		failed |= tree == NULL;
+		free( tree );
+	}
+
+#ifndef _WIN32
+	fflush( stdout );
+
+	pid_t child = fork( );
+
+	if ( child == 0 )
+	{
+		parse( deep[ 0 ], 0, &t );
+		_exit( 0 );
+	}
+
+	int status;
+
+	waitpid( child, &status, 0 );
+
+	// a sanitizer catches the overflow and exits instead
+	int overflowed = WIFSIGNALED( status ) || WEXITSTATUS( status ) != 0;
+
+	printf( "recursive parse of input 0: %s\n", overflowed ? "overflowed the stack" : "returned" );
+
+	failed |= !overflowed;
+#endif
+
+	for ( size_t i = 0; i < sizeof( deep ) / sizeof( deep[ 0 ] ); i++ )
+		free( deep[ i ] );
+
+	puts( failed ? "FAILED" : "ok" );
+
+	return failed;
+}
\ No newline at end of file
@@ -0,0 +1,200 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Measures vv_incrEdit against a full parse for files of 1000 to 1000000
+statements: retyping a digit, inserting and deleting a statement, and edits
+scattered over a 4k window. Then checks that an edit which does not parse
+leaves the document consistent: the text is as sent, the damaged statements
+have no tree, and undoing the edit brings back the statements of a fresh
+parse.
+
+	cc -O2 -I. tests/incredit.c vvincr.c vvparser.c vvopt.c vvop.c vvlex.c vvcom.c vvscan.c vvthread.c -lm -lpthread
+*/
+
+#include "vvincr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now( )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#define REPS 2000
+
+static void bench( size_t stmts )
+{
+	size_t len = 0;
+	char *src = ( char * ) malloc( stmts * 64 );
+
+	for ( size_t i = 0; i < stmts; i++ )
+		len += sprintf( src + len, i % 8 == 7 ? "while va%c < %zu {\n  vb := vb + %zu\n}\n" : "v%c := vb * %zu + vc;\n",
+						'a' + ( int ) ( i % 26 ), i % 1000, i % 7 );
+
+	vvLexTable *tbl = vv_newLexTable( );
+	vvError err;
+
+	double t = now( );
+	vvIncr *inc = vv_newIncr( src, len, "incredit", tbl, &err );
+	double full = now( ) - t;
+
+	size_t mid = len / 2;
+
+	while ( src[ mid ] < '0' || src[ mid ] > '9' )
+		mid++;
+
+	t = now( );
+	for ( int i = 0; i < REPS; i++ )
+	{
+		char digit = '0' + i % 10;
+
+		vv_incrEdit( inc, mid, 1, &digit, 1, &err );
+	}
+	double retype = ( now( ) - t ) / REPS;
+
+	size_t at = mid + strcspn( src + mid, "\n" ) + 1;
+	const char *stmt = "vq := 1 + 2;\n";
+
+	t = now( );
+	for ( int i = 0; i < REPS; i++ )
+	{
+		vv_incrEdit( inc, at, 0, stmt, strlen( stmt ), &err );
+		vv_incrEdit( inc, at, strlen( stmt ), "", 0, &err );
+	}
+	double insert = ( now( ) - t ) / REPS / 2;
+
+	srand( 1 );
+	t = now( );
+	for ( int i = 0; i < REPS; i++ )
+	{
+		size_t off = mid + rand( ) % 4096;
+		char c;
+
+		vv_incrRead( inc, off, &c, 1 );
+
+		if ( c >= '0' && c <= '9' )
+		{
+			c = '0' + rand( ) % 10;
+			vv_incrEdit( inc, off, 1, &c, 1, &err );
+		}
+		else
+		{
+			vv_incrEdit( inc, off, 0, "", 0, &err );
+		}
+	}
+	double nearby = ( now( ) - t ) / REPS;
+
+	printf( "%7zu stmts %8zu bytes: full parse %9.1f us, retype %5.2f us, insert+delete %5.2f us, nearby %5.2f us\n",
+			stmts, len, full * 1e6, retype * 1e6, insert * 1e6, nearby * 1e6 );
+
+	vv_freeIncr( inc );
+	vv_freeLexTable( tbl );
+	free( src );
+}
+
+// same text, same statement count and every statement has a tree
+static int sameAsFresh( vvIncr *inc, vvLexTable *tbl )
+{
+	size_t len = vv_incrLength( inc );
+	char *text = ( char * ) malloc( len );
+	vvError err;
+
+	vv_incrRead( inc, 0, text, len );
+
+	vvIncr *fresh = vv_newIncr( text, len, "incredit", tbl, &err );
+	int same = err.code == VV_OK && vv_incrStatementCount( inc ) == vv_incrStatementCount( fresh );
+
+	for ( size_t i = 0; same && i < vv_incrStatementCount( inc ); i++ )
+		same = vv_incrStatement( inc, i ) != NULL;
+
+	vv_freeIncr( fresh );
+	free( text );
+
+	return same;
+}
+
+static int failedEdit( )
+{
+	static const char src[] = "a := 1\nb := 2\nc := 3\n";
+
+	vvLexTable *tbl = vv_newLexTable( );
+	vvError err;
+	vvIncr *inc = vv_newIncr( src, strlen( src ), "incredit", tbl, &err );
+	int failed = err.code != VV_OK;
+
+	// "b := (2" does not parse
+	vvResult rsl = vv_incrEdit( inc, 7, 0, "(", 1, &err );
+
+	printf( "broken edit: %s at %zu:%zu, %zu statements\n", rsl == VV_OK ? "no error" : err.msg, err.row, err.col,
+			vv_incrStatementCount( inc ) );
+
+	failed |= rsl != VV_ERR_SYNTAX || vv_incrLength( inc ) != strlen( src ) + 1 || err.row != 2;
+
+	for ( size_t i = 0; i < vv_incrStatementCount( inc ); i++ )
+		if ( vv_incrStatement( inc, i ) == NULL )
+			break;
+		else if ( i + 1 == vv_incrStatementCount( inc ) )
+			failed = 1;
+
+	// edits around the damage parse and leave it alone, until the "(" goes
+	failed |= vv_incrEdit( inc, 20, 1, "4", 1, &err ) != VV_OK;
+	failed |= vv_incrEdit( inc, 0, 0, "x := 0\n", 7, &err ) != VV_OK || vv_incrStatement( inc, 2 ) != NULL;
+	failed |= vv_incrEdit( inc, 15, 1, "b", 1, &err ) != VV_ERR_SYNTAX || err.row != 3 || err.col != 1;
+	failed |= vv_incrEdit( inc, 14, 1, "", 0, &err ) != VV_OK;
+	failed |= !sameAsFresh( inc, tbl );
+
+	failed |= vv_incrEdit( inc, 0, 7, "", 0, &err ) != VV_OK;
+	failed |= vv_incrEdit( inc, 19, 1, "3", 1, &err ) != VV_OK;
+
+	char text[ sizeof( src ) ];
+
+	vv_incrRead( inc, 0, text, sizeof( src ) - 1 );
+	failed |= vv_incrLength( inc ) != strlen( src ) || memcmp( text, src, sizeof( src ) - 1 ) != 0;
+	failed |= !sameAsFresh( inc, tbl );
+
+	vv_freeIncr( inc );
+	vv_freeLexTable( tbl );
+
+	return failed;
+}
+
+int main( )
+{
+	for ( size_t stmts = 1000; stmts <= 1000000; stmts *= 10 )
+		bench( stmts );
+
+	int failed = failedEdit( );
+
+	puts( failed ? "FAILED" : "ok" );
+
+	return failed;
+}
\ No newline at end of file
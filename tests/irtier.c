@@ -0,0 +1,169 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Checks that the IR tier computes what the flat generator does. Every program
+is compiled and run twice, with buildIR off and on, and must end with the
+same globals and the same runtime error at the same position. The programs
+are loops with invariant arithmetic that gets hoisted, loops that fail in a
+division or on a non-number after some iterations, calls without arguments
+and loop conditions holding function literals.
+
+	cc -O2 -I. tests/irtier.c vvgen.c vvir.c vvopt.c vvop.c vvvm.c vvparser.c vvlex.c vvcom.c vvscan.c vvthread.c -lm -lpthread
+*/
+
+#include "vvgen.h"
+#include "vvparser.h"
+#include "vvvm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const programs[] = {
+	// invariant arithmetic, hoisted out of the loops
+	"vi := 0; vk := 3; vs := 0\n"
+	"while vi < 5 { vs := vs + vk * 2 + vi; when vi == 2 { vk := 10 }; vi := vi + 1 }\n",
+
+	"def vf := [: va, vb, ]: { def vi := 0; def vs := 0; while vi < va { def vj := 0;\n"
+	"  while vj < 2 { vs := vs + vb * 3 + va * 2; vj := vj + 1 }; vi := vi + 1 }; return vs }\n"
+	"vr := $(vf, 4, 5)\n",
+
+	// a division by 0 that only runs once the loop is entered
+	"def vf := [: va, vb, ]: { def vi := 0; def vs := 0; while vi < va { vs := vs + vb / 0; vi := vi + 1 }; return vs }\n"
+	"vr := $(vf, 0, 5)\n"
+	"vq := 1\n"
+	"vr := $(vf, 2, 5)\n"
+	"vq := 2\n",
+
+	"vn := 0; vt := 0; vd := 4\n"
+	"while vn < 3 { vt := vt + 12 / vd; vn := vn + 1; vd := vd - 2 }\n",
+
+	// invariant operands that are not numbers
+	"def vf := [: va, vb, vc, ]: { def vi := 0; def vs := 0; while vi < va { vg := vi + 10; vs := vs + vb * vc; vi := vi + 1 }; return vs }\n"
+	"vg := 0\n"
+	"vr := $(vf, 3, 2, 4)\n"
+	"vr := $(vf, 3, 2, \"x\")\n",
+
+	"def vf := [: va, vb, ]: { def vi := 0; def vs := 0; while vi < va { when vi > 1 { vs := vs + vb * 2 }; vs := vs + 1; vi := vi + 1 }; return vs }\n"
+	"vr := $(vf, 1, nil)\n"
+	"vq := 1\n"
+	"vr := $(vf, 3, nil)\n",
+
+	"vn := 0; vt := 0\n"
+	"while vn < 3 { vt := vt + vm * 2; vn := vn + 1 }\n",
+
+	// calls, with and without arguments, inside loops
+	"vcnt := 0\n"
+	"vsink := [: vv, ]: { vcnt := vcnt + 1 }\n"
+	"vtick := [: ]: { vcnt := vcnt + 10 }\n"
+	"def vf := [: va, vb, ]: { def vi := 0; def vs := 0; while vi < va { $(vtick); $(vsink, vi); vs := vs + -vb; vi := vi + 1 }; return vs }\n"
+	"vr := $(vf, 3, 2)\n"
+	"vr := $(vf, 3, nil)\n",
+
+	// function literals in loop conditions
+	"vi := 0\n"
+	"vn := 0\n"
+	"while $([: x, ]: { def g := [: y, ]: { return y < 3 }; return $(g, x) }, vi) { vi := vi + 1; vn := vn + $([: z, ]: { return z * 2 }, vi) }\n"
+	"def f := [: ]: { def k := 0; while $([: q, ]: { return q < 4 }, k) { k := k + 1 }; return k }\n"
+	"vr := $(f)\n",
+};
+
+#define OUT_LEN 4096
+
+// runs src and writes the error and the globals it ends with to out
+static void run( const char *src, int buildIR, char *out )
+{
+	char *input = vv_strClone( src );
+	vvLexTable *tbl = vv_newLexTable( );
+	vvLexer *lex = vv_newLexer( input, "irtier", VV_CHAR_BUFFER_DEFAULT_LEN, tbl );
+	vvParser *p = vv_newParser( lex );
+	vvGenerator *gen = vv_newGenerator( VV_CHAR_BUFFER_DEFAULT_LEN );
+	vvSyntaxTree *tree;
+	vvError err;
+	size_t n = 0;
+
+	gen->buildIR = buildIR;
+
+	if ( vv_parseModule( p, &tree, &err ) != VV_OK || vv_generateTree( gen, tree, &err ) != VV_OK )
+	{
+		snprintf( out, OUT_LEN, "%zu:%zu %s\n", err.row, err.col, err.msg );
+	}
+	else
+	{
+		vvVM *vm = vv_newVM( "irtier", tbl );
+
+		vv_generatorLoad( gen, vm );
+
+		if ( vv_VMExecute( vm, &err ) != VV_OK )
+			n += snprintf( out + n, OUT_LEN - n, "%zu:%zu %s\n", err.row, err.col, err.msg );
+
+		vvSymSection *section = &gen->tbl->sections[ VAR_MEMORY ];
+
+		for ( size_t i = 0; i < section->idx && n < OUT_LEN; i++ )
+		{
+			vvValue *val = &vm->mem[ VV_REGISTER_COUNT + section->sto[ i ].idx ];
+			const char *name = vv_lexTableGet( tbl, section->sto[ i ].identifier );
+
+			if ( val->vt == VAL_NUMBER )
+				n += snprintf( out + n, OUT_LEN - n, "%s = %a\n", name, ( double ) val->val.num_val );
+			else
+				n += snprintf( out + n, OUT_LEN - n, "%s = %d %zu\n", name, val->vt, ( size_t ) val->val.cst_val );
+		}
+
+		vv_freeVM( vm );
+		vv_freeSyntaxTree( tree );
+	}
+
+	vv_freeGenerator( gen );
+	vv_freeParser( p );
+	vv_freeLexer( lex );
+	vv_freeLexTable( tbl );
+	free( input );
+}
+
+int main( )
+{
+	static char flat[ OUT_LEN ], ir[ OUT_LEN ];
+	int failed = 0;
+
+	for ( size_t i = 0; i < sizeof( programs ) / sizeof( programs[ 0 ] ); i++ )
+	{
+		run( programs[ i ], 0, flat );
+		run( programs[ i ], 1, ir );
+
+		int same = !strcmp( flat, ir );
+
+		printf( "program %zu: %s\n", i, same ? "same" : "differs" );
+
+		if ( !same )
+			printf( "flat:\n%sIR:\n%s", flat, ir );
+
+		failed |= !same;
+	}
+
+	puts( failed ? "FAILED" : "ok" );
+
+	return failed;
+}
\ No newline at end of file
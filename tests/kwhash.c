@@ -0,0 +1,144 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Identifier throughput of the keyword hash. The lexer source is built into
+this driver. Three million words, half of them keywords, are classified by
+lkeyword and by the strcmp over reservedWords it replaced, and then lexed end
+to end. Both classifiers must agree on every word, near misses such as
+"defx" or "nill" included.
+
+	cc -O2 -I. tests/kwhash.c vvcom.c vvscan.c vvthread.c -lm -lpthread
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../vvlex.c"
+
+#define WORDS 3000000
+
+static const char *const words[] = {
+	"def", "counter", "when", "whence", "while", "x", "partial", "partial_sum", "return", "returns",
+	"true", "tru", "false", "falsey", "nil", "nill", "defx", "w", "whilst", "de",
+};
+
+static double now( )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// what lsave did before the hash, on a copy of the token
+static vvTokenType strcmpKeyword( const char *str )
+{
+	for ( int tt = TT_KW_START + 1; tt < TT_KW_END; tt++ )
+		if ( !strcmp( str, reservedWords[ tt ] ) )
+			return ( vvTokenType ) tt;
+
+	return TT_NONE;
+}
+
+typedef struct
+{
+	vvLexer *lex;
+	size_t tokens;
+} lexRun;
+
+static void lexAll( void *ud )
+{
+	lexRun *run = ( lexRun * ) ud;
+
+	while ( vv_lexerRead( run->lex ).tt != TT_EOF )
+		run->tokens++;
+}
+
+int main( )
+{
+	const size_t cnt = sizeof( words ) / sizeof( words[ 0 ] );
+	size_t len = 0;
+
+	for ( size_t i = 0; i < WORDS; i++ )
+		len += strlen( words[ i % cnt ] ) + 1;
+
+	char *src = ( char * ) malloc( len + 1 ), *p = src;
+
+	for ( size_t i = 0; i < WORDS; i++ )
+		p += sprintf( p, "%s ", words[ i % cnt ] );
+
+	vvLexTable *tbl = vv_newLexTable( );
+	lexRun run = { vv_newLexer( src, "kwhash", VV_CHAR_BUFFER_DEFAULT_LEN, tbl ), 0 };
+	int failed = 0;
+	size_t hits = 0;
+
+	for ( size_t i = 0; i < cnt; i++ )
+	{
+		vvTokenType tt = lkeyword( words[ i ], strlen( words[ i ] ) );
+
+		if ( tt != strcmpKeyword( words[ i ] ) )
+		{
+			printf( "\"%s\" classified as %s\n", words[ i ], reservedWords[ tt ] );
+			failed = 1;
+		}
+	}
+
+	double t = now( );
+	for ( size_t i = 0; i < WORDS; i++ )
+		hits += lkeyword( words[ i % cnt ], strlen( words[ i % cnt ] ) ) != TT_NONE;
+	double hash = now( ) - t;
+
+	char copy[ 16 ];
+
+	t = now( );
+	for ( size_t i = 0; i < WORDS; i++ )
+	{
+		strcpy( copy, words[ i % cnt ] );
+		hits -= strcmpKeyword( copy ) != TT_NONE;
+	}
+	double loop = now( ) - t;
+
+	vvError err;
+
+	t = now( );
+	failed |= vv_try( &err, lexAll, &run ) != VV_OK || run.tokens != WORDS;
+	double lex = now( ) - t;
+
+	printf( "perfect hash %6.1fM words/s, strcmp loop %6.1fM words/s, lexing %5.1fM identifiers/s\n",
+			WORDS / hash / 1e6, WORDS / loop / 1e6, WORDS / lex / 1e6 );
+
+	vv_freeLexer( run.lex );
+	vv_freeLexTable( tbl );
+	free( src );
+
+	failed |= hits != 0;
+
+	puts( failed ? "FAILED" : "ok" );
+
+	return failed;
+}
\ No newline at end of file
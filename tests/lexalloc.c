@@ -0,0 +1,136 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Checks that lexing does not allocate per token: the lexer source is built
+into this driver with its allocations counted, and inputs repeating the same
+tokens 1 to 10000 times must all lex with the same number of allocations.
+The tokens are longer than the initial scratch buffer.
+
+	cc -I. tests/lexalloc.c vvcom.c vvscan.c vvthread.c -lm -lpthread
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t allocs;
+
+static void *countMalloc( size_t size )
+{
+	allocs++;
+	return malloc( size );
+}
+
+static void *countCalloc( size_t cnt, size_t size )
+{
+	allocs++;
+	return calloc( cnt, size );
+}
+
+static void *countRealloc( void *ptr, size_t size )
+{
+	allocs++;
+	return realloc( ptr, size );
+}
+
+#define malloc countMalloc
+#define calloc countCalloc
+#define realloc countRealloc
+#include "../vvlex.c"
+#undef malloc
+#undef calloc
+#undef realloc
+
+// 40 byte identifiers, a 60 byte string and a 43 digit float
+static const char unit[] = "alpha_beta_gamma_delta_epsilon_zeta_eta := theta_iota_kappa_lambda_mu_nu_xi_omicron + 3; "
+						   "'a string literal that is well over thirty one bytes long'; "
+						   "x := 0.123456789012345678901234567890123456789012;\n";
+
+typedef struct
+{
+	vvLexer *lex;
+	size_t tokens;
+} lexRun;
+
+static void lexAll( void *ud )
+{
+	lexRun *run = ( lexRun * ) ud;
+
+	while ( vv_lexerRead( run->lex ).tt != TT_EOF )
+		run->tokens++;
+}
+
+// allocations made while lexing reps copies of unit, SIZE_MAX on a lex error
+static size_t lexCount( size_t reps, size_t *tokens )
+{
+	size_t len = strlen( unit );
+	char *src = ( char * ) malloc( len * reps + 1 );
+
+	for ( size_t i = 0; i < reps; i++ )
+		memcpy( src + i * len, unit, len );
+
+	src[ len * reps ] = '\0';
+
+	vvLexTable *tbl = vv_newLexTable( );
+	lexRun run = { vv_newLexer( src, "lexalloc", VV_CHAR_BUFFER_DEFAULT_LEN, tbl ), 0 };
+	vvError err;
+	size_t before = allocs;
+
+	vvResult rsl = vv_try( &err, lexAll, &run );
+	size_t rslAllocs = rsl == VV_OK ? allocs - before : SIZE_MAX;
+
+	if ( rsl != VV_OK )
+		printf( "lex error: %s\n", err.msg );
+
+	vv_freeLexer( run.lex );
+	vv_freeLexTable( tbl );
+	free( src );
+
+	*tokens = run.tokens;
+	return rslAllocs;
+}
+
+int main( )
+{
+	size_t first = 0;
+	int failed = 0;
+
+	for ( size_t reps = 1; reps <= 10000; reps *= 10 )
+	{
+		size_t tokens, cnt = lexCount( reps, &tokens );
+
+		printf( "%5zu copies, %6zu tokens: %zu allocations\n", reps, tokens, cnt );
+
+		if ( reps == 1 )
+			first = cnt;
+
+		failed |= cnt == SIZE_MAX || cnt != first;
+	}
+
+	puts( failed ? "FAILED" : "ok" );
+
+	return failed;
+}
\ No newline at end of file
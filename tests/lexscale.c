@@ -0,0 +1,201 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Scaling of vv_lexParallel from 1 thread to one per core ( at least 4 ). A
+16 MB input with names, numbers, strings, line comments and block comments
+that run over chunk boundaries is lexed serially by vv_lexerReadAll and in
+parallel, where every chunk interns into a table of its own and the tables
+are merged into one. The parallel runs go once into a plain table and once
+into a shared one, and must give back the serial tokens, ids, line table
+and table contents exactly.
+
+	cc -O2 -I. tests/lexscale.c vvlex.c vvcom.c vvscan.c vvthread.c -lm -lpthread
+*/
+
+#include "vvlex.h"
+#include "vvthread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define INPUT_LEN ( 16 << 20 )
+#define RUNS 3
+
+static double now( )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static char *makeInput( size_t *len )
+{
+	// room for the longest line or comment past INPUT_LEN
+	char *src = ( char * ) malloc( INPUT_LEN + 1024 );
+	size_t n = 0, i = 0;
+
+	while ( n < INPUT_LEN )
+	{
+		switch ( i % 16 )
+		{
+			case 3:
+				n += sprintf( src + n, "vs%zu := \"text ## not a comment %zu\" # note ## here\r\n", i % 5000, i );
+				break;
+			case 7:
+				n += sprintf( src + n, "## a block comment\n%.*s\nover lines ##\n", ( int ) ( i % 13 ), "when while x" );
+				break;
+			case 11:
+				// a long one, some of them cross a chunk boundary
+				n += sprintf( src + n, "##" );
+				for ( size_t k = 0; k < 40; k++ )
+					n += sprintf( src + n, "filler %zu 'x\n", k );
+				n += sprintf( src + n, "##\n" );
+				i += 53;
+				break;
+			default:
+				n += sprintf( src + n, "v%zu := v%zu * %zu.5 + w%zu; when v%zu > 3 { def q := 'a' }\n",
+							  i % 20000, ( i * 7 ) % 20000, i % 100, i % 300, i % 20000 );
+		}
+
+		i++;
+	}
+
+	*len = n;
+
+	return src;
+}
+
+static int sameTokens( vvTokenBuffer *a, vvLexTable *at, vvTokenBuffer *b, vvLexTable *bt )
+{
+	if ( a->len != b->len || a->lineCnt != b->lineCnt || at->size != bt->size )
+		return 0;
+
+	if ( memcmp( a->types, b->types, a->len ) || memcmp( a->ids, b->ids, a->len * sizeof( uint32_t ) ) ||
+		 memcmp( a->offs, b->offs, a->len * sizeof( uint32_t ) ) ||
+		 memcmp( a->lineRows, b->lineRows, a->lineCnt * sizeof( uint32_t ) ) ||
+		 memcmp( a->lineStarts, b->lineStarts, a->lineCnt * sizeof( uint32_t ) ) )
+		return 0;
+
+	for ( size_t i = 0; i < at->size; i++ )
+		if ( vv_lexTableLen( at, i ) != vv_lexTableLen( bt, i ) ||
+			 memcmp( vv_lexTableGet( at, i ), vv_lexTableGet( bt, i ), vv_lexTableLen( at, i ) ) )
+			return 0;
+
+	return 1;
+}
+
+// best time of RUNS parallel runs into fresh tables, the last run is compared
+static double parallel( vvPool *pool, const char *src, size_t len, int shared, vvTokenBuffer *ref, vvLexTable *refTbl, int *same )
+{
+	double best = 1e9;
+
+	for ( int r = 0; r < RUNS; r++ )
+	{
+		vvLexTable *tbl = shared ? vv_newSharedLexTable( ) : vv_newLexTable( );
+		vvTokenBuffer *buf = vv_newTokenBuffer( );
+		vvError err;
+
+		double t = now( );
+		vvResult rsl = vv_lexParallel( pool, src, len, "lexscale", tbl, buf, &err );
+		t = now( ) - t;
+
+		if ( t < best )
+			best = t;
+
+		*same = rsl == VV_OK && sameTokens( ref, refTbl, buf, tbl );
+
+		vv_freeTokenBuffer( buf );
+		vv_freeLexTable( tbl );
+	}
+
+	return best;
+}
+
+int main( )
+{
+	size_t len;
+	char *src = makeInput( &len );
+	vvLexTable *refTbl = NULL;
+	vvTokenBuffer *ref = NULL;
+	double serial = 1e9;
+	int failed = 0;
+
+	for ( int r = 0; r < RUNS; r++ )
+	{
+		if ( ref )
+		{
+			vv_freeTokenBuffer( ref );
+			vv_freeLexTable( refTbl );
+		}
+
+		refTbl = vv_newLexTable( );
+		ref = vv_newTokenBuffer( );
+
+		vvLexer *lex = vv_newLexer( src, "lexscale", VV_CHAR_BUFFER_DEFAULT_LEN, refTbl );
+		vvError err;
+
+		double t = now( );
+		failed |= vv_lexerReadAll( lex, ref, &err ) != VV_OK;
+		t = now( ) - t;
+
+		if ( t < serial )
+			serial = t;
+
+		vv_freeLexer( lex );
+	}
+
+	printf( "%zu bytes, %zu tokens, %zu names, %zu cores\n", len, ref->len, refTbl->size, vv_cpuCount( ) );
+	printf( "serial            %7.1f ms\n", serial * 1e3 );
+
+	size_t most = vv_cpuCount( ) < 4 ? 4 : vv_cpuCount( );
+
+	for ( size_t threads = 1; threads <= most; threads *= 2 )
+	{
+		vvPool *pool = vv_newPool( threads - 1 );
+		int same, sameShared;
+
+		double plain = parallel( pool, src, len, 0, ref, refTbl, &same );
+		double shared = parallel( pool, src, len, 1, ref, refTbl, &sameShared );
+
+		printf( "%2zu threads: plain %7.1f ms ( %4.2fx ), shared %7.1f ms ( %4.2fx )%s\n", threads, plain * 1e3,
+				serial / plain, shared * 1e3, serial / shared, same && sameShared ? "" : ", tokens differ" );
+
+		failed |= !same || !sameShared;
+
+		vv_freePool( pool );
+	}
+
+	vv_freeTokenBuffer( ref );
+	vv_freeLexTable( refTbl );
+	free( src );
+
+	puts( failed ? "FAILED" : "ok" );
+
+	return failed;
+}
\ No newline at end of file
@@ -0,0 +1,236 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Measures what the peephole pass saves and checks that it changes nothing
+else. Every program is compiled with gen->optimize off and on: the
+benchmarks report static code, instructions executed and the best of three
+runs, and every program must end with the same globals and the same runtime
+error at the same position either way. Add -DVV_REGISTER_COUNT=3 to run it
+with spills everywhere.
+
+	cc -O2 -I. tests/peephole.c vvgen.c vvir.c vvopt.c vvop.c vvvm.c vvparser.c vvlex.c vvcom.c vvscan.c vvthread.c -lm -lpthread
+*/
+
+#include "vvgen.h"
+#include "vvparser.h"
+#include "vvvm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *const programs[][ 2 ] = {
+	{ "nested loops",
+	  "def vgrid := [: vn, ]: { def vs := 0; def vi := 0; while vi < vn { def vj := 0; while vj < vn {\n"
+	  "  def vq := vi * vn + vj\n"
+	  "  when vq - vq / 2 * 2 < 0.5 { vs := vs + vq } : { when vj > vi { vs := vs - vj } : { vs := vs + vi } }\n"
+	  "  vj := vj + 1 }; vi := vi + 1 }; return vs }\n"
+	  "vr := $(vgrid, 700)\n" },
+
+	{ "polynomial",
+	  "vx := 1.5; vi := 0; vacc := 0\n"
+	  "while vi < 20000 { vacc := vacc + ((((vx * 3 + 2) * vx - 5) * vx + 7) * vx - 11) * (vx + vi) - (vx * vx + vi * vi) / (vx + vi + 1); vi := vi + 1 }\n" },
+
+	{ "loop",
+	  "vi := 0; vs := 0; vt := 0\n"
+	  "while vi < 100000 { vs := vs + (vi * 3 + 1) * (vi - 2) / 7; vt := vt + vi * vi - vs / (vi + 1); vi := vi + 1 }\n" },
+
+	{ "recursion",
+	  "def vsum := [: vn, ]: { when vn < 1 { return 0 }; return vn * 2 + 1 + $(vsum, vn - 1) }\n"
+	  "vi := 0; vr := 0\n"
+	  "while vi < 200 { vr := vr + $(vsum, 500); vi := vi + 1 }\n" },
+
+	{ "fib",
+	  "def vfib := [: vn, ]: { when vn < 2 { return vn }; return $(vfib, vn - 1) + $(vfib, vn - 2) }\n"
+	  "vr := $(vfib, 20)\n" },
+
+	{ "calls",
+	  "def vadd := [: va, vb, ]: { return va + vb }\n"
+	  "def vmul := [: va, vb, ]: { return va * vb }\n"
+	  "vi := 0; vs := 0\n"
+	  "while vi < 20000 { vs := $(vadd, vs, $(vmul, vi + 1, $(vadd, vi, 2)) - $(vadd, vi * 2, 1)); vi := vi + 1 }\n" },
+
+	// code after return and empty branches, for the reachability and jump steps
+	{ "dead code",
+	  "def vf := [: va, ]: { when va > 2 { return 1; va := 5 } : { }; while va < 0 { }; return va; va := 7 }\n"
+	  "vr := $(vf, 3); vq := $(vf, 1)\n"
+	  "when vr { } : { vr := 9 }\n" },
+
+	// the same global loaded again and again, for the forwarded loads
+	{ "reloads",
+	  "va := 3; vb := 4\n"
+	  "vc := va * va + va * vb + vb * vb + va; vd := vc + va; va := vd; ve := va + vb\n" },
+
+	// errors after some iterations, which have to come from the same instruction
+	{ "division by 0",
+	  "def vf := [: va, vb, ]: { def vi := 0; def vs := 0; while vi < va { vs := vs + vb / (2 - vi); vi := vi + 1 }; return vs }\n"
+	  "vr := $(vf, 1, 6)\n"
+	  "vq := 1\n"
+	  "vr := $(vf, 4, 6)\n"
+	  "vq := 2\n" },
+
+	{ "not a number",
+	  "vn := 0; vt := 0; vx := 1\n"
+	  "while vn < 3 { vt := vt + vx * 2; vn := vn + 1; when vn == 2 { vx := \"x\" } }\n" },
+};
+
+#define OUT_LEN 4096
+
+typedef struct job
+{
+	vvVM *vm;
+	size_t executed;
+} job;
+
+static double now( )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// vv_VMExecute, counting the instructions
+static void step( void *ud )
+{
+	job *j = ( job * ) ud;
+	vvVM *vm = j->vm;
+	int flag;
+
+	while ( ( flag = vv_VMStep( vm, vm->insts[ vm->idx.func ][ vm->idx.adr ] ) ) )
+	{
+		j->executed++;
+
+		if ( flag == VM_NEXT )
+			vm->idx.adr++;
+	}
+}
+
+// runs src and writes the error and the globals it ends with to out
+static void run( const char *src, int optimize, char *out, size_t *code, size_t *executed, double *ms )
+{
+	char *input = vv_strClone( src );
+	vvLexTable *tbl = vv_newLexTable( );
+	vvLexer *lex = vv_newLexer( input, "peephole", VV_CHAR_BUFFER_DEFAULT_LEN, tbl );
+	vvParser *p = vv_newParser( lex );
+	vvGenerator *gen = vv_newGenerator( VV_CHAR_BUFFER_DEFAULT_LEN );
+	vvSyntaxTree *tree;
+	vvError err;
+	size_t n = 0;
+
+	gen->optimize = optimize;
+	*code = *executed = 0;
+	*ms = 0;
+
+	if ( vv_parseModule( p, &tree, &err ) != VV_OK || vv_generateTree( gen, tree, &err ) != VV_OK )
+	{
+		snprintf( out, OUT_LEN, "%zu:%zu %s\n", err.row, err.col, err.msg );
+	}
+	else
+	{
+		vvVM *vm = vv_newVM( "peephole", tbl );
+		size_t module = vv_generatorLoad( gen, vm );
+		size_t moduleLen = 0;
+
+		// the module code ends with its only OP_HALT
+		while ( vm->insts[ module ][ moduleLen++ ].op != OP_HALT )
+			;
+
+		*code = moduleLen;
+
+		for ( size_t i = 0; i < gen->funcCnt; i++ )
+			*code += gen->funcLens[ i ];
+
+		job j = { vm, 0 };
+		double start = now( );
+
+		if ( vv_try( &err, step, &j ) != VV_OK )
+			n += snprintf( out + n, OUT_LEN - n, "%zu:%zu %s\n", err.row, err.col, err.msg );
+
+		*ms = now( ) - start;
+		*executed = j.executed;
+
+		vvSymSection *section = &gen->tbl->sections[ VAR_MEMORY ];
+
+		for ( size_t i = 0; i < section->idx && n < OUT_LEN; i++ )
+		{
+			vvValue *val = &vm->mem[ VV_REGISTER_COUNT + section->sto[ i ].idx ];
+			const char *name = vv_lexTableGet( tbl, section->sto[ i ].identifier );
+
+			if ( val->vt == VAL_NUMBER )
+				n += snprintf( out + n, OUT_LEN - n, "%s = %a\n", name, ( double ) val->val.num_val );
+			else
+				n += snprintf( out + n, OUT_LEN - n, "%s = %d %zu\n", name, val->vt, ( size_t ) val->val.cst_val );
+		}
+
+		vv_freeVM( vm );
+		vv_freeSyntaxTree( tree );
+	}
+
+	vv_freeGenerator( gen );
+	vv_freeParser( p );
+	vv_freeLexer( lex );
+	vv_freeLexTable( tbl );
+	free( input );
+}
+
+int main( )
+{
+	static char off[ OUT_LEN ], on[ OUT_LEN ];
+	int failed = 0;
+
+	printf( "%-14s %13s %21s %17s\n", "program", "static", "executed", "best time" );
+
+	for ( size_t i = 0; i < sizeof( programs ) / sizeof( programs[ 0 ] ); i++ )
+	{
+		size_t code[ 2 ], executed[ 2 ];
+		double best[ 2 ] = { 1e30, 1e30 };
+
+		for ( int rep = 0; rep < 3; rep++ )
+			for ( int optimize = 0; optimize < 2; optimize++ )
+			{
+				double ms;
+
+				run( programs[ i ][ 1 ], optimize, optimize ? on : off, &code[ optimize ], &executed[ optimize ], &ms );
+
+				if ( ms < best[ optimize ] )
+					best[ optimize ] = ms;
+			}
+
+		int same = !strcmp( off, on );
+
+		printf( "%-14s %5zu / %5zu %9zu / %9zu %6.1f / %6.1f ms %s\n", programs[ i ][ 0 ], code[ 0 ], code[ 1 ],
+			executed[ 0 ], executed[ 1 ], best[ 0 ], best[ 1 ], same ? "same" : "differs" );
+
+		if ( !same )
+			printf( "off:\n%son:\n%s", off, on );
+
+		failed |= !same;
+	}
+
+	puts( failed ? "FAILED" : "ok" );
+
+	return failed;
+}
\ No newline at end of file
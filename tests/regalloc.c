@@ -0,0 +1,249 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Counts the instructions the linear-scan allocator leaves: static code, loads
+and stores of memory and frame slots, and instructions executed, for loops,
+arithmetic, nested loops in a function, calls and recursion. Then checks
+results that depend on the allocator: expressions keeping more values live
+than there are registers, values live across calls and across recursive
+calls, and fib( 20 ). Add -DVV_REGISTER_COUNT=3 to run it with a single
+allocatable register.
+
+	cc -O2 -I. tests/regalloc.c vvgen.c vvir.c vvopt.c vvop.c vvvm.c vvparser.c vvlex.c vvcom.c vvscan.c vvthread.c -lm -lpthread
+*/
+
+#include "vvgen.h"
+#include "vvparser.h"
+#include "vvvm.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *const benchmarks[][ 2 ] = {
+	{ "loop",
+	  "vi := 0; vs := 0; vt := 0\n"
+	  "while vi < 100000 { vs := vs + (vi * 3 + 1) * (vi - 2) / 7; vt := vt + vi * vi - vs / (vi + 1); vi := vi + 1 }\n" },
+
+	{ "polynomial",
+	  "vx := 1.5; vi := 0; vacc := 0\n"
+	  "while vi < 20000 { vacc := vacc + ((((vx * 3 + 2) * vx - 5) * vx + 7) * vx - 11) * (vx + vi) - (vx * vx + vi * vi) / (vx + vi + 1); vi := vi + 1 }\n" },
+
+	{ "nested loops",
+	  "def vgrid := [: vn, ]: { def vs := 0; def vi := 0; while vi < vn { def vj := 0; while vj < vn {\n"
+	  "  def vq := vi * vn + vj\n"
+	  "  when vq - vq / 2 * 2 < 0.5 { vs := vs + vq } : { when vj > vi { vs := vs - vj } : { vs := vs + vi } }\n"
+	  "  vj := vj + 1 }; vi := vi + 1 }; return vs }\n"
+	  "vr := $(vgrid, 700)\n" },
+
+	{ "calls",
+	  "def vadd := [: va, vb, ]: { return va + vb }\n"
+	  "def vmul := [: va, vb, ]: { return va * vb }\n"
+	  "vi := 0; vs := 0\n"
+	  "while vi < 20000 { vs := $(vadd, vs, $(vmul, vi + 1, $(vadd, vi, 2)) - $(vadd, vi * 2, 1)); vi := vi + 1 }\n" },
+
+	{ "recursion",
+	  "def vsum := [: vn, ]: { when vn < 1 { return 0 }; return vn * 2 + 1 + $(vsum, vn - 1) }\n"
+	  "vi := 0; vr := 0\n"
+	  "while vi < 200 { vr := vr + $(vsum, 500); vi := vi + 1 }\n" },
+};
+
+static const struct
+{
+	const char *src, *global;
+	double expected;
+} checks[] = {
+	// more operands pending than registers
+	{ "def vdeep := [: va, vb, vc, vd, ]: { return va * (vb + vc * (vd + va * (vb + vc * (vd + va * (vb + vc * (vd + va * (vb + 1))))))) }\n"
+	  "vr := $(vdeep, 1, 2, 3, 1)\n",
+	  "vr", 146 },
+
+	// pending operands, in registers and spilled, live across calls
+	{ "def vid := [: vx, ]: { return vx }\n"
+	  "vr := $(vid, 1) + ($(vid, 2) * ($(vid, 3) + ($(vid, 4) * ($(vid, 5) + ($(vid, 6) * ($(vid, 7) + ($(vid, 8) * ($(vid, 9) + 1))))))))\n",
+	  "vr", 4223 },
+
+	// and across a recursive call, which runs the same code
+	{ "def vt := [: vn, ]: { when vn < 1 { return 1 }; return vn + (vn * 2 + (vn * 3 + (vn * 4 + (vn * 5 + (vn * 6 + (vn * 7 + $(vt, vn - 1))))))) }\n"
+	  "vr := $(vt, 10)\n",
+	  "vr", 1541 },
+
+	{ "def vsum := [: vn, ]: { when vn < 1 { return 0 }; return vn * 2 + 1 + $(vsum, vn - 1) }\n"
+	  "vr := $(vsum, 500)\n",
+	  "vr", 251000 },
+
+	{ "def vfib := [: vn, ]: { when vn < 2 { return vn }; return $(vfib, vn - 1) + $(vfib, vn - 2) }\n"
+	  "vr := $(vfib, 20)\n",
+	  "vr", 6765 },
+
+	// a value from before the loop used in every iteration
+	{ "def vl := [: vn, ]: { def vk := vn * 3; def vi := 0; def vs := 0; while vi < vn { vs := vs + vk + vi; vi := vi + 1 }; return vs }\n"
+	  "vr := $(vl, 10)\n",
+	  "vr", 345 },
+};
+
+typedef struct stats
+{
+	size_t code, slots, executed;
+	double ms;
+} stats;
+
+typedef struct job
+{
+	vvVM *vm;
+	size_t executed;
+} job;
+
+static double now( )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// vv_VMExecute, counting the instructions
+static void step( void *ud )
+{
+	job *j = ( job * ) ud;
+	vvVM *vm = j->vm;
+	int flag;
+
+	while ( ( flag = vv_VMStep( vm, vm->insts[ vm->idx.func ][ vm->idx.adr ] ) ) )
+	{
+		j->executed++;
+
+		if ( flag == VM_NEXT )
+			vm->idx.adr++;
+	}
+}
+
+static void count( vvOpData *code, size_t len, stats *st )
+{
+	for ( size_t i = 0; i < len; i++ )
+	{
+		st->code++;
+
+		if ( code[ i ].op == OP_LOAD || code[ i ].op == OP_STORE || code[ i ].op == OP_LOADL || code[ i ].op == OP_STOREL )
+			st->slots++;
+	}
+}
+
+// runs src, fills st and gives the number global ends with, NAN on an error
+static double run( const char *src, const char *global, stats *st )
+{
+	char *input = vv_strClone( src );
+	vvLexTable *tbl = vv_newLexTable( );
+	vvLexer *lex = vv_newLexer( input, "regalloc", VV_CHAR_BUFFER_DEFAULT_LEN, tbl );
+	vvParser *p = vv_newParser( lex );
+	vvGenerator *gen = vv_newGenerator( VV_CHAR_BUFFER_DEFAULT_LEN );
+	vvSyntaxTree *tree;
+	vvError err;
+	double rsl = NAN;
+
+	memset( st, 0, sizeof( stats ) );
+
+	if ( vv_parseModule( p, &tree, &err ) != VV_OK || vv_generateTree( gen, tree, &err ) != VV_OK )
+	{
+		printf( "%zu:%zu %s\n", err.row, err.col, err.msg );
+	}
+	else
+	{
+		vvVM *vm = vv_newVM( "regalloc", tbl );
+		size_t module = vv_generatorLoad( gen, vm );
+		size_t moduleLen = 0;
+
+		for ( size_t i = 0; i < gen->funcCnt; i++ )
+			count( vm->insts[ i ], gen->funcLens[ i ], st );
+
+		// the module code ends with its only OP_HALT
+		while ( vm->insts[ module ][ moduleLen++ ].op != OP_HALT )
+			;
+
+		count( vm->insts[ module ], moduleLen, st );
+
+		job j = { vm, 0 };
+		double start = now( );
+
+		if ( vv_try( &err, step, &j ) != VV_OK )
+			printf( "%zu:%zu %s\n", err.row, err.col, err.msg );
+		else
+		{
+			vvSymSection *section = &gen->tbl->sections[ VAR_MEMORY ];
+
+			for ( size_t i = 0; i < section->idx; i++ )
+			{
+				vvValue *val = &vm->mem[ VV_REGISTER_COUNT + section->sto[ i ].idx ];
+
+				if ( !strcmp( vv_lexTableGet( tbl, section->sto[ i ].identifier ), global ) && val->vt == VAL_NUMBER )
+					rsl = val->val.num_val;
+			}
+		}
+
+		st->ms = now( ) - start;
+		st->executed = j.executed;
+
+		vv_freeVM( vm );
+		vv_freeSyntaxTree( tree );
+	}
+
+	vv_freeGenerator( gen );
+	vv_freeParser( p );
+	vv_freeLexer( lex );
+	vv_freeLexTable( tbl );
+	free( input );
+
+	return rsl;
+}
+
+int main( )
+{
+	int failed = 0;
+	stats st;
+
+	printf( "%d registers, %d allocated\n", VV_REGISTER_COUNT, VV_ALLOC_REGISTERS );
+	printf( "%-14s %8s %10s %12s %10s\n", "program", "static", "load/store", "executed", "time" );
+
+	for ( size_t i = 0; i < sizeof( benchmarks ) / sizeof( benchmarks[ 0 ] ); i++ )
+	{
+		run( benchmarks[ i ][ 1 ], "", &st );
+		printf( "%-14s %8zu %10zu %12zu %7.1f ms\n", benchmarks[ i ][ 0 ], st.code, st.slots, st.executed, st.ms );
+	}
+
+	for ( size_t i = 0; i < sizeof( checks ) / sizeof( checks[ 0 ] ); i++ )
+	{
+		double got = run( checks[ i ].src, checks[ i ].global, &st );
+		int right = got == checks[ i ].expected;
+
+		printf( "check %zu: %s = %g, expected %g, %zu executed\n", i, checks[ i ].global, got, checks[ i ].expected, st.executed );
+
+		failed |= !right;
+	}
+
+	puts( failed ? "FAILED" : "ok" );
+
+	return failed;
+}
\ No newline at end of file
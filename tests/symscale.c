@@ -0,0 +1,304 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Times compiling modules of 10k to 50k globals, each set once and then
+assigned the sum of two others, and checks every global against the same
+sums done here. Generation has to grow about linearly: 50k globals may take
+at most 15 times as long as 10k, a scan of the symbols per lookup would take
+25 times. Then checks the scoping rules: def shadows in the innermost scope,
+assignment finds the innermost existing name or makes a global, and lookups
+from a function body skip the scopes of the function around it.
+
+	cc -O2 -I. tests/symscale.c vvgen.c vvir.c vvopt.c vvop.c vvvm.c vvparser.c vvlex.c vvcom.c vvscan.c vvthread.c -lm -lpthread
+*/
+
+#include "vvgen.h"
+#include "vvparser.h"
+#include "vvvm.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const struct
+{
+	const char *src, *globals;
+} checks[] = {
+	// blocks, function bodies and when branches
+	{ "vx := 1; vy := 10\n"
+	  "def vf := [: vx, ]: { vy := vy + vx; def vy := 100; { def vy := 1000; vz := vy }; vw := vy; return vx }\n"
+	  "vr := $(vf, 5)\n"
+	  "{ def vx := 7; vq := vx }\n"
+	  "vs := vx\n"
+	  "when vx == 1 { def vx := 2; vt := vx } : { vt := 0 }\n"
+	  "vu := vx\n",
+	  "vx 1 vy 15 vz 1000 vw 100 vr 5 vq 7 vs 1 vt 2 vu 1" },
+
+	// a function in a function sees the globals, not the locals around it
+	{ "vk := 1; vm := 0\n"
+	  "def vo := [: ]: { def vk := 50; def vin := [: ]: { return vk }; return $(vin) }\n"
+	  "vb := $(vo)\n"
+	  "def vp := [: ]: { def vm := 5; def vin := [: ]: { vm := 9 }; $(vin); return vm }\n"
+	  "vc := $(vp)\n",
+	  "vk 1 vm 9 vb 1 vc 5" },
+
+	// parameters shadow globals and each call has its own
+	{ "va := 4\n"
+	  "def vf := [: va, ]: { when va < 1 { return 0 }; def vd := va; return vd + $(vf, va - 1) }\n"
+	  "vr := $(vf, 3)\n",
+	  "va 4 vr 6" },
+
+	// deeper than the 16 scopes the field stack used to hold
+	{ "vx := 0\n"
+	  "{ def vx := 1; { { { { { { { { { { { { { { { { { { { def vx := 2; { { { { { { { { { { { { { { { { { { { { vd := vx"
+	  " } } } } } } } } } } } } } } } } } } } } } } } } } } } } } } } } } } } } } } } ; ve := vx }\n"
+	  "vf := vx\n",
+	  "vx 0 vd 2 ve 1 vf 0" },
+};
+
+#define SIZES 3
+
+static const size_t sizes[ SIZES ] = { 10000, 20000, 50000 };
+
+static double now( )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// letters only, identifiers take no digits
+static size_t name( char *buf, size_t i )
+{
+	size_t n = 0;
+
+	buf[ n++ ] = 'v';
+	buf[ n++ ] = 'g';
+
+	do
+	{
+		buf[ n++ ] = 'a' + i % 26;
+		i /= 26;
+	} while ( i );
+
+	return n;
+}
+
+// compiles src, runs it and gives the VM, NULL after an error
+static vvVM *run( char *src, vvLexTable *tbl, vvGenerator *gen, double ms[ 3 ] )
+{
+	vvLexer *lex = vv_newLexer( src, "symscale", VV_CHAR_BUFFER_DEFAULT_LEN, tbl );
+	vvParser *p = vv_newParser( lex );
+	vvSyntaxTree *tree;
+	vvVM *vm = NULL;
+	vvError err;
+	double start = now( );
+
+	if ( vv_parseModule( p, &tree, &err ) != VV_OK )
+	{
+		printf( "%zu:%zu %s\n", err.row, err.col, err.msg );
+		goto done;
+	}
+
+	ms[ 0 ] = now( ) - start;
+	start = now( );
+
+	if ( vv_generateTree( gen, tree, &err ) != VV_OK )
+	{
+		printf( "%zu:%zu %s\n", err.row, err.col, err.msg );
+		vv_freeSyntaxTree( tree );
+		goto done;
+	}
+
+	ms[ 1 ] = now( ) - start;
+	start = now( );
+
+	vm = vv_newVM( "symscale", tbl );
+	vv_generatorLoad( gen, vm );
+
+	ms[ 2 ] = now( ) - start;
+
+	if ( vv_VMExecute( vm, &err ) != VV_OK )
+	{
+		printf( "%zu:%zu %s\n", err.row, err.col, err.msg );
+		vv_freeVM( vm );
+		vm = NULL;
+	}
+
+	vv_freeSyntaxTree( tree );
+
+done:
+	vv_freeParser( p );
+	vv_freeLexer( lex );
+
+	return vm;
+}
+
+// the value of the global named id, NAN when there is none or it is not a number
+static double global( vvGenerator *gen, vvVM *vm, vvLexTable *tbl, const char *id )
+{
+	vvSymSection *section = &gen->tbl->sections[ VAR_MEMORY ];
+
+	for ( size_t i = 0; i < section->idx; i++ )
+	{
+		vvValue *val = &vm->mem[ VV_REGISTER_COUNT + section->sto[ i ].idx ];
+
+		if ( !strcmp( vv_lexTableGet( tbl, section->sto[ i ].identifier ), id ) )
+			return val->vt == VAL_NUMBER ? val->val.num_val : NAN;
+	}
+
+	return NAN;
+}
+
+int main( )
+{
+	int failed = 0;
+	double generate[ SIZES ];
+
+	printf( "%8s %10s %10s %10s\n", "globals", "parse", "generate", "load" );
+
+	for ( size_t s = 0; s < SIZES; s++ )
+	{
+		size_t cnt = sizes[ s ];
+		char *src = ( char * ) malloc( cnt * 64 );
+		assert( src );
+		float *ref = ( float * ) malloc( cnt * sizeof( float ) );
+		assert( ref );
+		size_t len = 0;
+		unsigned seed = 1;
+
+		for ( size_t i = 0; i < cnt; i++ )
+		{
+			len += name( src + len, i );
+			len += sprintf( src + len, " := %zu\n", i % 10 );
+			ref[ i ] = i % 10;
+		}
+
+		for ( size_t i = 0; i < cnt; i++ )
+		{
+			seed = seed * 1103515245 + 12345;
+			size_t a = ( seed >> 8 ) % cnt;
+			seed = seed * 1103515245 + 12345;
+			size_t b = ( seed >> 8 ) % cnt;
+
+			len += name( src + len, i );
+			len += sprintf( src + len, " := " );
+			len += name( src + len, a );
+			len += sprintf( src + len, " + " );
+			len += name( src + len, b );
+			src[ len++ ] = '\n';
+			ref[ i ] = ref[ a ] + ref[ b ];
+		}
+
+		src[ len ] = 0;
+
+		double ms[ 3 ], best[ 3 ] = { 1e30, 1e30, 1e30 };
+		int right = 1;
+
+		for ( int rep = 0; rep < 3; rep++ )
+		{
+			vvLexTable *tbl = vv_newLexTable( );
+			vvGenerator *gen = vv_newGenerator( VV_CHAR_BUFFER_DEFAULT_LEN );
+			vvVM *vm = run( src, tbl, gen, ms );
+
+			if ( !vm )
+				right = 0;
+			else
+			{
+				for ( int k = 0; k < 3; k++ )
+					if ( ms[ k ] < best[ k ] )
+						best[ k ] = ms[ k ];
+
+				for ( size_t i = 0; i < cnt && right; i++ )
+				{
+					char id[ 16 ];
+					id[ name( id, i ) ] = 0;
+
+					right = global( gen, vm, tbl, id ) == ref[ i ];
+				}
+
+				vv_freeVM( vm );
+			}
+
+			vv_freeGenerator( gen );
+			vv_freeLexTable( tbl );
+		}
+
+		generate[ s ] = best[ 1 ];
+
+		printf( "%8zu %7.1f ms %7.1f ms %7.1f ms %s\n", cnt, best[ 0 ], best[ 1 ], best[ 2 ], right ? "right" : "wrong" );
+
+		failed |= !right;
+
+		free( ref );
+		free( src );
+	}
+
+	int linear = generate[ SIZES - 1 ] <= generate[ 0 ] * 15;
+
+	printf( "generation grew %.1f times\n", generate[ SIZES - 1 ] / generate[ 0 ] );
+
+	failed |= !linear;
+
+	for ( size_t i = 0; i < sizeof( checks ) / sizeof( checks[ 0 ] ); i++ )
+	{
+		char *src = vv_strClone( checks[ i ].src );
+		vvLexTable *tbl = vv_newLexTable( );
+		vvGenerator *gen = vv_newGenerator( VV_CHAR_BUFFER_DEFAULT_LEN );
+		double ms[ 3 ];
+		vvVM *vm = run( src, tbl, gen, ms );
+		int right = vm != NULL;
+
+		// pairs of a global and the number it ends with
+		char id[ 64 ];
+		double expected;
+		int used;
+
+		for ( const char *at = checks[ i ].globals; vm && sscanf( at, "%63s %lf%n", id, &expected, &used ) == 2; at += used )
+			if ( global( gen, vm, tbl, id ) != expected )
+			{
+				printf( "%s = %g, expected %g\n", id, global( gen, vm, tbl, id ), expected );
+				right = 0;
+			}
+
+		printf( "check %zu: %s\n", i, right ? "right" : "wrong" );
+
+		failed |= !right;
+
+		if ( vm )
+			vv_freeVM( vm );
+
+		vv_freeGenerator( gen );
+		vv_freeLexTable( tbl );
+		free( src );
+	}
+
+	puts( failed ? "FAILED" : "ok" );
+
+	return failed;
+}
\ No newline at end of file
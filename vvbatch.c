@@ -0,0 +1,114 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "vvbatch.h"
+
+#include <assert.h>
+
+typedef struct vvBatchJob
+{
+	vvModule *mods;
+	vvLexTable *tbl;
+	int pipeline;
+} vvBatchJob;
+
+// a big enough file is lexed on a thread of its own while it is parsed, if pipeline allows
+static void bmodule( vvModule *mod, vvLexTable *tbl, int pipeline )
+{
+	mod->src = vv_mapFile( mod->fileName );
+
+	if ( mod->src == NULL )
+	{
+		vv_setError( &mod->err, VV_ERR_IO, mod->fileName, 0, 0, "Can't open the file" );
+		mod->result = VV_ERR_IO;
+		return;
+	}
+
+	vvLexer *lex = vv_newLexer( mod->src->data, mod->fileName, VV_CHAR_BUFFER_DEFAULT_LEN, tbl );
+	vvParser *p;
+
+	if ( pipeline && mod->src->len >= VV_PIPELINE_MIN_LEN )
+		p = vv_newPipelinedParser( lex );
+	else
+		p = vv_newParser( lex );
+
+	// worker stacks are no deeper than the main one, nesting must not depend on them
+	p->explicitStack = 1;
+
+	mod->result = vv_parseModule( p, &mod->tree, &mod->err );
+
+	vv_freeParser( p );
+	vv_freeLexer( lex );
+}
+
+static void bcompile( void *ctx, size_t idx )
+{
+	vvBatchJob *job = ( vvBatchJob * ) ctx;
+
+	bmodule( &job->mods[ idx ], job->tbl, job->pipeline );
+}
+
+vvModule *vv_compileFile( char *fn, vvLexTable *tbl )
+{
+	vvModule *rsl = ( vvModule * ) calloc( 1, sizeof( vvModule ) );
+	assert( rsl );
+
+	rsl->fileName = fn;
+	bmodule( rsl, tbl, vv_cpuCount( ) > 1 );
+
+	return rsl;
+}
+
+vvModule *vv_compileBatch( vvPool *pool, char **files, size_t cnt, vvLexTable *tbl )
+{
+	if ( tbl->stripes == NULL )
+		vv_error( VV_ERR_INTERNAL, NULL, 0, 0, "Files compiled together need a shared lex table" );
+
+	vvModule *mods = ( vvModule * ) calloc( cnt ? cnt : 1, sizeof( vvModule ) );
+	assert( mods );
+
+	for ( size_t i = 0; i < cnt; i++ )
+		mods[ i ].fileName = files[ i ];
+
+	// a lexer thread per file only pays off while the files leave cores idle
+	vvBatchJob job = { mods, tbl, cnt * 2 <= vv_cpuCount( ) };
+
+	vv_poolRun( pool, bcompile, &job, cnt );
+
+	return mods;
+}
+
+void vv_freeModules( vvModule *mods, size_t cnt )
+{
+	for ( size_t i = 0; i < cnt; i++ )
+	{
+		if ( mods[ i ].tree )
+			vv_freeSyntaxTree( mods[ i ].tree );
+		if ( mods[ i ].src )
+			vv_freeSource( mods[ i ].src );
+	}
+
+	free( mods );
+}
\ No newline at end of file
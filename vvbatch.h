@@ -0,0 +1,63 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#ifndef VV_BATCH
+#define VV_BATCH
+
+#include "vvcom.h"
+#include "vvlex.h"
+#include "vvparser.h"
+#include "vvthread.h"
+
+#include <stdlib.h>
+
+/*
+Front end for many files at once. The pool takes the files one by one, each
+is read, lexed and parsed on its own and flattened into a module; every lexer
+interns into the same shared table, so the ids of all modules agree and
+codegen can take them as they are. Ids are handed out in the order the
+threads get to them, they are not stable from one run to the next.
+*/
+
+// one compiled file, its tokens keep spans into src; tree is NULL unless result is VV_OK
+typedef struct vvModule
+{
+	char *fileName;
+	vvSource *src;
+	vvSyntaxTree *tree;
+
+	vvResult result;
+	vvError err;
+} vvModule;
+
+// a file from VV_PIPELINE_MIN_LEN on is lexed and parsed on two threads when there is a core to spare
+vvModule *vv_compileFile( char *fn, vvLexTable *tbl );
+// tbl must come from vv_newSharedLexTable, the file names are borrowed; a failed file doesn't stop the others
+vvModule *vv_compileBatch( vvPool *pool, char **files, size_t cnt, vvLexTable *tbl );
+void vv_freeModules( vvModule *mods, size_t cnt );
+
+#endif
\ No newline at end of file
@@ -23,16 +23,27 @@ SOFTWARE.
 */
 
 #include "vvcom.h"
+#include "vvthread.h"
 
 #include <ctype.h>
 #include <limits.h>
 #include <math.h>
+#include <setjmp.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 char *vv_strClone( const char *source )
 {
 	size_t len = strlen( source ) + 1;
@@ -56,20 +67,15 @@ char *vv_readFile( const char *fn )
 
 		char *str = ( char * ) calloc( len, sizeof( char ) );
 		if ( str == NULL )
-			return 0;
-
-		size_t cnt = 0;
-
-		for ( ;; )
 		{
-			int c = fgetc( f );
-
-			if ( c == EOF )
-				break;
-
-			str[ cnt++ ] = ( char ) c;
+			fclose( f );
+			return NULL;
 		}
 
+		// text mode may hand back fewer bytes than ftell reported
+		size_t cnt = fread( str, sizeof( char ), len - 1, f );
+		str[ cnt ] = '\0';
+
 		fclose( f );
 
 		return str;
@@ -78,14 +84,224 @@ char *vv_readFile( const char *fn )
 	return NULL;
 }
 
-void vv_error( const char *msg, ... )
+static vvSource *readSource( const char *fn )
+{
+	char *str = vv_readFile( fn );
+
+	if ( str == NULL )
+		return NULL;
+
+	vvSource *rsl = ( vvSource * ) malloc( sizeof( vvSource ) );
+	assert( rsl );
+
+	rsl->data = str;
+	rsl->len = strlen( str );
+	rsl->mapped = 0;
+	rsl->handle = NULL;
+
+	return rsl;
+}
+
+/*
+The lexer wants a NUL terminated buffer. A mapping only provides one when the
+file does not end on a page boundary, the tail of the last page is then zero
+filled. Every other case falls back to reading the file.
+*/
+vvSource *vv_mapFile( const char *fn )
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA( fn, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+							   FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if ( file == INVALID_HANDLE_VALUE )
+		return NULL;
+
+	LARGE_INTEGER size;
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+
+	if ( !GetFileSizeEx( file, &size ) || size.QuadPart == 0 ||
+		 ( size_t ) size.QuadPart % info.dwPageSize == 0 )
+	{
+		CloseHandle( file );
+		return readSource( fn );
+	}
+
+	HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( file );
+
+	if ( mapping == NULL )
+		return readSource( fn );
+
+	char *data = ( char * ) MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	if ( data == NULL )
+	{
+		CloseHandle( mapping );
+		return readSource( fn );
+	}
+
+	vvSource *rsl = ( vvSource * ) malloc( sizeof( vvSource ) );
+	assert( rsl );
+
+	rsl->data = data;
+	rsl->len = ( size_t ) size.QuadPart;
+	rsl->mapped = 1;
+	rsl->handle = mapping;
+
+	return rsl;
+#else
+	int fd = open( fn, O_RDONLY );
+	if ( fd < 0 )
+		return NULL;
+
+	struct stat st;
+	long page = sysconf( _SC_PAGESIZE );
+
+	if ( fstat( fd, &st ) || st.st_size == 0 || page <= 0 ||
+		 ( size_t ) st.st_size % ( size_t ) page == 0 )
+	{
+		close( fd );
+		return readSource( fn );
+	}
+
+	size_t len = ( size_t ) st.st_size;
+	void *data = mmap( NULL, len, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+
+	if ( data == MAP_FAILED )
+		return readSource( fn );
+
+#ifdef MADV_SEQUENTIAL
+	madvise( data, len, MADV_SEQUENTIAL );
+#endif
+
+	vvSource *rsl = ( vvSource * ) malloc( sizeof( vvSource ) );
+	assert( rsl );
+
+	rsl->data = ( char * ) data;
+	rsl->len = len;
+	rsl->mapped = 1;
+	rsl->handle = NULL;
+
+	return rsl;
+#endif
+}
+
+void vv_freeSource( vvSource *src )
+{
+	if ( src->mapped )
+	{
+#ifdef _WIN32
+		UnmapViewOfFile( src->data );
+		CloseHandle( ( HANDLE ) src->handle );
+#else
+		munmap( src->data, src->len );
+#endif
+	}
+	else
+	{
+		free( src->data );
+	}
+
+	free( src );
+}
+
+size_t vv_fileRefill( void *ud, char *buf, size_t len )
+{
+	FILE *f = ( FILE * ) ud;
+
+	size_t n = fread( buf, sizeof( char ), len, f );
+
+	if ( n == 0 && ferror( f ) )
+		vv_error( VV_ERR_IO, NULL, 0, 0, "Can't read from the input stream" );
+
+	return n;
+}
+
+typedef struct vvErrorScope
+{
+	jmp_buf env;
+	vvError *err;
+	struct vvErrorScope *prev;
+} vvErrorScope;
+
+static VV_THREAD_LOCAL vvErrorScope *errorScope = NULL;
+
+vvResult vv_try( vvError *err, void ( *fn )( void *ud ), void *ud )
+{
+	vvErrorScope scope;
+
+	scope.err = err;
+	scope.prev = errorScope;
+	errorScope = &scope;
+
+	if ( setjmp( scope.env ) )
+	{
+		errorScope = scope.prev;
+		return err->code;
+	}
+
+	fn( ud );
+
+	errorScope = scope.prev;
+	err->code = VV_OK;
+
+	return VV_OK;
+}
+
+static void verrorSet( vvError *err, vvResult code, const char *file, size_t row, size_t col, const char *msg, va_list ap )
+{
+	err->code = code;
+	err->file = file;
+	err->row = row;
+	err->col = col;
+
+	vsnprintf( err->msg, VV_ERROR_MESSAGE_LEN, msg, ap );
+}
+
+void vv_setError( vvError *err, vvResult code, const char *file, size_t row, size_t col, const char *msg, ... )
 {
 	va_list ap;
 
 	va_start( ap, msg );
+	verrorSet( err, code, file, row, col, msg, ap );
+	va_end( ap );
+}
 
-	vprintf( msg, ap );
+void vv_raise( const vvError *err )
+{
+	static const char *kinds[] = {
+		[VV_OK] = "No error",
+		[VV_ERR_SYNTAX] = "Syntax error",
+		[VV_ERR_COMPILE] = "Compiler error",
+		[VV_ERR_RUNTIME] = "Runtime error",
+		[VV_ERR_IO] = "IO error",
+		[VV_ERR_INTERNAL] = "Internal error",
+	};
+
+	if ( errorScope )
+	{
+		if ( errorScope->err != err )
+			*errorScope->err = *err;
+
+		longjmp( errorScope->env, 1 );
+	}
+
+	if ( err->file && err->row )
+		printf( "[%s %zd:%zd] %s", err->file, err->row, err->col, err->msg );
+	else
+		printf( "[%s] %s", err->file ? err->file : kinds[ err->code ], err->msg );
 
-	va_end( ap );
 	abort( );
 }
+
+void vv_error( vvResult code, const char *file, size_t row, size_t col, const char *msg, ... )
+{
+	vvError err;
+	va_list ap;
+
+	va_start( ap, msg );
+	verrorSet( &err, code, file, row, col, msg, ap );
+	va_end( ap );
+
+	vv_raise( &err );
+}
\ No newline at end of file
@@ -27,8 +27,55 @@ SOFTWARE.
 #ifndef VV_COMMON
 #define VV_COMMON
 
+#include <stdlib.h>
+
+typedef struct vvSource
+{
+	char *data;
+	size_t len;
+
+	int mapped;
+	void *handle;
+} vvSource;
+
+typedef enum vvResult
+{
+	VV_OK = 0,
+	VV_ERR_SYNTAX,	 // lexer and parser
+	VV_ERR_COMPILE,	 // code generation
+	VV_ERR_RUNTIME,	 // the VM
+	VV_ERR_IO,		 // files and streams
+	VV_ERR_INTERNAL, // limits of the implementation, misuse of the API
+} vvResult;
+
+#define VV_ERROR_MESSAGE_LEN 256
+
+// row and col are 0 when the error has no position, file is NULL when it has no file
+typedef struct vvError
+{
+	vvResult code;
+	const char *file;
+	size_t row, col;
+	char msg[ VV_ERROR_MESSAGE_LEN ];
+} vvError;
+
 char *vv_strClone( const char *source );
 char *vv_readFile( const char *fn );
-void vv_error( const char *msg, ... );
+vvSource *vv_mapFile( const char *fn );
+void vv_freeSource( vvSource *src );
+// refill callback for stream lexers, ud is a FILE * ( stdin works too )
+size_t vv_fileRefill( void *ud, char *buf, size_t len );
+
+/*
+Errors unwind to the innermost vv_try of the calling thread, which returns
+the code and leaves the details in err. Without one the error is printed
+and the process aborts. Whatever the unwound code had allocated belongs to
+the objects it was working on, free those after a failed vv_try.
+*/
+vvResult vv_try( vvError *err, void ( *fn )( void *ud ), void *ud );
+void vv_error( vvResult code, const char *file, size_t row, size_t col, const char *msg, ... );
+// raises an error caught elsewhere, another thread for one, on this thread
+void vv_raise( const vvError *err );
+void vv_setError( vvError *err, vvResult code, const char *file, size_t row, size_t col, const char *msg, ... );
 
 #endif
\ No newline at end of file
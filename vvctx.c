@@ -0,0 +1,95 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "vvctx.h"
+#include "vvthread.h"
+
+#include <assert.h>
+
+static VV_THREAD_LOCAL vvContext *idleContexts = NULL;
+static VV_THREAD_LOCAL size_t idleCnt = 0;
+
+vvContext *vv_acquireContext( char *input, char *fn, vvLexTable *tbl )
+{
+	vvContext *rsl = idleContexts;
+
+	if ( rsl == NULL )
+	{
+		rsl = ( vvContext * ) malloc( sizeof( vvContext ) );
+		assert( rsl );
+
+		rsl->lex = vv_newLexer( input, fn, VV_CHAR_BUFFER_DEFAULT_LEN, tbl );
+		rsl->p = vv_newParser( rsl->lex );
+		rsl->gen = vv_newGenerator( VV_CODEGEN_BUFFER_DEFAULT_LEN );
+		rsl->gen->fileName = fn;
+		rsl->next = NULL;
+
+		return rsl;
+	}
+
+	idleContexts = rsl->next;
+	idleCnt--;
+
+	vv_lexerReset( rsl->lex, input, fn, tbl );
+	vv_parserReset( rsl->p, rsl->lex );
+	vv_generatorReset( rsl->gen );
+	rsl->gen->fileName = fn;
+	rsl->next = NULL;
+
+	return rsl;
+}
+
+static void cfree( vvContext *ctx )
+{
+	vv_freeGenerator( ctx->gen );
+	vv_freeParser( ctx->p );
+	vv_freeLexer( ctx->lex );
+	free( ctx );
+}
+
+void vv_releaseContext( vvContext *ctx )
+{
+	if ( idleCnt >= VV_CONTEXT_POOL_MAX )
+	{
+		cfree( ctx );
+		return;
+	}
+
+	ctx->next = idleContexts;
+	idleContexts = ctx;
+	idleCnt++;
+}
+
+void vv_freeThreadContexts( )
+{
+	while ( idleContexts )
+	{
+		vvContext *next = idleContexts->next;
+		cfree( idleContexts );
+		idleContexts = next;
+	}
+
+	idleCnt = 0;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#ifndef VV_CONTEXT
+#define VV_CONTEXT
+
+#include "vvcom.h"
+#include "vvgen.h"
+#include "vvlex.h"
+#include "vvparser.h"
+
+#include <stdlib.h>
+
+/*
+Everything one compilation needs, kept per thread and reused. A context
+handed out by vv_acquireContext has its lexer on the given input, a parser
+on that lexer and an empty generator naming fn in its errors, all holding
+on to the buffers they grew for earlier inputs. Compiling many small scripts
+then costs about as much as the work on them, not the mallocs to set it up.
+*/
+typedef struct vvContext
+{
+	vvLexer *lex;
+	vvParser *p;
+	vvGenerator *gen;
+
+	struct vvContext *next;
+} vvContext;
+
+// idle contexts a thread keeps, the ones released beyond it are freed
+#define VV_CONTEXT_POOL_MAX 4
+
+vvContext *vv_acquireContext( char *input, char *fn, vvLexTable *tbl );
+// must be released on the thread that acquired it
+void vv_releaseContext( vvContext *ctx );
+// frees the idle contexts of the calling thread, for threads about to exit
+void vv_freeThreadContexts( );
+
+#endif
\ No newline at end of file
@@ -34,14 +34,103 @@ SOFTWARE.
 #include <string.h>
 #include "vvvm.h"
 #include "vvop.h"
+#include "vvcom.h"
 #include "vvparser.h"
 #include "vvlex.h"
+#include "vvopt.h"
 
 #define destroyVar( v ) ( v->identifier = 0 )
 #define isNullVar( v ) ( v.identifier == 0 )
 
 size_t vv_symTableAdd( vvSymTable *tbl, vvVarType type, vvGenVar v );
 
+// interned names are dense small numbers, multiplying spreads them over the slots
+static size_t gmapHash( vvString key, size_t len )
+{
+	return ( size_t ) ( ( ( uint64_t ) key * 0x9E3779B97F4A7C15ull ) >> 32 ) & ( len - 1 );
+}
+
+static void gmapAlloc( vvSymMap *map, size_t len )
+{
+	map->keys = ( vvString * ) malloc( len * sizeof( vvString ) );
+	assert( map->keys );
+	map->vals = ( size_t * ) malloc( len * sizeof( size_t ) );
+	assert( map->vals );
+	map->stamps = ( unsigned * ) calloc( len, sizeof( unsigned ) );
+	assert( map->stamps );
+
+	map->stamp = 1;
+	map->cnt = 0;
+	map->len = len;
+}
+
+static void gmapFree( vvSymMap *map )
+{
+	free( map->keys );
+	free( map->vals );
+	free( map->stamps );
+}
+
+static void gmapClear( vvSymMap *map )
+{
+	map->cnt = 0;
+
+	if ( ++map->stamp == 0 )
+	{
+		memset( map->stamps, 0, map->len * sizeof( unsigned ) );
+		map->stamp = 1;
+	}
+}
+
+// NULL if key is not in the map
+static size_t *gmapGet( vvSymMap *map, vvString key )
+{
+	for ( size_t i = gmapHash( key, map->len );; i = ( i + 1 ) & ( map->len - 1 ) )
+	{
+		if ( map->stamps[ i ] != map->stamp )
+			return NULL;
+		if ( map->keys[ i ] == key )
+			return &map->vals[ i ];
+	}
+}
+
+static void gmapPut( vvSymMap *map, vvString key, size_t val );
+
+// kept at most half full
+static void gmapGrow( vvSymMap *map )
+{
+	vvSymMap old = *map;
+
+	gmapAlloc( map, old.len * 2 );
+
+	for ( size_t i = 0; i < old.len; i++ )
+		if ( old.stamps[ i ] == old.stamp )
+			gmapPut( map, old.keys[ i ], old.vals[ i ] );
+
+	gmapFree( &old );
+}
+
+static void gmapPut( vvSymMap *map, vvString key, size_t val )
+{
+	if ( 2 * ( map->cnt + 1 ) > map->len )
+		gmapGrow( map );
+
+	for ( size_t i = gmapHash( key, map->len );; i = ( i + 1 ) & ( map->len - 1 ) )
+	{
+		if ( map->stamps[ i ] != map->stamp )
+		{
+			map->keys[ i ] = key;
+			map->stamps[ i ] = map->stamp;
+			map->cnt++;
+		}
+		else if ( map->keys[ i ] != key )
+			continue;
+
+		map->vals[ i ] = val;
+		return;
+	}
+}
+
 vvSymTable *vv_newSymTable( )
 {
 	vvSymTable *rsl = ( vvSymTable * ) malloc( sizeof( vvSymTable ) );
@@ -52,6 +141,7 @@ vvSymTable *vv_newSymTable( )
 	assert( sections );
 
 	rsl->sections = sections;
+	gmapAlloc( &rsl->names, VV_SYM_MAP_DEFAULT_LEN );
 
 	for ( int i = 0; i < FLAG_VAR_AMOUNT; i++ )
 	{
@@ -61,10 +151,28 @@ vvSymTable *vv_newSymTable( )
 		rsl->sections[ i ] = ( vvSymSection ){ 0, VV_STORAGE_DEFAULT, sto };
 	}
 
+	vv_symTableReset( rsl );
+
+	return rsl;
+}
+
+void vv_symTableReset( vvSymTable *tbl )
+{
+	gmapClear( &tbl->names );
+
+	for ( int i = 0; i < FLAG_VAR_AMOUNT; i++ )
+	{
+		vvSymSection *section = &tbl->sections[ i ];
+
+		// slots past idx may be taken too, see vv_symTableConst
+		memset( section->sto, 0, sizeof( vvGenVar ) * section->len );
+		section->idx = 0;
+	}
+
 	// adding const: true false nil
 	for ( size_t i = 0; i < 3; i++ )
 	{
-		vv_symTableAdd( rsl, VAR_CONST, ( vvGenVar ){
+		vv_symTableAdd( tbl, VAR_CONST, ( vvGenVar ){
 											.identifier = TT_TRUE + i,
 											.idx = i,
 										} );
@@ -72,45 +180,36 @@ vvSymTable *vv_newSymTable( )
 
 	for ( size_t i = 0; i < VV_REGISTER_COUNT; i++ )
 	{
-		vv_symTableAdd( rsl, VAR_REGISTER, ( vvGenVar ){
+		vv_symTableAdd( tbl, VAR_REGISTER, ( vvGenVar ){
 											   .identifier = VV_NAMELESS,
 											   .idx = i,
 										   } );
 	}
-
-	return rsl;
 }
 
-void vv_symTableExpand( vvSymTable *tbl, vvVarType type )
+static void gsectionExpand( vvSymSection *section )
 {
-	vvSymSection *section = &tbl->sections[ type ];
-
-	section->len += VV_SYM_TABLE_STEP;
+	size_t len = section->len ? section->len * 2 : VV_LOCAL_SECTION_DEFAULT;
 
-	vvGenVar *sto = ( vvGenVar * ) realloc( section->sto, sizeof( vvGenVar ) * section->len );
+	vvGenVar *sto = ( vvGenVar * ) realloc( section->sto, sizeof( vvGenVar ) * len );
 	assert( sto );
 	// fill with NULL_VAR (0)
-	memset( sto + ( section->len - VV_SYM_TABLE_STEP - 1 ), 0, sizeof( vvGenVar ) * VV_SYM_TABLE_STEP );
+	memset( sto + section->len, 0, sizeof( vvGenVar ) * ( len - section->len ) );
 
 	section->sto = sto;
+	section->len = len;
+}
+
+void vv_symTableExpand( vvSymTable *tbl, vvVarType type )
+{
+	gsectionExpand( &tbl->sections[ type ] );
 }
 
-// return NULL if not found
 vvGenVar *vv_symTableGet( vvSymTable *tbl, vvString id )
 {
-	for ( size_t i = 0; i < FLAG_VAR_AMOUNT; i++ )
-	{
-		for ( size_t j = 0; j < tbl->sections[ i ].len; j++ )
-		{
-			vvGenVar *rsl = &tbl->sections[ i ].sto[ j ];
-			if ( rsl->identifier == id )
-			{
-				return rsl;
-			}
-		}
-	}
+	size_t *idx = gmapGet( &tbl->names, id );
 
-	return NULL;
+	return idx ? &tbl->sections[ VAR_MEMORY ].sto[ *idx ] : NULL;
 }
 
 size_t vv_symTableAdd( vvSymTable *tbl, vvVarType type, vvGenVar v )
@@ -163,8 +262,44 @@ vvGenVar *vv_symTableGetConst( vvSymTable *tbl, size_t idx )
 	return NULL;
 }
 
+// VAR_CONST slot of a constant pool entry ( the val of a TT_NUMBER token )
+vvGenVar *vv_symTableConst( vvSymTable *tbl, size_t cst )
+{
+	size_t idx = VV_CONST_BUILTINS + cst;
+	vvSymSection *section = &tbl->sections[ VAR_CONST ];
+
+	while ( idx >= section->len )
+		vv_symTableExpand( tbl, VAR_CONST );
+
+	vvGenVar *var = &section->sto[ idx ];
+
+	var->identifier = VV_NAMELESS;
+	var->type = VAR_CONST;
+	var->idx = idx;
+
+	if ( section->idx <= idx )
+		section->idx = idx + 1;
+
+	return var;
+}
+
+vvGenVar *vv_symTableDeclare( vvSymTable *tbl, vvString id, size_t idx )
+{
+	vvSymSection *section = &tbl->sections[ VAR_MEMORY ];
+
+	vv_symTableAdd( tbl, VAR_MEMORY, ( vvGenVar ){
+										 .identifier = id,
+										 .idx = idx,
+									 } );
+	gmapPut( &tbl->names, id, section->idx - 1 );
+
+	return &section->sto[ section->idx - 1 ];
+}
+
 void vv_freeSymTable( vvSymTable *tbl )
 {
+	gmapFree( &tbl->names );
+
 	for ( int i = 0; i < FLAG_VAR_AMOUNT; i++ )
 	{
 		free( tbl->sections[ i ].sto );
@@ -187,37 +322,49 @@ vvGenField *vv_newGenField( )
 
 	locals->idx = 0;
 	locals->len = VV_LOCAL_SECTION_DEFAULT;
-	locals->sto = ( vvGenVar * ) malloc( sizeof( vvGenVar ) * VV_LOCAL_SECTION_DEFAULT );
+	locals->sto = ( vvGenVar * ) calloc( VV_LOCAL_SECTION_DEFAULT, sizeof( vvGenVar ) );
 	assert( locals->sto );
 
+	gmapAlloc( &rsl->names, VV_SYM_MAP_DEFAULT_LEN );
+
+	rsl->boundary = 0;
+	rsl->next = NULL;
+
 	return rsl;
 }
 
 void vv_freeGenField( vvGenField *field );
 vvGenField *vv_fieldStackPop( vvFieldStack *stack );
-void vv_genFieldLeave( vvGenField *field, vvGenerator *gen )
+vvGenField *vv_fieldStackPeek( vvFieldStack *stack );
+// a field left before, or a new one
+vvGenField *vv_genFieldTake( vvGenerator *gen )
 {
-	if ( gen->fields->top == -1 )
-		gen->curField = VV_GLOBAL_FIELD;
-	else
-		gen->curField = vv_fieldStackPop( gen->fields );
+	vvGenField *rsl = gen->spareFields;
+
+	if ( rsl == NULL )
+		return vv_newGenField( );
 
-	vv_freeGenField( field );
+	gen->spareFields = rsl->next;
+	rsl->locals->idx = 0;
+	rsl->boundary = 0;
+	gmapClear( &rsl->names );
+
+	return rsl;
 }
 
-vvGenVar *vv_genFieldGet( vvGenField *field, vvString id )
+void vv_genFieldLeave( vvGenField *field, vvGenerator *gen )
 {
-	vvSymSection *section = field->locals;
+	gen->curField = vv_fieldStackPeek( gen->fields );
 
-	for ( size_t i = 0; i < section->idx; i++ )
-	{
-		vvGenVar *v = &section->sto[ i ];
+	field->next = gen->spareFields;
+	gen->spareFields = field;
+}
 
-		if ( v->identifier == id )
-			return v;
-	}
+vvGenVar *vv_genFieldGet( vvGenField *field, vvString id )
+{
+	size_t *idx = gmapGet( &field->names, id );
 
-	return NULL;
+	return idx ? &field->locals->sto[ *idx ] : NULL;
 }
 
 vvGenVar *vv_genFieldAlloc( vvGenField *field )
@@ -225,50 +372,7 @@ vvGenVar *vv_genFieldAlloc( vvGenField *field )
 	vvSymSection *section = field->locals;
 
 	if ( section->idx >= section->len )
-	{
-		for ( size_t i = 0; i < section->len; i++ )
-		{
-			if ( isNullVar( section->sto[ i ] ) )
-			{
-				vvGenVar *rsl = &section->sto[ i ];
-				rsl->identifier = VV_NAMELESS;
-				rsl->type = VAR_LOCAL;
-				rsl->idx = 0;
-
-				return rsl;
-			}
-		}
-
-		section->len += VV_SYM_TABLE_STEP;
-		vvGenVar *temp = ( vvGenVar * ) realloc( section->sto, section->len );
-		assert( temp );
-		section->sto = temp;
-
-		vvGenVar *rsl = &section->sto[ section->idx++ ];
-		rsl->identifier = VV_NAMELESS;
-		rsl->type = VAR_LOCAL;
-		rsl->idx = 0;
-
-		return rsl;
-	}
-
-	if ( !isNullVar( section->sto[ section->idx ] ) )
-	{
-		do
-		{
-			section->idx++;
-
-			if ( section->idx >= section->len )
-			{
-				section->len += VV_SYM_TABLE_STEP;
-				vvGenVar *temp = ( vvGenVar * ) realloc( section->sto, section->len );
-				assert( temp );
-				section->sto = temp;
-
-				break;
-			}
-		} while ( isNullVar( section->sto[ section->idx ] ) );
-	}
+		gsectionExpand( section );
 
 	vvGenVar *rsl = &section->sto[ section->idx++ ];
 	rsl->identifier = VV_NAMELESS;
@@ -278,8 +382,21 @@ vvGenVar *vv_genFieldAlloc( vvGenField *field )
 	return rsl;
 }
 
+vvGenVar *vv_genFieldDeclare( vvGenField *field, vvString id, vvVarType type, size_t idx )
+{
+	vvGenVar *rsl = vv_genFieldAlloc( field );
+
+	rsl->identifier = id;
+	rsl->type = type;
+	rsl->idx = idx;
+	gmapPut( &field->names, id, field->locals->idx - 1 );
+
+	return rsl;
+}
+
 void vv_freeGenField( vvGenField *field )
 {
+	gmapFree( &field->names );
 	free( field->locals->sto );
 	free( field->locals );
 
@@ -342,9 +459,7 @@ vvGenField *vv_fieldStackPop( vvFieldStack *stack )
 void vv_fieldStackPush( vvFieldStack *stack, vvGenField *val )
 {
 	if ( stack->top + 1 >= ( int ) stack->len )
-	{
-		vv_error( "[Compiler error] Stack overflowed" );
-	}
+		vv_fieldStackResize( stack, stack->len * 2 );
 
 	stack->storage[ ++stack->top ] = val;
 }
@@ -362,6 +477,37 @@ vvGenField *vv_fieldStackFetch( vvGenerator *gen, vvFieldStack *stack )
 	vv_fieldStackPop( gen->fields ); \
 	vv_genFieldLeave( f, gen );
 
+// back to the global field, whatever was entered goes to the spares
+static void gfieldsDrop( vvGenerator *gen )
+{
+	vvGenField *field;
+
+	while ( ( field = vv_fieldStackPop( gen->fields ) ) )
+	{
+		field->next = gen->spareFields;
+		gen->spareFields = field;
+	}
+
+	gen->curField = VV_GLOBAL_FIELD;
+}
+
+void vv_genEnterField( vvGenerator *gen, int boundary )
+{
+	vvGenField *field = vv_genFieldTake( gen );
+
+	field->boundary = boundary;
+	field->base = gen->locCnt;
+	ENTER_FIELD( field );
+}
+
+void vv_genLeaveField( vvGenerator *gen )
+{
+	vvGenField *field = gen->curField;
+
+	gen->locCnt = field->base;
+	LEAVE_FIELD( field );
+}
+
 vvGenerator *vv_newGenerator( size_t bufLen )
 {
 	vvGenerator *rsl = ( vvGenerator * ) malloc( sizeof( vvGenerator ) );
@@ -373,55 +519,1786 @@ vvGenerator *vv_newGenerator( size_t bufLen )
 	rsl->buf = ( vvOpData * ) calloc( bufLen, sizeof( vvOpData ) );
 	assert( rsl->buf );
 
+	rsl->regCnt = 0;
+	rsl->calls = NULL;
+	rsl->callCnt = rsl->callLen = 0;
+	rsl->locCnt = rsl->locMax = 0;
+
+	rsl->outer = NULL;
+	rsl->outerCnt = rsl->outerLen = 0;
+
+	rsl->funcs = NULL;
+	rsl->funcLens = NULL;
+	rsl->funcCnt = rsl->funcLen = 0;
+
+	rsl->fileName = NULL;
+	rsl->memCnt = 0;
+	rsl->optimize = 0;
+	rsl->buildIR = 0;
+	rsl->optRemoved = rsl->optHoisted = rsl->optMerged = 0;
+	rsl->irs = NULL;
+	rsl->irCnt = rsl->irLen = 0;
+	rsl->reuse = rsl->reuseEnd = 0;
+	rsl->depth = 0;
+	rsl->row = rsl->col = 0;
+
+	rsl->work = NULL;
+	rsl->workCnt = rsl->workLen = 0;
+
+	rsl->ivs = NULL;
+	rsl->order = rsl->marks = NULL;
+	rsl->ivLen = rsl->marksLen = 0;
+	rsl->out = NULL;
+	rsl->outLen = 0;
+
 	rsl->tbl = vv_newSymTable( );
 
 	rsl->fields = vv_newFieldStack( VV_STORAGE_DEFAULT );
 	rsl->curField = VV_GLOBAL_FIELD;
+	rsl->spareFields = NULL;
 
 	return rsl;
 }
 
-// vv_genFindVar, vv_genTryAlloc, vv_genGetLVal, vv_genGetRVal, vv_genLoad, vv_genStore
-// vv_genSave, vv_genFlush, vv_generateExpr
+static void gfuncsDrop( vvGenerator *gen );
+static void gfuncsFree( vvGenerator *gen, size_t from );
 
-//statement ::= assign_expr | def_stmt | call_expr
-//			| when_stmt | while_stmt | ret_stmt | block
-void vv_generateStatement( vvGenerator *gen, vvSyntaxContainer *stmt )
+void vv_generatorReset( vvGenerator *gen )
+{
+	gfuncsDrop( gen );
+	gfuncsFree( gen, 0 );
+
+	memset( gen->buf, 0, gen->cnt * sizeof( vvOpData ) );
+	gen->cnt = 0;
+	gen->regCnt = 0;
+	gen->callCnt = 0;
+	gen->locCnt = gen->locMax = 0;
+	gen->fileName = NULL;
+	gen->memCnt = 0;
+	gen->optimize = 0;
+	gen->buildIR = 0;
+	gen->reuse = gen->reuseEnd = 0;
+	gen->optRemoved = gen->optHoisted = gen->optMerged = 0;
+
+	vv_symTableReset( gen->tbl );
+
+	gfieldsDrop( gen );
+}
+
+// ST_EQ_EXPR to ST_OR_EXPR
+static const vvOpcode gbinops[ ] = {
+	OP_EQ,
+	OP_NEQ,
+	OP_GE,
+	OP_GT,
+	OP_LE,
+	OP_LT,
+	OP_ADD,
+	OP_SUB,
+	OP_MUL,
+	OP_DIV,
+	OP_AND,
+	OP_OR,
+};
+
+#define gisBinary( st ) ( ( st ) >= ST_EQ_EXPR && ( st ) <= ST_OR_EXPR )
+
+// grows *sto to hold at least need items of size bytes
+static void ggrow( void **sto, size_t *len, size_t need, size_t size )
+{
+	if ( need <= *len )
+		return;
+
+	size_t l = *len ? *len : VV_CODEGEN_BUFFER_DEFAULT_LEN;
+
+	while ( l < need )
+		l *= 2;
+
+	void *temp = realloc( *sto, l * size );
+	assert( temp );
+
+	*sto = temp;
+	*len = l;
+}
+
+static size_t gemit( vvGenerator *gen, vvOpcode op, size_t A, size_t B, size_t C )
+{
+	ggrow( ( void ** ) &gen->buf, &gen->len, gen->cnt + 1, sizeof( vvOpData ) );
+
+	gen->buf[ gen->cnt ] = ( vvOpData ){
+		.op = op,
+		.info = { gen->row, gen->col },
+		.A = A,
+		.B = B,
+		.C = C,
+	};
+
+	return gen->cnt++;
+}
+
+#define gnewReg( gen ) ( ( gen )->regCnt++ )
+
+static void gat( vvGenerator *gen, vvSyntaxTree *tree, vvSyntaxNode *node )
+{
+	if ( node->tk == VV_NODE_NONE )
+		return;
+
+	gen->row = vv_treeTkRows( tree )[ node->tk ];
+	gen->col = vv_treeTkCols( tree )[ node->tk ];
+}
+
+static void genter( vvGenerator *gen )
+{
+	if ( ++gen->depth > VV_CODEGEN_DEPTH_MAX )
+		vv_error( VV_ERR_COMPILE, gen->fileName, gen->row, gen->col, "Code nested too deeply" );
+}
+
+static void gworkPush( vvGenerator *gen, size_t val )
 {
-	vvSyntaxType st = stmt->st;
+	ggrow( ( void ** ) &gen->work, &gen->workLen, gen->workCnt + 1, sizeof( size_t ) );
+	gen->work[ gen->workCnt++ ] = val;
+}
+
+vvGenVar *vv_genFindVar( vvGenerator *gen, vvString id )
+{
+	vvFieldStack *fields = gen->fields;
 
-	switch ( st )
+	for ( int i = fields->top; i >= 0; i-- )
 	{
-		case ST_ASSIGN_EXPR:
-			break;
-		case ST_DEF_STMT:
-			break;
-		case ST_DEF_PARTIAL_STMT:
-			break;
-		case ST_CALL_EXPR:
+		vvGenVar *rsl = vv_genFieldGet( fields->storage[ i ], id );
+
+		if ( rsl )
+			return rsl;
+		if ( fields->storage[ i ]->boundary )
 			break;
+	}
 
-		case ST_WHEN_STMT:
+	vvGenVar *rsl = vv_symTableGet( gen->tbl, id );
+
+	return rsl ? rsl : vv_symTableDeclare( gen->tbl, id, gen->memCnt++ );
+}
+
+vvGenVar *vv_genDeclare( vvGenerator *gen, vvString id )
+{
+	if ( gen->curField == VV_GLOBAL_FIELD )
+	{
+		vvGenVar *rsl = vv_symTableGet( gen->tbl, id );
+
+		return rsl ? rsl : vv_symTableDeclare( gen->tbl, id, gen->memCnt++ );
+	}
+
+	vvGenVar *rsl = vv_genFieldGet( gen->curField, id );
+
+	if ( rsl )
+		return rsl;
+
+	// values of a vvIR, the index only tells the variables apart
+	if ( gen->buildIR )
+		return vv_genFieldDeclare( gen->curField, id, VAR_LOCAL, gen->locCnt++ );
+
+	// the blocks of the module are only run once, their locals can stay in memory
+	if ( gen->outerCnt == 0 )
+		return vv_genFieldDeclare( gen->curField, id, VAR_MEMORY, gen->memCnt++ );
+
+	if ( ++gen->locCnt > gen->locMax )
+		gen->locMax = gen->locCnt;
+
+	return vv_genFieldDeclare( gen->curField, id, VAR_LOCAL, gen->locCnt - 1 );
+}
+
+static void gload( vvGenerator *gen, size_t reg, vvGenVar *var )
+{
+	gemit( gen, var->type == VAR_LOCAL ? OP_LOADL : OP_LOAD, reg, var->idx, 0 );
+}
+
+static void gstore( vvGenerator *gen, vvGenVar *var, size_t reg )
+{
+	gemit( gen, var->type == VAR_LOCAL ? OP_STOREL : OP_STORE, var->idx, reg, 0 );
+}
+
+// the interned name a statement or primary holds
+#define gtkVal( tree, node ) ( vv_treeTkVals( tree )[ ( node )->tk ] )
+
+static size_t gprimary( vvGenerator *gen, vvSyntaxTree *tree, vvSyntaxNode *node )
+{
+	size_t rsl = gnewReg( gen );
+	uint32_t val = gtkVal( tree, node );
+
+	switch ( vv_treeTkTypes( tree )[ node->tk ] )
+	{
+		case TT_NUMBER:
+			gemit( gen, OP_LOADK, rsl, vv_symTableConst( gen->tbl, val )->idx, 0 );
 			break;
-		case ST_WHILE_STMT:
+		case TT_TRUE:
+		case TT_FALSE:
+		case TT_NIL:
+			gemit( gen, OP_LOADK, rsl, vv_treeTkTypes( tree )[ node->tk ] - TT_TRUE, 0 );
 			break;
-		case ST_RET_STMT:
+		case TT_STRING:
+			gemit( gen, OP_LOADS, rsl, val, 0 );
 			break;
-		case ST_BLOCK:
+		case TT_IDENTIFIER:
+			gload( gen, rsl, vv_genFindVar( gen, val ) );
 			break;
 		default:
-			vv_error( "[Compiler error] Not a statement" );
-			return;
+			vv_error( VV_ERR_COMPILE, gen->fileName, gen->row, gen->col, "Not a value" );
 	}
+
+	return rsl;
 }
 
-void vv_generateBlock( vvGenerator *gen )
+// the callee and the arguments are evaluated before anything is pushed
+static size_t gcall( vvGenerator *gen, vvSyntaxTree *tree, vvSyntaxNode *node )
 {
+	vvSyntaxNode *nodes = vv_treeNodes( tree );
+	size_t base = gen->workCnt;
+	size_t fn = vv_generateExpr( gen, tree, node->children[ 0 ] );
+
+	for ( vvNode arg = node->children[ 1 ]; arg != VV_NODE_NONE; arg = nodes[ arg ].next )
+		gworkPush( gen, vv_generateExpr( gen, tree, arg ) );
+
+	gat( gen, tree, node );
+
+	size_t argc = gen->workCnt - base;
+	vvGenCall call = { gen->cnt, 0, 0 };
+
+	for ( size_t i = base; i < gen->workCnt; i++ )
+		gemit( gen, OP_PUSH, gen->work[ i ], 0, 0 );
+
+	gen->workCnt = base;
+
+	size_t rsl = gnewReg( gen );
+
+	gemit( gen, OP_CALL, fn, argc, 0 );
+	call.to = gemit( gen, OP_POP, rsl, 0, 0 );
+
+	ggrow( ( void ** ) &gen->calls, &gen->callLen, gen->callCnt + 1, sizeof( vvGenCall ) );
+	gen->calls[ gen->callCnt++ ] = call;
+
+	return rsl;
 }
 
-void vv_freeGenerator( vvGenerator *gen )
+static size_t gfunction( vvGenerator *gen, vvSyntaxTree *tree, vvSyntaxNode *node );
+
+// left operands are chained down the tree, the chain is kept on the work stack instead of the C stack
+static size_t gbinary( vvGenerator *gen, vvSyntaxTree *tree, vvNode expr )
 {
-	free( gen->buf );
+	vvSyntaxNode *nodes = vv_treeNodes( tree );
+	size_t base = gen->workCnt;
+
+	while ( gisBinary( nodes[ expr ].st ) )
+	{
+		gworkPush( gen, expr );
+		expr = nodes[ expr ].children[ 0 ];
+	}
+
+	size_t rsl = vv_generateExpr( gen, tree, expr );
+
+	while ( gen->workCnt > base )
+	{
+		vvSyntaxNode *node = &nodes[ gen->work[ --gen->workCnt ] ];
+		size_t right = vv_generateExpr( gen, tree, node->children[ 1 ] );
+		size_t left = rsl;
+
+		gat( gen, tree, node );
+		rsl = gnewReg( gen );
+		gemit( gen, gbinops[ node->st - ST_EQ_EXPR ], rsl, left, right );
+	}
+
+	return rsl;
+}
+
+size_t vv_generateExpr( vvGenerator *gen, vvSyntaxTree *tree, vvNode expr )
+{
+	vvSyntaxNode *node = &vv_treeNodes( tree )[ expr ];
+	size_t rsl;
+
+	genter( gen );
+	gat( gen, tree, node );
+
+	switch ( ( vvSyntaxType ) node->st )
+	{
+		case ST_PRIMARY:
+			rsl = gprimary( gen, tree, node );
+			break;
+		case ST_FUNC_EXPR:
+		{
+			size_t func = gfunction( gen, tree, node );
+
+			rsl = gnewReg( gen );
+			gemit( gen, OP_LOADF, rsl, func, 0 );
+			break;
+		}
+		case ST_CALL_EXPR:
+			rsl = gcall( gen, tree, node );
+			break;
+		case ST_NOT_EXPR:
+		case ST_INV_EXPR:
+		{
+			size_t val = vv_generateExpr( gen, tree, node->children[ 0 ] );
+
+			gat( gen, tree, node );
+			rsl = gnewReg( gen );
+			gemit( gen, node->st == ST_NOT_EXPR ? OP_NOT : OP_INV, rsl, val, 0 );
+			break;
+		}
+		default:
+			if ( !gisBinary( node->st ) )
+				vv_error( VV_ERR_COMPILE, gen->fileName, gen->row, gen->col, "Not an expression" );
+
+			rsl = gbinary( gen, tree, expr );
+	}
+
+	gen->depth--;
+
+	return rsl;
+}
+
+static void girUnit( vvGenerator *gen, vvSyntaxTree *tree, vvNode stmt, int chain );
+
+// a block is a scope of its own
+void vv_generateBlock( vvGenerator *gen, vvSyntaxTree *tree, vvNode block )
+{
+	vvSyntaxNode *nodes = vv_treeNodes( tree );
+
+	if ( gen->buildIR )
+	{
+		girUnit( gen, tree, block, 0 );
+		return;
+	}
+
+	vv_genEnterField( gen, 0 );
+
+	for ( vvNode stmt = nodes[ block ].children[ 0 ]; stmt != VV_NODE_NONE; stmt = nodes[ stmt ].next )
+		vv_generateFlatStatement( gen, tree, stmt );
+
+	vv_genLeaveField( gen );
+}
+
+// every function leaves with one value, nil when it falls off its end
+static void greturn( vvGenerator *gen, size_t val )
+{
+	if ( gen->outerCnt == 0 )
+	{
+		gemit( gen, OP_HALT, 0, 0, 0 );
+		return;
+	}
+
+	if ( val == SIZE_MAX )
+	{
+		val = gnewReg( gen );
+		gemit( gen, OP_LOADK, val, TT_NIL - TT_TRUE, 0 );
+	}
+
+	gemit( gen, OP_PUSH, val, 0, 0 );
+	gemit( gen, OP_LEAV, 1, 0, 0 );
+}
+
+//statement ::= assign_expr | def_stmt | call_expr
+//			| when_stmt | while_stmt | ret_stmt | block
+void vv_generateFlatStatement( vvGenerator *gen, vvSyntaxTree *tree, vvNode stmt )
+{
+	vvSyntaxNode *node = &vv_treeNodes( tree )[ stmt ];
+
+	if ( gen->buildIR )
+	{
+		girUnit( gen, tree, stmt, 0 );
+		return;
+	}
+
+	genter( gen );
+	gat( gen, tree, node );
+
+	switch ( ( vvSyntaxType ) node->st )
+	{
+		case ST_ASSIGN_EXPR:
+		{
+			size_t val = vv_generateExpr( gen, tree, node->children[ 0 ] );
+
+			gat( gen, tree, node );
+			gstore( gen, vv_genFindVar( gen, gtkVal( tree, node ) ), val );
+			break;
+		}
+		// the value is generated before the name exists, it may still read the outer one
+		case ST_DEF_STMT:
+		case ST_DEF_PARTIAL_STMT:
+		{
+			size_t val = vv_generateExpr( gen, tree, node->children[ 0 ] );
+
+			gat( gen, tree, node );
+			gstore( gen, vv_genDeclare( gen, gtkVal( tree, node ) ), val );
+			break;
+		}
+		case ST_CALL_EXPR:
+			vv_generateExpr( gen, tree, stmt );
+			break;
+
+		case ST_WHEN_STMT:
+		{
+			size_t cond = vv_generateExpr( gen, tree, node->children[ 0 ] );
+			size_t skip = gemit( gen, OP_JMPF, 0, cond, 0 );
+
+			vv_generateBlock( gen, tree, node->children[ 1 ] );
+
+			if ( node->children[ 2 ] != VV_NODE_NONE )
+			{
+				size_t end = gemit( gen, OP_JMP, 0, 0, 0 );
+
+				gen->buf[ skip ].A = gen->cnt;
+				vv_generateBlock( gen, tree, node->children[ 2 ] );
+				skip = end;
+			}
+
+			gen->buf[ skip ].A = gen->cnt;
+			break;
+		}
+		case ST_WHILE_STMT:
+		{
+			size_t top = gen->cnt;
+			size_t cond = vv_generateExpr( gen, tree, node->children[ 0 ] );
+			size_t exit = gemit( gen, OP_JMPF, 0, cond, 0 );
+
+			vv_generateBlock( gen, tree, node->children[ 1 ] );
+			gemit( gen, OP_JMP, top, 0, 0 );
+
+			gen->buf[ exit ].A = gen->cnt;
+			break;
+		}
+		case ST_RET_STMT:
+		{
+			size_t val = SIZE_MAX;
+
+			if ( node->children[ 0 ] != VV_NODE_NONE )
+				val = vv_generateExpr( gen, tree, node->children[ 0 ] );
+
+			greturn( gen, val );
+			break;
+		}
+		case ST_BLOCK:
+			vv_generateBlock( gen, tree, stmt );
+			break;
+		default:
+			vv_error( VV_ERR_COMPILE, gen->fileName, gen->row, gen->col, "Not a statement" );
+	}
+
+	gen->depth--;
+}
+
+void vv_generateStatement( vvGenerator *gen, vvSyntaxContainer *stmt )
+{
+	vvSyntaxTree *tree = vv_newSyntaxTree( &stmt, 1 );
+
+	// siblings chained after stmt are flattened too but left alone
+	if ( tree->nodeCnt )
+		vv_generateFlatStatement( gen, tree, 0 );
+
+	vv_freeSyntaxTree( tree );
+}
+
+/*
+With gen->buildIR code goes through a vvIR first. A variable is a name for
+the values it takes there, only globals are kept in memory.
+*/
+
+// the vvIR of the function being generated, reset for it
+static vvIR *girTake( vvGenerator *gen )
+{
+	ggrow( ( void ** ) &gen->irs, &gen->irLen, gen->outerCnt + 1, sizeof( vvIR * ) );
+
+	while ( gen->irCnt <= gen->outerCnt )
+		gen->irs[ gen->irCnt++ ] = vv_newIR( );
+
+	vv_irReset( gen->irs[ gen->outerCnt ] );
+
+	return gen->irs[ gen->outerCnt ];
+}
+
+// a nested function may grow irs, the current one is fetched anew after generating anything
+#define gir( gen ) ( ( gen )->irs[ ( gen )->outerCnt ] )
+#define girKey( var ) ( ( ( var )->idx << 1 ) | ( ( var )->type == VAR_MEMORY ) )
+
+static size_t girEmit( vvGenerator *gen, vvOpcode op, size_t a, size_t b, size_t imm )
+{
+	gir( gen )->row = gen->row;
+	gir( gen )->col = gen->col;
+
+	return vv_irEmit( gir( gen ), op, a, b, imm );
+}
+
+static size_t girRead( vvGenerator *gen, vvGenVar *var )
+{
+	gir( gen )->row = gen->row;
+	gir( gen )->col = gen->col;
+
+	return vv_irRead( gir( gen ), girKey( var ) );
+}
+
+// globals are stored right away, a function called next reads them from memory
+static void girWrite( vvGenerator *gen, vvGenVar *var, size_t val )
+{
+	if ( var->type == VAR_MEMORY )
+		girEmit( gen, OP_STORE, val, 0, var->idx );
+
+	vv_irWrite( gir( gen ), girKey( var ), val );
+}
+
+static size_t girExpr( vvGenerator *gen, vvSyntaxTree *tree, vvNode expr );
+
+static size_t girPrimary( vvGenerator *gen, vvSyntaxTree *tree, vvSyntaxNode *node )
+{
+	uint32_t val = gtkVal( tree, node );
+
+	switch ( vv_treeTkTypes( tree )[ node->tk ] )
+	{
+		case TT_NUMBER:
+			return girEmit( gen, OP_LOADK, 0, 0, vv_symTableConst( gen->tbl, val )->idx );
+		case TT_TRUE:
+		case TT_FALSE:
+		case TT_NIL:
+			return girEmit( gen, OP_LOADK, 0, 0, vv_treeTkTypes( tree )[ node->tk ] - TT_TRUE );
+		case TT_STRING:
+			return girEmit( gen, OP_LOADS, 0, 0, val );
+		case TT_IDENTIFIER:
+			return girRead( gen, vv_genFindVar( gen, val ) );
+		default:
+			vv_error( VV_ERR_COMPILE, gen->fileName, gen->row, gen->col, "Not a value" );
+	}
+
+	return VV_IR_NONE;
+}
+
+static size_t girCall( vvGenerator *gen, vvSyntaxTree *tree, vvSyntaxNode *node )
+{
+	vvSyntaxNode *nodes = vv_treeNodes( tree );
+	size_t base = gen->workCnt;
+	size_t fn = girExpr( gen, tree, node->children[ 0 ] );
+
+	for ( vvNode arg = node->children[ 1 ]; arg != VV_NODE_NONE; arg = nodes[ arg ].next )
+		gworkPush( gen, girExpr( gen, tree, arg ) );
+
+	gat( gen, tree, node );
+	gir( gen )->row = gen->row;
+	gir( gen )->col = gen->col;
+
+	size_t rsl = vv_irCall( gir( gen ), fn, gen->work + base, gen->workCnt - base );
+
+	gen->workCnt = base;
+
+	return rsl;
+}
+
+static size_t girBinary( vvGenerator *gen, vvSyntaxTree *tree, vvNode expr )
+{
+	vvSyntaxNode *nodes = vv_treeNodes( tree );
+	size_t base = gen->workCnt;
+
+	while ( gisBinary( nodes[ expr ].st ) )
+	{
+		gworkPush( gen, expr );
+		expr = nodes[ expr ].children[ 0 ];
+	}
+
+	size_t rsl = girExpr( gen, tree, expr );
+
+	while ( gen->workCnt > base )
+	{
+		vvSyntaxNode *node = &nodes[ gen->work[ --gen->workCnt ] ];
+		size_t right = girExpr( gen, tree, node->children[ 1 ] );
+
+		gat( gen, tree, node );
+		rsl = girEmit( gen, gbinops[ node->st - ST_EQ_EXPR ], rsl, right, 0 );
+	}
+
+	return rsl;
+}
+
+static size_t girExpr( vvGenerator *gen, vvSyntaxTree *tree, vvNode expr )
+{
+	vvSyntaxNode *node = &vv_treeNodes( tree )[ expr ];
+	size_t rsl;
+
+	genter( gen );
+	gat( gen, tree, node );
+
+	switch ( ( vvSyntaxType ) node->st )
+	{
+		case ST_PRIMARY:
+			rsl = girPrimary( gen, tree, node );
+			break;
+		case ST_FUNC_EXPR:
+		{
+			size_t func = gen->reuse < gen->reuseEnd ? gen->work[ gen->reuse++ ] : gfunction( gen, tree, node );
+
+			gat( gen, tree, node );
+			rsl = girEmit( gen, OP_LOADF, 0, 0, func );
+			break;
+		}
+		case ST_CALL_EXPR:
+			rsl = girCall( gen, tree, node );
+			break;
+		case ST_NOT_EXPR:
+		case ST_INV_EXPR:
+		{
+			size_t val = girExpr( gen, tree, node->children[ 0 ] );
+
+			gat( gen, tree, node );
+			rsl = girEmit( gen, node->st == ST_NOT_EXPR ? OP_NOT : OP_INV, val, 0, 0 );
+			break;
+		}
+		default:
+			if ( !gisBinary( node->st ) )
+				vv_error( VV_ERR_COMPILE, gen->fileName, gen->row, gen->col, "Not an expression" );
+
+			rsl = girBinary( gen, tree, expr );
+	}
+
+	gen->depth--;
+
+	return rsl;
+}
+
+static void girStatement( vvGenerator *gen, vvSyntaxTree *tree, vvNode stmt );
+
+static void girBlock( vvGenerator *gen, vvSyntaxTree *tree, vvNode block )
+{
+	vvSyntaxNode *nodes = vv_treeNodes( tree );
+
+	vv_genEnterField( gen, 0 );
+
+	for ( vvNode stmt = nodes[ block ].children[ 0 ]; stmt != VV_NODE_NONE; stmt = nodes[ stmt ].next )
+		girStatement( gen, tree, stmt );
+
+	vv_genLeaveField( gen );
+}
+
+/*
+A while loop is entered through a test of its condition and tests it again
+at the end of its body, so the body is one block range and pre, which runs
+only when the body does, is where what the loop computes the same goes. The
+functions written in the condition are made once, both tests load them.
+*/
+static void girStatement( vvGenerator *gen, vvSyntaxTree *tree, vvNode stmt )
+{
+	vvSyntaxNode *node = &vv_treeNodes( tree )[ stmt ];
+
+	genter( gen );
+	gat( gen, tree, node );
+
+	switch ( ( vvSyntaxType ) node->st )
+	{
+		case ST_ASSIGN_EXPR:
+		{
+			size_t val = girExpr( gen, tree, node->children[ 0 ] );
+
+			gat( gen, tree, node );
+			girWrite( gen, vv_genFindVar( gen, gtkVal( tree, node ) ), val );
+			break;
+		}
+		case ST_DEF_STMT:
+		case ST_DEF_PARTIAL_STMT:
+		{
+			size_t val = girExpr( gen, tree, node->children[ 0 ] );
+
+			gat( gen, tree, node );
+			girWrite( gen, vv_genDeclare( gen, gtkVal( tree, node ) ), val );
+			break;
+		}
+		case ST_CALL_EXPR:
+			girExpr( gen, tree, stmt );
+			break;
+
+		case ST_WHEN_STMT:
+		{
+			size_t cond = girExpr( gen, tree, node->children[ 0 ] );
+			size_t then = vv_irBlock( gir( gen ) ), end = vv_irBlock( gir( gen ) ), other = end;
+
+			if ( node->children[ 2 ] != VV_NODE_NONE )
+				other = vv_irBlock( gir( gen ) );
+
+			vv_irBranch( gir( gen ), cond, then, other );
+			vv_irSeal( gir( gen ), then );
+			vv_irPlace( gir( gen ), then );
+			girBlock( gen, tree, node->children[ 1 ] );
+			vv_irGoto( gir( gen ), end );
+
+			if ( other != end )
+			{
+				vv_irSeal( gir( gen ), other );
+				vv_irPlace( gir( gen ), other );
+				girBlock( gen, tree, node->children[ 2 ] );
+				vv_irGoto( gir( gen ), end );
+			}
+
+			vv_irSeal( gir( gen ), end );
+			vv_irPlace( gir( gen ), end );
+			break;
+		}
+		case ST_WHILE_STMT:
+		{
+			size_t from = gir( gen )->instCnt, base = gen->workCnt;
+			size_t cond = girExpr( gen, tree, node->children[ 0 ] );
+			size_t pre = vv_irBlock( gir( gen ) ), head = vv_irBlock( gir( gen ) ), exit = vv_irBlock( gir( gen ) );
+
+			// the functions of the condition, its second lowering loads them again
+			for ( size_t v = from; v < gir( gen )->instCnt; v++ )
+				if ( gir( gen )->insts[ v ].op == OP_LOADF )
+					gworkPush( gen, gir( gen )->insts[ v ].imm );
+
+			size_t end = gen->workCnt;
+
+			vv_irBranch( gir( gen ), cond, pre, exit );
+			vv_irSeal( gir( gen ), pre );
+			vv_irPlace( gir( gen ), pre );
+			vv_irGoto( gir( gen ), head );
+			vv_irPlace( gir( gen ), head );
+
+			girBlock( gen, tree, node->children[ 1 ] );
+
+			if ( gir( gen )->blocks[ gir( gen )->cur ].live )
+			{
+				size_t reuse = gen->reuse, reuseEnd = gen->reuseEnd;
+
+				gen->reuse = base;
+				gen->reuseEnd = end;
+				cond = girExpr( gen, tree, node->children[ 0 ] );
+				gen->reuse = reuse;
+				gen->reuseEnd = reuseEnd;
+
+				vv_irBranch( gir( gen ), cond, head, exit );
+				vv_irLoop( gir( gen ), pre, head );
+			}
+
+			gen->workCnt = base;
+
+			vv_irSeal( gir( gen ), head );
+			vv_irSeal( gir( gen ), exit );
+			vv_irPlace( gir( gen ), exit );
+			break;
+		}
+		// what follows is generated into a block control never gets to
+		case ST_RET_STMT:
+		{
+			size_t val = VV_IR_NONE;
+
+			if ( node->children[ 0 ] != VV_NODE_NONE )
+				val = girExpr( gen, tree, node->children[ 0 ] );
+
+			gat( gen, tree, node );
+			gir( gen )->row = gen->row;
+			gir( gen )->col = gen->col;
+			vv_irReturn( gir( gen ), val );
+
+			size_t dead = vv_irBlock( gir( gen ) );
+
+			vv_irSeal( gir( gen ), dead );
+			vv_irPlace( gir( gen ), dead );
+			break;
+		}
+		case ST_BLOCK:
+			girBlock( gen, tree, stmt );
+			break;
+		default:
+			vv_error( VV_ERR_COMPILE, gen->fileName, gen->row, gen->col, "Not a statement" );
+	}
+
+	gen->depth--;
+}
+
+// register of a value, the ones coalesced share it
+static size_t girReg( vvGenerator *gen, vvIR *ir, size_t val )
+{
+	size_t cls = ir->cls[ val ];
+
+	if ( ir->regs[ cls ] == VV_IR_NONE )
+		ir->regs[ cls ] = gnewReg( gen );
+
+	return ir->regs[ cls ];
+}
+
+#define girIsConst( op ) ( ( op ) >= OP_LOADK && ( op ) <= OP_LOADF )
+
+// the phis of to and what they take from from, pairs on the work stack, the coalesced ones left out
+static size_t girEdge( vvGenerator *gen, vvIR *ir, size_t from, size_t to )
+{
+	vvIRBlock *blk = &ir->blocks[ to ];
+	size_t base = gen->workCnt;
+
+	for ( size_t p = blk->first; p != VV_IR_NONE && ir->insts[ p ].op == VV_IR_PHI; p = ir->insts[ p ].next )
+	{
+		size_t val = blk->preds[ 0 ] == from ? ir->insts[ p ].a : ir->insts[ p ].b;
+
+		if ( ir->cls[ val ] == p )
+			continue;
+
+		gworkPush( gen, p );
+		gworkPush( gen, val );
+	}
+
+	return ( gen->workCnt - base ) / 2;
+}
+
+/*
+The moves into the phis of to as one parallel copy: a move goes once no
+other one reads the register it writes, a cycle is broken with a register
+of its own. Constants are loaded last, they read nothing.
+*/
+static void girMoves( vvGenerator *gen, vvIR *ir, size_t from, size_t to )
+{
+	size_t base = gen->workCnt;
+	size_t n = girEdge( gen, ir, from, to ), cnt = 0;
+	size_t *moves;
+
+	gen->row = ir->blocks[ from ].info[ 0 ];
+	gen->col = ir->blocks[ from ].info[ 1 ];
+
+	// the registers, constants kept apart at the end
+	for ( size_t i = 0; i < n; i++ )
+	{
+		size_t dst = gen->work[ base + 2 * i ], src = gen->work[ base + 2 * i + 1 ];
+
+		if ( girIsConst( ir->insts[ src ].op ) )
+			continue;
+
+		gen->work[ base + 2 * cnt ] = girReg( gen, ir, dst );
+		gen->work[ base + 2 * cnt + 1 ] = girReg( gen, ir, src );
+
+		if ( gen->work[ base + 2 * cnt ] != gen->work[ base + 2 * cnt + 1 ] )
+			cnt++;
+	}
+
+	moves = gen->work + base;
+
+	while ( cnt )
+	{
+		size_t i = 0;
+
+		for ( ; i < cnt; i++ )
+		{
+			size_t j = 0;
+
+			while ( j < cnt && ( j == i || moves[ 2 * j + 1 ] != moves[ 2 * i ] ) )
+				j++;
+
+			if ( j == cnt )
+				break;
+		}
+
+		if ( i == cnt )
+		{
+			size_t temp = gnewReg( gen );
+
+			gemit( gen, OP_MOV, temp, moves[ 0 ], 0 );
+
+			for ( size_t j = 1; j < cnt; j++ )
+				if ( moves[ 2 * j + 1 ] == moves[ 0 ] )
+					moves[ 2 * j + 1 ] = temp;
+			continue;
+		}
+
+		gemit( gen, OP_MOV, moves[ 2 * i ], moves[ 2 * i + 1 ], 0 );
+
+		moves[ 2 * i ] = moves[ 2 * --cnt ];
+		moves[ 2 * i + 1 ] = moves[ 2 * cnt + 1 ];
+	}
+
+	gen->workCnt = base;
+	n = girEdge( gen, ir, from, to );
+
+	for ( size_t i = 0; i < n; i++ )
+	{
+		vvIRInst *src = &ir->insts[ gen->work[ base + 2 * i + 1 ] ];
+
+		if ( girIsConst( src->op ) )
+			gemit( gen, src->op, girReg( gen, ir, gen->work[ base + 2 * i ] ), src->imm, 0 );
+	}
+
+	gen->workCnt = base;
+}
+
+/*
+Whether the moves of a back edge can go before the branch taking it, so
+the loop needs no jump of its own: the other edge must not read what they
+write, nor the branch.
+*/
+static int girEarly( vvGenerator *gen, vvIR *ir, size_t from )
+{
+	vvIRBlock *blk = &ir->blocks[ from ];
+	size_t base = gen->workCnt;
+	size_t n = girEdge( gen, ir, from, blk->succs[ 0 ] );
+	size_t m = girEdge( gen, ir, from, blk->succs[ 1 ] );
+	int rsl = 1;
+
+	for ( size_t i = 0; i < n && rsl; i++ )
+	{
+		size_t dst = ir->cls[ gen->work[ base + 2 * i ] ];
+
+		rsl = dst != ir->cls[ blk->val ];
+
+		for ( size_t j = 0; j < m && rsl; j++ )
+			rsl = dst != ir->cls[ gen->work[ base + 2 * ( n + j ) + 1 ] ];
+	}
+
+	gen->workCnt = base;
+
+	return rsl;
+}
+
+// labels of the code at ir->labels, the ones jumped to before their code is placed
+#define VV_GIR_PENDING ( SIZE_MAX - 1 )
+#define girLabel( block ) ( 3 * ( block ) )
+#define girStub( block, k ) ( 3 * ( block ) + 1 + ( k ) )
+
+// to the code of an edge, which is placed before to when there are moves on it
+static size_t girTarget( vvGenerator *gen, vvIR *ir, size_t from, size_t k )
+{
+	size_t base = gen->workCnt;
+	size_t n = girEdge( gen, ir, from, ir->blocks[ from ].succs[ k ] );
+
+	gen->workCnt = base;
+
+	if ( n == 0 )
+		return girLabel( ir->blocks[ from ].succs[ k ] );
+
+	ir->labels[ girStub( from, k ) ] = VV_GIR_PENDING;
+
+	return girStub( from, k );
+}
+
+static void girInst( vvGenerator *gen, vvIR *ir, size_t v )
+{
+	vvIRInst *inst = &ir->insts[ v ];
+
+	gen->row = inst->info[ 0 ];
+	gen->col = inst->info[ 1 ];
+
+	switch ( inst->op )
+	{
+		case OP_LOAD:
+		case OP_LOADK:
+		case OP_LOADS:
+		case OP_LOADF:
+			gemit( gen, inst->op, girReg( gen, ir, v ), inst->imm, 0 );
+			break;
+		case OP_POP:
+			gemit( gen, OP_POP, girReg( gen, ir, v ), 0, 0 );
+			break;
+		case OP_STORE:
+			gemit( gen, OP_STORE, inst->imm, girReg( gen, ir, inst->a ), 0 );
+			break;
+		case OP_CALL:
+		{
+			vvGenCall call = { gen->cnt, 0, 0 };
+
+			for ( size_t i = 0; i < inst->imm; i++ )
+				gemit( gen, OP_PUSH, girReg( gen, ir, ir->args[ inst->b + i ] ), 0, 0 );
+
+			gemit( gen, OP_CALL, girReg( gen, ir, inst->a ), inst->imm, 0 );
+			call.to = gemit( gen, OP_POP, girReg( gen, ir, v ), 0, 0 );
+
+			ggrow( ( void ** ) &gen->calls, &gen->callLen, gen->callCnt + 1, sizeof( vvGenCall ) );
+			gen->calls[ gen->callCnt++ ] = call;
+			break;
+		}
+		case OP_NOT:
+		case OP_INV:
+			gemit( gen, inst->op, girReg( gen, ir, v ), girReg( gen, ir, inst->a ), 0 );
+			break;
+		default:
+			gemit( gen, inst->op, girReg( gen, ir, v ), girReg( gen, ir, inst->a ), girReg( gen, ir, inst->b ) );
+	}
+}
+
+/*
+The blocks in layout order with their moves on the edges. A jump holds the
+label it goes to until every block is placed.
+*/
+static void girLower( vvGenerator *gen, vvIR *ir )
+{
+	size_t start = gen->cnt;
+	int falls = 0;
+
+	vv_irCoalesce( ir );
+
+	for ( size_t i = 0; i < 3 * ir->blockCnt; i++ )
+		ir->labels[ i ] = VV_IR_NONE;
+
+	for ( size_t i = 0; i < ir->layoutCnt; i++ )
+	{
+		size_t block = ir->layout[ i ], next = VV_IR_NONE;
+		vvIRBlock *blk = &ir->blocks[ block ];
+
+		if ( !blk->live )
+			continue;
+
+		for ( size_t j = i + 1; j < ir->layoutCnt && next == VV_IR_NONE; j++ )
+			if ( ir->blocks[ ir->layout[ j ] ].live )
+				next = ir->layout[ j ];
+
+		// the edges with moves jumped to, the last one falls into the block
+		for ( size_t k = 0, stubs = 0; k < blk->predCnt; k++ )
+		{
+			vvIRBlock *pred = &ir->blocks[ blk->preds[ k ] ];
+			size_t stub = girStub( blk->preds[ k ], pred->succs[ 0 ] == block ? 0 : 1 );
+
+			if ( pred->succCnt < 2 || ir->labels[ stub ] != VV_GIR_PENDING )
+				continue;
+
+			if ( stubs++ || falls )
+				gemit( gen, OP_JMP, girLabel( block ), 0, 0 );
+
+			ir->labels[ stub ] = gen->cnt;
+			girMoves( gen, ir, blk->preds[ k ], block );
+			falls = 1;
+		}
+
+		ir->labels[ girLabel( block ) ] = gen->cnt;
+
+		for ( size_t v = blk->first; v != VV_IR_NONE; v = ir->insts[ v ].next )
+			if ( ir->insts[ v ].op != VV_IR_PHI )
+				girInst( gen, ir, v );
+
+		gen->row = blk->info[ 0 ];
+		gen->col = blk->info[ 1 ];
+		falls = 0;
+
+		switch ( ( vvIRExit ) blk->exit )
+		{
+			case EXIT_FALL:
+				falls = 1;
+				break;
+			case EXIT_GOTO:
+				girMoves( gen, ir, block, blk->succs[ 0 ] );
+
+				if ( blk->succs[ 0 ] == next )
+					falls = 1;
+				else
+					gemit( gen, OP_JMP, girLabel( blk->succs[ 0 ] ), 0, 0 );
+				break;
+			case EXIT_BRANCH:
+			{
+				size_t t = blk->succs[ 0 ], f = blk->succs[ 1 ];
+				size_t cond = girReg( gen, ir, blk->val );
+
+				// a loop latch, the head is laid out before it or is the block itself
+				if ( ir->blocks[ t ].pos <= i )
+				{
+					size_t base = gen->workCnt;
+					int moves = girEdge( gen, ir, block, t ) > 0;
+
+					gen->workCnt = base;
+
+					if ( moves && girEarly( gen, ir, block ) )
+					{
+						girMoves( gen, ir, block, t );
+						moves = 0;
+					}
+
+					gen->row = blk->info[ 0 ];
+					gen->col = blk->info[ 1 ];
+
+					if ( moves )
+					{
+						gemit( gen, OP_JMPF, girTarget( gen, ir, block, 1 ), cond, 0 );
+						girMoves( gen, ir, block, t );
+						gemit( gen, OP_JMP, girLabel( t ), 0, 0 );
+						break;
+					}
+
+					gemit( gen, OP_JMPT, girLabel( t ), cond, 0 );
+					girMoves( gen, ir, block, f );
+
+					if ( f != next )
+					{
+						gemit( gen, OP_JMP, girLabel( f ), 0, 0 );
+						break;
+					}
+				}
+				else if ( f == next )
+				{
+					gemit( gen, OP_JMPT, girTarget( gen, ir, block, 0 ), cond, 0 );
+					girMoves( gen, ir, block, f );
+				}
+				else
+				{
+					gemit( gen, OP_JMPF, girTarget( gen, ir, block, 1 ), cond, 0 );
+					girMoves( gen, ir, block, t );
+
+					if ( t != next )
+					{
+						gemit( gen, OP_JMP, girLabel( t ), 0, 0 );
+						break;
+					}
+				}
+
+				falls = 1;
+				break;
+			}
+			case EXIT_RETURN:
+				greturn( gen, blk->val == VV_IR_NONE ? SIZE_MAX : girReg( gen, ir, blk->val ) );
+				break;
+		}
+	}
+
+	for ( size_t i = start; i < gen->cnt; i++ )
+		if ( vv_isJump( gen->buf[ i ].op ) )
+			gen->buf[ i ].A = ir->labels[ gen->buf[ i ].A ];
+}
+
+// optimizes the unit built and generates it after what buf holds
+static void girFinish( vvGenerator *gen )
+{
+	vvIR *ir = gir( gen );
+
+	vv_irOptimize( ir );
+	gen->optHoisted += ir->hoisted;
+	gen->optMerged += ir->merged;
+
+	girLower( gen, ir );
+}
+
+// stmt and, with chain, the statements after it as one unit of module code
+static void girUnit( vvGenerator *gen, vvSyntaxTree *tree, vvNode stmt, int chain )
+{
+	girTake( gen );
+
+	for ( ; stmt != VV_NODE_NONE; stmt = chain ? vv_treeNodes( tree )[ stmt ].next : VV_NODE_NONE )
+		girStatement( gen, tree, stmt );
+
+	girFinish( gen );
+}
+
+// the parameters and the body, in the field gfunction entered
+static void girFunction( vvGenerator *gen, vvSyntaxTree *tree, vvSyntaxNode *node )
+{
+	vvSyntaxNode *nodes = vv_treeNodes( tree );
+
+	girTake( gen );
+
+	for ( vvNode arg = node->children[ 0 ]; arg != VV_NODE_NONE; arg = nodes[ arg ].next )
+	{
+		gat( gen, tree, &nodes[ arg ] );
+		girWrite( gen, vv_genDeclare( gen, gtkVal( tree, &nodes[ arg ] ) ), girEmit( gen, OP_POP, 0, 0, 0 ) );
+	}
+
+	if ( node->children[ 1 ] != VV_NODE_NONE )
+	{
+		vvSyntaxNode *body = &nodes[ node->children[ 1 ] ];
+
+		for ( vvNode stmt = body->children[ 0 ]; stmt != VV_NODE_NONE; stmt = nodes[ stmt ].next )
+			girStatement( gen, tree, stmt );
+	}
+
+	vv_irReturn( gir( gen ), VV_IR_NONE );
+	girFinish( gen );
+}
+
+/*
+Live ranges from the first to the last mention. A range live where a jump
+goes back to is live until that jump, so loops keep what they read from
+before them. marks holds the back edges sorted by target.
+*/
+static void granges( vvGenerator *gen )
+{
+	vvGenInterval *ivs = gen->ivs;
+	size_t edgeCnt = 0;
+
+	for ( size_t i = 0; i < gen->regCnt; i++ )
+		ivs[ i ] = ( vvGenInterval ){ SIZE_MAX, 0, 0, 0 };
+
+	for ( size_t i = 0; i < gen->cnt; i++ )
+	{
+		vvOpData *inst = &gen->buf[ i ];
+		size_t ops[ 3 ] = { inst->A, inst->B, inst->C };
+
+		for ( int k = 0; k < 3; k++ )
+		{
+			unsigned char role = vv_opOperands[ inst->op ][ k ];
+
+			if ( role != OPD_DEF && role != OPD_USE )
+				continue;
+
+			vvGenInterval *iv = &ivs[ ops[ k ] ];
+
+			if ( iv->start == SIZE_MAX )
+				iv->start = i;
+			iv->end = i;
+		}
+
+		if ( vv_isJump( inst->op ) && inst->A <= i )
+		{
+			ggrow( ( void ** ) &gen->marks, &gen->marksLen, 2 * edgeCnt + 2, sizeof( size_t ) );
+
+			// nested loops come back to earlier targets later, few are out of order
+			size_t at = edgeCnt++;
+
+			for ( ; at && gen->marks[ 2 * at - 2 ] > inst->A; at-- )
+			{
+				gen->marks[ 2 * at ] = gen->marks[ 2 * at - 2 ];
+				gen->marks[ 2 * at + 1 ] = gen->marks[ 2 * at - 1 ];
+			}
+
+			gen->marks[ 2 * at ] = inst->A;
+			gen->marks[ 2 * at + 1 ] = i;
+		}
+	}
+
+	for ( size_t v = 0; v < gen->regCnt && edgeCnt; v++ )
+	{
+		vvGenInterval *iv = &ivs[ v ];
+		int changed = 1;
+
+		if ( iv->start == SIZE_MAX )
+			continue;
+
+		while ( changed )
+		{
+			size_t lo = 0, hi = edgeCnt;
+
+			changed = 0;
+
+			// first edge going to after the start
+			while ( lo < hi )
+			{
+				size_t mid = ( lo + hi ) / 2;
+
+				if ( gen->marks[ 2 * mid ] <= iv->start )
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+
+			for ( ; lo < edgeCnt && gen->marks[ 2 * lo ] <= iv->end; lo++ )
+			{
+				if ( gen->marks[ 2 * lo + 1 ] > iv->end )
+				{
+					iv->end = gen->marks[ 2 * lo + 1 ];
+					changed = 1;
+				}
+			}
+		}
+	}
+}
+
+// ranges in order of their start, counted into place
+static void gsort( vvGenerator *gen )
+{
+	ggrow( ( void ** ) &gen->marks, &gen->marksLen, gen->cnt + 1, sizeof( size_t ) );
+
+	size_t *cnts = gen->marks;
+	memset( cnts, 0, ( gen->cnt + 1 ) * sizeof( size_t ) );
+
+	for ( size_t v = 0; v < gen->regCnt; v++ )
+		if ( gen->ivs[ v ].start != SIZE_MAX )
+			cnts[ gen->ivs[ v ].start + 1 ]++;
+
+	for ( size_t i = 0; i < gen->cnt; i++ )
+		cnts[ i + 1 ] += cnts[ i ];
+
+	for ( size_t v = 0; v < gen->regCnt; v++ )
+		if ( gen->ivs[ v ].start != SIZE_MAX )
+			gen->order[ cnts[ gen->ivs[ v ].start ]++ ] = v;
+}
+
+// returns the number of ranges sorted into order
+static size_t gscan( vvGenerator *gen, size_t slotBase, size_t *slotCnt )
+{
+	vvGenInterval *ivs = gen->ivs;
+	size_t active[ VV_ALLOC_REGISTERS ], actCnt = 0;
+	unsigned taken = 0;
+	size_t n = 0;
+
+	// spilled ranges still live, and the slots they gave back
+	size_t *spills = gen->marks, spillCnt = 0;
+	size_t *spare = gen->marks + gen->regCnt, spareCnt = 0;
+
+	for ( size_t v = 0; v < gen->regCnt; v++ )
+		n += ivs[ v ].start != SIZE_MAX;
+
+	*slotCnt = 0;
+
+	for ( size_t k = 0; k < n; k++ )
+	{
+		size_t v = gen->order[ k ];
+		vvGenInterval *iv = &ivs[ v ];
+
+		// a range ending where another starts hands its register over, operands are read first
+		while ( actCnt && ivs[ active[ 0 ] ].end <= iv->start )
+		{
+			taken &= ~( 1u << ivs[ active[ 0 ] ].loc );
+			memmove( active, active + 1, --actCnt * sizeof( size_t ) );
+		}
+
+		for ( size_t i = 0; i < spillCnt; )
+		{
+			if ( ivs[ spills[ i ] ].end <= iv->start )
+			{
+				spare[ spareCnt++ ] = ivs[ spills[ i ] ].loc;
+				spills[ i ] = spills[ --spillCnt ];
+			}
+			else
+				i++;
+		}
+
+		vvGenInterval *spilled = iv;
+
+		if ( actCnt < VV_ALLOC_REGISTERS )
+		{
+			iv->loc = 0;
+
+			while ( taken & ( 1u << iv->loc ) )
+				iv->loc++;
+
+			taken |= 1u << iv->loc;
+			spilled = NULL;
+		}
+		else if ( ivs[ active[ actCnt - 1 ] ].end > iv->end )
+		{
+			// the range ending last gives its register up
+			spilled = &ivs[ active[ --actCnt ] ];
+			spills[ spillCnt++ ] = active[ actCnt ];
+			iv->loc = spilled->loc;
+		}
+		else
+			spills[ spillCnt++ ] = v;
+
+		// a range spilled after its start is in memory over all of it, a slot given back since may still be taken then
+		if ( spilled )
+		{
+			spilled->spilled = 1;
+			spilled->loc = spareCnt && spilled == iv ? spare[ --spareCnt ] : slotBase + ( *slotCnt )++;
+		}
+
+		if ( spilled != iv )
+		{
+			size_t at = actCnt++;
+
+			for ( ; at && ivs[ active[ at - 1 ] ].end > iv->end; at-- )
+				active[ at ] = active[ at - 1 ];
+
+			active[ at ] = v;
+		}
+	}
+
+	return n;
+}
+
+// the registers live across each call but the one its result goes to, ranges of a register never overlap
+static void gsaves( vvGenerator *gen, size_t n )
+{
+	vvGenInterval *ivs = gen->ivs;
+	size_t *byReg = gen->marks;
+	size_t cnts[ VV_ALLOC_REGISTERS + 1 ] = { 0 }, at[ VV_ALLOC_REGISTERS ];
+
+	for ( size_t k = 0; k < n; k++ )
+		if ( !ivs[ gen->order[ k ] ].spilled )
+			cnts[ ivs[ gen->order[ k ] ].loc + 1 ]++;
+
+	for ( int r = 0; r < VV_ALLOC_REGISTERS; r++ )
+	{
+		cnts[ r + 1 ] += cnts[ r ];
+		at[ r ] = cnts[ r ];
+	}
+
+	for ( size_t k = 0; k < n; k++ )
+		if ( !ivs[ gen->order[ k ] ].spilled )
+			byReg[ at[ ivs[ gen->order[ k ] ].loc ]++ ] = gen->order[ k ];
+
+	for ( int r = 0; r < VV_ALLOC_REGISTERS; r++ )
+		at[ r ] = cnts[ r ];
+
+	for ( size_t c = 0; c < gen->callCnt; c++ )
+	{
+		vvGenCall *call = &gen->calls[ c ];
+
+		call->saved = 0;
+
+		for ( int r = 0; r < VV_ALLOC_REGISTERS; r++ )
+		{
+			while ( at[ r ] < cnts[ r + 1 ] && ivs[ byReg[ at[ r ] ] ].end <= call->to )
+				at[ r ]++;
+
+			if ( at[ r ] < cnts[ r + 1 ] && ivs[ byReg[ at[ r ] ] ].start < call->from &&
+				 byReg[ at[ r ] ] != gen->buf[ call->to ].A )
+				call->saved |= 1u << r;
+		}
+	}
+}
+
+static void gout( vvGenerator *gen, size_t *cnt, vvOpData inst )
+{
+	ggrow( ( void ** ) &gen->out, &gen->outLen, *cnt + 1, sizeof( vvOpData ) );
+	gen->out[ ( *cnt )++ ] = inst;
+}
+
+#define gscratch( k ) ( VV_ALLOC_REGISTERS + ( k ) )
+
+// the code in buf with registers in place of the virtual ones, owned by the caller
+static vvOpData *gallocate( vvGenerator *gen, size_t *len )
+{
+	if ( gen->regCnt > gen->ivLen )
+	{
+		ggrow( ( void ** ) &gen->ivs, &gen->ivLen, gen->regCnt, sizeof( vvGenInterval ) );
+
+		gen->order = ( size_t * ) realloc( gen->order, gen->ivLen * sizeof( size_t ) );
+		assert( gen->order );
+	}
+
+	granges( gen );
+	gsort( gen );
+
+	ggrow( ( void ** ) &gen->marks, &gen->marksLen, 2 * gen->regCnt, sizeof( size_t ) );
+
+	// a function spills to its frame after its locals, the module to memory
+	int frame = gen->outerCnt > 0;
+	vvOpcode load = frame ? OP_LOADL : OP_LOAD, store = frame ? OP_STOREL : OP_STORE;
+	size_t slots, n = gscan( gen, frame ? gen->locMax : gen->memCnt, &slots );
+
+	if ( frame )
+		gen->buf[ 0 ].A = gen->locMax + slots;
+	else
+		gen->memCnt += slots;
+
+	gsaves( gen, n );
+
+	// marks maps the old addresses to the new ones from here on
+	ggrow( ( void ** ) &gen->marks, &gen->marksLen, gen->cnt + 1, sizeof( size_t ) );
+
+	vvGenInterval *ivs = gen->ivs;
+	size_t *map = gen->marks;
+	size_t cnt = 0, call = 0;
+
+	for ( size_t i = 0; i < gen->cnt; i++ )
+	{
+		vvOpData inst = gen->buf[ i ];
+		size_t *ops[ 3 ] = { &inst.A, &inst.B, &inst.C };
+		vvGenInterval *def = NULL;
+		int scratch = 0;
+
+		map[ i ] = cnt;
+
+		if ( call < gen->callCnt && gen->calls[ call ].from == i )
+		{
+			vvGenCall *c = &gen->calls[ call ];
+
+			for ( int r = 0; r < VV_ALLOC_REGISTERS; r++ )
+				if ( c->saved & ( 1u << r ) )
+					gout( gen, &cnt, ( vvOpData ){ OP_PUSH, { inst.info[ 0 ], inst.info[ 1 ] }, r, 0, 0 } );
+		}
+
+		for ( int k = 0; k < 3; k++ )
+		{
+			unsigned char role = vv_opOperands[ inst.op ][ k ];
+
+			if ( role != OPD_DEF && role != OPD_USE )
+				continue;
+
+			vvGenInterval *iv = &ivs[ *ops[ k ] ];
+
+			if ( !iv->spilled )
+				*ops[ k ] = iv->loc;
+			else if ( role == OPD_DEF )
+			{
+				def = iv;
+				*ops[ k ] = gscratch( 0 );
+			}
+			else
+			{
+				gout( gen, &cnt, ( vvOpData ){ load, { inst.info[ 0 ], inst.info[ 1 ] }, gscratch( scratch ), iv->loc, 0 } );
+				*ops[ k ] = gscratch( scratch++ );
+			}
+		}
+
+		gout( gen, &cnt, inst );
+
+		if ( def )
+			gout( gen, &cnt, ( vvOpData ){ store, { inst.info[ 0 ], inst.info[ 1 ] }, def->loc, gscratch( 0 ), 0 } );
+
+		if ( call < gen->callCnt && gen->calls[ call ].to == i )
+		{
+			vvGenCall *c = &gen->calls[ call ];
+
+			for ( int r = VV_ALLOC_REGISTERS - 1; r >= 0; r-- )
+				if ( c->saved & ( 1u << r ) )
+					gout( gen, &cnt, ( vvOpData ){ OP_POP, { inst.info[ 0 ], inst.info[ 1 ] }, r, 0, 0 } );
+
+			call++;
+		}
+	}
+
+	map[ gen->cnt ] = cnt;
+
+	for ( size_t i = 0; i < cnt; i++ )
+		if ( vv_isJump( gen->out[ i ].op ) )
+			gen->out[ i ].A = map[ gen->out[ i ].A ];
+
+	if ( gen->optimize )
+	{
+		ggrow( ( void ** ) &gen->marks, &gen->marksLen, 3 * cnt + 1, sizeof( size_t ) );
+
+		size_t optimized = vv_optimizeCode( gen->out, cnt, gen->marks );
+
+		gen->optRemoved += cnt - optimized;
+		cnt = optimized;
+	}
+
+	vvOpData *rsl = ( vvOpData * ) malloc( ( cnt ? cnt : 1 ) * sizeof( vvOpData ) );
+	assert( rsl );
+
+	memcpy( rsl, gen->out, cnt * sizeof( vvOpData ) );
+	*len = cnt;
+
+	return rsl;
+}
+
+// a nested function is generated into a buffer of its own
+static void gfuncEnter( vvGenerator *gen )
+{
+	ggrow( ( void ** ) &gen->outer, &gen->outerLen, gen->outerCnt + 1, sizeof( vvGenFunc ) );
+
+	gen->outer[ gen->outerCnt++ ] = ( vvGenFunc ){
+		gen->buf,
+		gen->cnt,
+		gen->len,
+		gen->regCnt,
+		gen->calls,
+		gen->callCnt,
+		gen->callLen,
+		gen->locCnt,
+		gen->locMax,
+	};
+
+	gen->buf = NULL;
+	gen->calls = NULL;
+	gen->cnt = gen->len = gen->regCnt = 0;
+	gen->callCnt = gen->callLen = 0;
+	gen->locCnt = gen->locMax = 0;
+}
+
+static void gfuncLeave( vvGenerator *gen )
+{
+	vvGenFunc f = gen->outer[ --gen->outerCnt ];
+
+	free( gen->buf );
+	free( gen->calls );
+
+	gen->buf = f.buf;
+	gen->cnt = f.cnt;
+	gen->len = f.len;
+	gen->regCnt = f.regCnt;
+	gen->calls = f.calls;
+	gen->callCnt = f.callCnt;
+	gen->callLen = f.callLen;
+	gen->locCnt = f.locCnt;
+	gen->locMax = f.locMax;
+}
+
+// the arguments come first on the stack of the callee
+static size_t gfunction( vvGenerator *gen, vvSyntaxTree *tree, vvSyntaxNode *node )
+{
+	vvSyntaxNode *nodes = vv_treeNodes( tree );
+
+	gfuncEnter( gen );
+	// sized once the spills are known
+	gemit( gen, OP_FRAME, 0, 0, 0 );
+	// the parameters and the body share a scope
+	vv_genEnterField( gen, 1 );
+
+	if ( gen->buildIR )
+		girFunction( gen, tree, node );
+	else
+	{
+		for ( vvNode arg = node->children[ 0 ]; arg != VV_NODE_NONE; arg = nodes[ arg ].next )
+		{
+			size_t val = gnewReg( gen );
+
+			gat( gen, tree, &nodes[ arg ] );
+			gemit( gen, OP_POP, val, 0, 0 );
+			gstore( gen, vv_genDeclare( gen, gtkVal( tree, &nodes[ arg ] ) ), val );
+		}
+
+		if ( node->children[ 1 ] != VV_NODE_NONE )
+		{
+			vvSyntaxNode *body = &nodes[ node->children[ 1 ] ];
+
+			for ( vvNode stmt = body->children[ 0 ]; stmt != VV_NODE_NONE; stmt = nodes[ stmt ].next )
+				vv_generateFlatStatement( gen, tree, stmt );
+		}
+
+		greturn( gen, SIZE_MAX );
+	}
+
+	vv_genLeaveField( gen );
+
+	ggrow( ( void ** ) &gen->funcs, &gen->funcLen, gen->funcCnt + 1, sizeof( vvOpData * ) );
+	gen->funcLens = ( size_t * ) realloc( gen->funcLens, gen->funcLen * sizeof( size_t ) );
+	assert( gen->funcLens );
+
+	size_t rsl = gen->funcCnt++;
+	gen->funcs[ rsl ] = gallocate( gen, &gen->funcLens[ rsl ] );
+
+	gfuncLeave( gen );
+
+	return rsl;
+}
+
+// back to the module after an error in a nested function
+static void gfuncsDrop( vvGenerator *gen )
+{
+	while ( gen->outerCnt )
+		gfuncLeave( gen );
+
+	gen->depth = 0;
+	gen->workCnt = 0;
+}
+
+static void gfuncsFree( vvGenerator *gen, size_t from )
+{
+	while ( gen->funcCnt > from )
+		free( gen->funcs[ --gen->funcCnt ] );
+}
+
+size_t vv_generatorLoad( vvGenerator *gen, vvVM *vm )
+{
+	size_t *ids = ( size_t * ) malloc( ( gen->funcCnt + 1 ) * sizeof( size_t ) );
+	assert( ids );
+
+	gemit( gen, OP_HALT, 0, 0, 0 );
+
+	size_t len;
+	vvOpData *module = gallocate( gen, &len );
+
+	// more statements may follow
+	gen->cnt--;
+
+	for ( size_t i = 0; i < gen->funcCnt; i++ )
+	{
+		vvOpData *func = ( vvOpData * ) malloc( gen->funcLens[ i ] * sizeof( vvOpData ) );
+		assert( func );
+
+		memcpy( func, gen->funcs[ i ], gen->funcLens[ i ] * sizeof( vvOpData ) );
+		ids[ i ] = vv_addFunction( vm, func );
+	}
+
+	ids[ gen->funcCnt ] = vv_addFunction( vm, module );
+
+	for ( size_t i = 0; i <= gen->funcCnt; i++ )
+	{
+		vvOpData *func = vm->insts[ ids[ i ] ];
+		size_t funcLen = i < gen->funcCnt ? gen->funcLens[ i ] : len;
+
+		for ( size_t j = 0; j < funcLen; j++ )
+			if ( func[ j ].op == OP_LOADF )
+				func[ j ].B = ids[ func[ j ].B ];
+	}
+
+	size_t rsl = ids[ gen->funcCnt ];
+	free( ids );
+
+	vv_reserveMemory( vm, gen->memCnt );
+	vm->idx = ( vvCallInfo ){ 0, rsl };
+
+	return rsl;
+}
+
+typedef struct vvGenTree
+{
+	vvGenerator *gen;
+	vvSyntaxTree *tree;
+
+	// what the module had before the tree
+	size_t cnt, regCnt, callCnt, funcCnt;
+	size_t memCnt, globalCnt;
+} vvGenTree;
+
+static void gtree( void *ud )
+{
+	vvGenTree *job = ( vvGenTree * ) ud;
+	vvSyntaxTree *tree = job->tree;
+
+	if ( tree->nodeCnt == 0 )
+		return;
+
+	if ( job->gen->buildIR )
+	{
+		girUnit( job->gen, tree, 0, 1 );
+		return;
+	}
+
+	for ( vvNode stmt = 0; stmt != VV_NODE_NONE; stmt = vv_treeNodes( tree )[ stmt ].next )
+		vv_generateFlatStatement( job->gen, tree, stmt );
+}
+
+// forgets the globals declared from the from'th on
+static void gglobalsDrop( vvSymTable *tbl, size_t from )
+{
+	vvSymSection *section = &tbl->sections[ VAR_MEMORY ];
+
+	memset( section->sto + from, 0, ( section->idx - from ) * sizeof( vvGenVar ) );
+	section->idx = from;
+
+	gmapClear( &tbl->names );
+
+	for ( size_t i = 0; i < from; i++ )
+		gmapPut( &tbl->names, section->sto[ i ].identifier, i );
+}
+
+// the top-level statements of a module, in order
+vvResult vv_generateTree( vvGenerator *gen, vvSyntaxTree *tree, vvError *err )
+{
+	vvGenTree job = {
+		gen, tree, gen->cnt, gen->regCnt, gen->callCnt, gen->funcCnt,
+		gen->memCnt, gen->tbl->sections[ VAR_MEMORY ].idx,
+	};
+	vvResult rsl = vv_try( err, gtree, &job );
+
+	if ( rsl == VV_OK )
+		return rsl;
+
+	// the fields entered before the error are never left
+	gfieldsDrop( gen );
+	gfuncsDrop( gen );
+	gfuncsFree( gen, job.funcCnt );
+
+	gen->cnt = job.cnt;
+	gen->regCnt = job.regCnt;
+	gen->callCnt = job.callCnt;
+	gen->memCnt = job.memCnt;
+	gen->reuse = gen->reuseEnd = 0;
+
+	gglobalsDrop( gen->tbl, job.globalCnt );
+
+	return rsl;
+}
+
+void vv_freeGenerator( vvGenerator *gen )
+{
+	gfieldsDrop( gen );
+
+	while ( gen->spareFields )
+	{
+		vvGenField *next = gen->spareFields->next;
+		vv_freeGenField( gen->spareFields );
+		gen->spareFields = next;
+	}
+
+	gfuncsDrop( gen );
+	gfuncsFree( gen, 0 );
+
+	free( gen->buf );
+	free( gen->calls );
+	free( gen->outer );
+	free( gen->funcs );
+	free( gen->funcLens );
+	free( gen->work );
+	free( gen->ivs );
+	free( gen->order );
+	free( gen->marks );
+	free( gen->out );
+
+	for ( size_t i = 0; i < gen->irCnt; i++ )
+		vv_freeIR( gen->irs[ i ] );
+	free( gen->irs );
+
 	vv_freeSymTable( gen->tbl );
 
 	vv_freeFieldStack( gen->fields );
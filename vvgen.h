@@ -28,8 +28,11 @@ SOFTWARE.
 #define VV_CODEGEN
 
 #include <stdio.h>
+#include "vvir.h"
 #include "vvlex.h"
 #include "vvop.h"
+#include "vvparser.h"
+#include "vvvm.h"
 
 #define VV_STORAGE_DEFAULT 16
 #define VV_LOCAL_SECTION_DEFAULT 2
@@ -53,27 +56,52 @@ typedef struct vvGenVar
 	size_t idx;
 } vvGenVar;
 
-#define VV_SYM_TABLE_STEP 2
-
 typedef struct vvSymSection
 {
 	size_t idx, len;
 	vvGenVar *sto;
 } vvSymSection;
 
+#define VV_SYM_MAP_DEFAULT_LEN 16
+
+/*
+Names to positions in a section, open addressing on the interned vvString.
+A key is only present while its stamp is the one of the map, so emptying the
+map is a new stamp and not a pass over the slots.
+*/
+typedef struct vvSymMap
+{
+	vvString *keys;
+	size_t *vals;
+	unsigned *stamps;
+	unsigned stamp;
+	size_t cnt, len;
+} vvSymMap;
+
 typedef struct vvSymTable
 {
 	vvSymSection *sections;
+
+	// the named variables of VAR_MEMORY
+	vvSymMap names;
 } vvSymTable;
 
 #define VV_GLOBAL_FIELD NULL
 
+// a scope, fields stack up in gen->fields and a name is looked up from the top one down
 typedef struct vvGenField
 {
 	vvSymSection *locals;
-} vvGenField;
+	vvSymMap names;
 
-#define VV_FIELD_STACK_MAX 16
+	// a function body, the fields below it belong to the enclosing function and are not searched
+	int boundary;
+	// frame slots in use when it was entered, the ones of its locals are free again once it is left
+	size_t base;
+
+	// links the fields a generator keeps for reuse
+	struct vvGenField *next;
+} vvGenField;
 
 typedef struct vvFieldStack
 {
@@ -83,16 +111,152 @@ typedef struct vvFieldStack
 } vvFieldStack;
 
 #define VV_CODEGEN_BUFFER_DEFAULT_LEN 16
+// spilled values are reloaded into the last registers, the allocator hands out the others
+#define VV_SCRATCH_REGISTERS 2
+#define VV_ALLOC_REGISTERS ( VV_REGISTER_COUNT - VV_SCRATCH_REGISTERS )
+// the generator recurses into nested expressions and blocks, operator chains are walked in a loop
+#define VV_CODEGEN_DEPTH_MAX 4096
+
+// the arguments pushed, the CALL and the POP of its result
+typedef struct vvGenCall
+{
+	size_t from, to;
+	// registers pushed before and popped after
+	unsigned saved;
+} vvGenCall;
+
+// live range of a virtual register, in instructions
+typedef struct vvGenInterval
+{
+	size_t start, end;
+	// register, or memory or frame slot once spilled
+	size_t loc;
+	int spilled;
+} vvGenInterval;
+
+// a function whose generation was interrupted by a nested one
+typedef struct vvGenFunc
+{
+	vvOpData *buf;
+	size_t cnt, len;
+	size_t regCnt;
+
+	vvGenCall *calls;
+	size_t callCnt, callLen;
+
+	size_t locCnt, locMax;
+} vvGenFunc;
 
+/*
+Code is generated into buf with virtual registers, one per value. When a
+function is done its live ranges go through a linear scan over
+VV_ALLOC_REGISTERS registers: the range ending last is spilled once they are
+all taken. Registers live across a call are pushed around it. The module
+itself is allocated by vv_generatorLoad.
+
+Locals and spills of a function are slots of its call frame, OP_FRAME at
+its start makes room for them, so a recursive call has storage of its own.
+The module runs once and keeps both in memory slots next to the globals.
+*/
 typedef struct vvGenerator
 {
 	vvOpData *buf;
 	size_t cnt, len;
 
+	// virtual registers and calls of the code in buf
+	size_t regCnt;
+	vvGenCall *calls;
+	size_t callCnt, callLen;
+
+	// frame slots of the function in buf, taken by the scopes open and the most ever taken
+	size_t locCnt, locMax;
+
+	// the functions buf was taken from, innermost last
+	vvGenFunc *outer;
+	size_t outerCnt, outerLen;
+
+	// finished functions, OP_LOADF refers to them by position
+	vvOpData **funcs;
+	size_t *funcLens;
+	size_t funcCnt, funcLen;
+
+	// the module being generated, for the errors reported, NULL when it has no file
+	const char *fileName;
+
+	// memory slots handed out, to globals and to the locals and spills of the module
+	size_t memCnt;
+
+	// set to have vv_optimizeCode run on every function once it is allocated
+	int optimize;
+	// set to build every function and the module code as a vvIR first, which vv_irOptimize works on
+	int buildIR;
+	// the instructions vv_optimizeCode took out, and what vv_irOptimize did
+	size_t optRemoved, optHoisted, optMerged;
+
+	// the functions being built, by nesting, irs[ 0 ] is the module's
+	vvIR **irs;
+	size_t irCnt, irLen;
+	// while a loop condition is lowered again, the functions it made the first time, work[ reuse ] on
+	size_t reuse, reuseEnd;
+
+	// nesting of the node being generated and the position its instructions get
+	size_t depth;
+	size_t row, col;
+
+	// operator chains and call arguments being generated, nested ones on top
+	size_t *work;
+	size_t workCnt, workLen;
+
+	// register allocator buffers, kept between functions
+	vvGenInterval *ivs;
+	size_t *order, *marks;
+	size_t ivLen, marksLen;
+	vvOpData *out;
+	size_t outLen;
+
 	vvSymTable *tbl;
 
 	vvFieldStack *fields;
 	vvGenField *curField;
+	vvGenField *spareFields;
 } vvGenerator;
 
+vvGenerator *vv_newGenerator( size_t bufLen );
+// drops the code and symbols of the last compilation, buffers and fields are kept
+void vv_generatorReset( vvGenerator *gen );
+void vv_freeGenerator( vvGenerator *gen );
+vvSymTable *vv_newSymTable( );
+// back to only the builtins, the sections keep their size
+void vv_symTableReset( vvSymTable *tbl );
+void vv_freeSymTable( vvSymTable *tbl );
+// the named variable, NULL if there is none
+vvGenVar *vv_symTableGet( vvSymTable *tbl, vvString id );
+vvGenVar *vv_symTableDeclare( vvSymTable *tbl, vvString id, size_t idx );
+
+vvGenField *vv_genFieldTake( vvGenerator *gen );
+vvGenVar *vv_genFieldGet( vvGenField *field, vvString id );
+vvGenVar *vv_genFieldDeclare( vvGenField *field, vvString id, vvVarType type, size_t idx );
+// a scope on top of the current one, boundary when it is the body of a function
+void vv_genEnterField( vvGenerator *gen, int boundary );
+void vv_genLeaveField( vvGenerator *gen );
+
+// the innermost variable named id, a new global when no scope has one
+vvGenVar *vv_genFindVar( vvGenerator *gen, vvString id );
+// a variable of the current scope, shadowing the ones further out
+vvGenVar *vv_genDeclare( vvGenerator *gen, vvString id );
+
+// the virtual register holding the value
+size_t vv_generateExpr( vvGenerator *gen, vvSyntaxTree *tree, vvNode expr );
+void vv_generateBlock( vvGenerator *gen, vvSyntaxTree *tree, vvNode block );
+void vv_generateStatement( vvGenerator *gen, vvSyntaxContainer *stmt );
+void vv_generateFlatStatement( vvGenerator *gen, vvSyntaxTree *tree, vvNode stmt );
+// the generator is left at the global field after an error, with the code of the tree dropped
+vvResult vv_generateTree( vvGenerator *gen, vvSyntaxTree *tree, vvError *err );
+
+/*
+Adds the functions and the module generated so far to vm, the module ends with
+OP_HALT and is where vm->idx is set to. Returns its function index.
+*/
+size_t vv_generatorLoad( vvGenerator *gen, vvVM *vm );
+
 #endif
\ No newline at end of file
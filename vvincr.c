@@ -0,0 +1,512 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "vvincr.h"
+#include "vvcom.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define VV_INCR_TEXT_DEFAULT_LEN 256
+#define VV_INCR_STMT_DEFAULT_LEN 16
+
+// reads the text from off on for a stream lexer
+typedef struct vvIncrCursor
+{
+	vvIncr *inc;
+	size_t off;
+} vvIncrCursor;
+
+#define istmt( inc, idx ) \
+	( inc->stmts[ ( idx ) < inc->stmtGap ? ( idx ) : ( idx ) + ( inc->stmtGapEnd - inc->stmtGap ) ] )
+
+vvIncr *vv_newIncr( const char *src, size_t len, char *fn, vvLexTable *tbl, vvError *err )
+{
+	vvIncr *rsl = ( vvIncr * ) malloc( sizeof( vvIncr ) );
+	assert( rsl );
+
+	rsl->fileName = fn;
+	rsl->tbl = tbl;
+
+	rsl->textCapacity = VV_INCR_TEXT_DEFAULT_LEN;
+	rsl->text = ( char * ) malloc( rsl->textCapacity );
+	assert( rsl->text );
+	rsl->textGap = 0;
+	rsl->textGapEnd = rsl->textCapacity;
+
+	// an empty document is a single statement without a tree
+	rsl->stmtCapacity = VV_INCR_STMT_DEFAULT_LEN;
+	rsl->stmts = ( vvIncrStmt * ) malloc( rsl->stmtCapacity * sizeof( vvIncrStmt ) );
+	assert( rsl->stmts );
+	rsl->stmtGap = 0;
+	rsl->stmtGapEnd = rsl->stmtCapacity - 1;
+	rsl->stmts[ rsl->stmtGapEnd ] = ( vvIncrStmt ){ 0, 0, NULL, NULL };
+
+	rsl->gapOff = rsl->gapRows = 0;
+
+	rsl->fresh = NULL;
+	rsl->freshCnt = rsl->freshCapacity = 0;
+
+	vv_incrEdit( rsl, 0, 0, src, len, err );
+
+	return rsl;
+}
+
+static void istmtRelease( vvIncrStmt st )
+{
+	if ( st.pass && --st.pass->refs == 0 )
+	{
+		vv_freeSyntaxArena( st.pass->arena );
+		free( st.pass );
+	}
+}
+
+void vv_freeIncr( vvIncr *inc )
+{
+	for ( size_t i = 0; i < vv_incrStatementCount( inc ); i++ )
+		istmtRelease( istmt( inc, i ) );
+
+	free( inc->text );
+	free( inc->stmts );
+	free( inc->fresh );
+	free( inc );
+}
+
+size_t vv_incrLength( vvIncr *inc )
+{
+	return inc->textCapacity - ( inc->textGapEnd - inc->textGap );
+}
+
+size_t vv_incrStatementCount( vvIncr *inc )
+{
+	return inc->stmtGap + ( inc->stmtCapacity - inc->stmtGapEnd );
+}
+
+vvSyntaxContainer *vv_incrStatement( vvIncr *inc, size_t idx )
+{
+	assert( idx < vv_incrStatementCount( inc ) );
+
+	return istmt( inc, idx ).syn;
+}
+
+void vv_incrRead( vvIncr *inc, size_t off, char *buf, size_t len )
+{
+	assert( off + len <= vv_incrLength( inc ) );
+
+	if ( off < inc->textGap )
+	{
+		size_t n = inc->textGap - off < len ? inc->textGap - off : len;
+
+		memcpy( buf, inc->text + off, n );
+		buf += n;
+		off += n;
+		len -= n;
+	}
+
+	memcpy( buf, inc->text + off + ( inc->textGapEnd - inc->textGap ), len );
+}
+
+static char ichar( vvIncr *inc, size_t off )
+{
+	return inc->text[ off < inc->textGap ? off : off + ( inc->textGapEnd - inc->textGap ) ];
+}
+
+// turns row and col counted from off, which is rows rows into the file, into file ones
+static void ilocate( vvIncr *inc, size_t off, size_t rows, size_t *row, size_t *col )
+{
+	// the first line may start in the middle of a file line
+	if ( *row == 1 )
+	{
+		size_t lineStart = off;
+
+		while ( lineStart > 0 && ichar( inc, lineStart - 1 ) != '\n' && ichar( inc, lineStart - 1 ) != '\r' )
+			lineStart--;
+
+		*col += off - lineStart;
+	}
+
+	*row += rows;
+}
+
+void vv_incrLocate( vvIncr *inc, size_t idx, vvToken tk, size_t *row, size_t *col )
+{
+	assert( idx < vv_incrStatementCount( inc ) );
+
+	// walk from the gap, edits are usually close to what gets looked up
+	size_t off = inc->gapOff, rows = inc->gapRows;
+
+	for ( size_t i = inc->stmtGap; i > idx; i-- )
+	{
+		off -= istmt( inc, i - 1 ).len;
+		rows -= istmt( inc, i - 1 ).rows;
+	}
+
+	for ( size_t i = inc->stmtGap; i < idx; i++ )
+	{
+		off += istmt( inc, i ).len;
+		rows += istmt( inc, i ).rows;
+	}
+
+	*row = tk.row;
+	*col = tk.col;
+
+	ilocate( inc, off, rows, row, col );
+}
+
+static size_t irefill( void *ud, char *buf, size_t len )
+{
+	vvIncrCursor *cur = ( vvIncrCursor * ) ud;
+	size_t left = vv_incrLength( cur->inc ) - cur->off;
+
+	// small reads, the lexer rarely needs more than the damaged statements
+	if ( len > left )
+		len = left;
+	if ( len > VV_INCR_REFILL_LEN )
+		len = VV_INCR_REFILL_LEN;
+
+	vv_incrRead( cur->inc, cur->off, buf, len );
+	cur->off += len;
+
+	return len;
+}
+
+static void itextMove( vvIncr *inc, size_t off )
+{
+	size_t gapLen = inc->textGapEnd - inc->textGap;
+
+	if ( off < inc->textGap )
+		memmove( inc->text + off + gapLen, inc->text + off, inc->textGap - off );
+	else
+		memmove( inc->text + inc->textGap, inc->text + inc->textGapEnd, off - inc->textGap );
+
+	inc->textGap = off;
+	inc->textGapEnd = off + gapLen;
+}
+
+static void itextReserve( vvIncr *inc, size_t len )
+{
+	if ( inc->textGapEnd - inc->textGap >= len )
+		return;
+
+	size_t after = inc->textCapacity - inc->textGapEnd;
+	size_t capacity = inc->textCapacity * 2;
+
+	if ( capacity < vv_incrLength( inc ) + len )
+		capacity = vv_incrLength( inc ) + len;
+
+	char *temp = ( char * ) realloc( inc->text, capacity );
+	assert( temp );
+	inc->text = temp;
+
+	memmove( inc->text + capacity - after, inc->text + inc->textGapEnd, after );
+	inc->textGapEnd = capacity - after;
+	inc->textCapacity = capacity;
+}
+
+static void istmtBack( vvIncr *inc )
+{
+	vvIncrStmt st = inc->stmts[ --inc->stmtGap ];
+
+	inc->stmts[ --inc->stmtGapEnd ] = st;
+	inc->gapOff -= st.len;
+	inc->gapRows -= st.rows;
+}
+
+static void istmtForward( vvIncr *inc )
+{
+	vvIncrStmt st = inc->stmts[ inc->stmtGapEnd++ ];
+
+	inc->stmts[ inc->stmtGap++ ] = st;
+	inc->gapOff += st.len;
+	inc->gapRows += st.rows;
+}
+
+static void istmtPush( vvIncr *inc, vvIncrStmt st )
+{
+	if ( inc->stmtGap == inc->stmtGapEnd )
+	{
+		size_t after = inc->stmtCapacity - inc->stmtGapEnd;
+		size_t capacity = inc->stmtCapacity * 2;
+
+		vvIncrStmt *temp = ( vvIncrStmt * ) realloc( inc->stmts, capacity * sizeof( vvIncrStmt ) );
+		assert( temp );
+		inc->stmts = temp;
+
+		memmove( inc->stmts + capacity - after, inc->stmts + inc->stmtGapEnd, after * sizeof( vvIncrStmt ) );
+		inc->stmtGapEnd = capacity - after;
+		inc->stmtCapacity = capacity;
+	}
+
+	inc->stmts[ inc->stmtGap++ ] = st;
+	inc->gapOff += st.len;
+	inc->gapRows += st.rows;
+}
+
+// drops the first statement behind the gap, it has been parsed again
+static size_t istmtDrop( vvIncr *inc )
+{
+	vvIncrStmt st = inc->stmts[ inc->stmtGapEnd++ ];
+
+	istmtRelease( st );
+
+	return st.len;
+}
+
+// moves the tokens of a statement parsed off the middle of a pass to its own origin
+typedef struct vvIncrBase
+{
+	size_t off, row, col;
+} vvIncrBase;
+
+static void irebaseNode( vvSyntaxContainer *syn, void *ud )
+{
+	vvIncrBase *base = ( vvIncrBase * ) ud;
+	vvToken *tk = &syn->attr.tk;
+
+	if ( tk->tt != TT_NONE )
+	{
+		if ( tk->row == base->row )
+			tk->col -= base->col - 1;
+
+		tk->row -= base->row - 1;
+		tk->span.off -= base->off;
+	}
+}
+
+static void irebase( vvSyntaxContainer *syn, size_t off, size_t row, size_t col )
+{
+	vvIncrBase base = { off, row, col };
+
+	vv_syntaxEach( syn, irebaseNode, &base );
+}
+
+// the parse of one edit, it only reads the document until it went through
+typedef struct vvIncrJob
+{
+	vvIncr *inc;
+	vvParser *p;
+	size_t start, oldEnd, removed, len;
+
+	// old statements behind the gap that the new ones replace
+	size_t drops;
+
+	// set when only blanks follow start, tail is the end of the input
+	int blanks;
+	vvToken tail;
+} vvIncrJob;
+
+static void ifresh( vvIncr *inc, vvIncrStmt st )
+{
+	if ( inc->freshCnt >= inc->freshCapacity )
+	{
+		inc->freshCapacity = inc->freshCapacity ? inc->freshCapacity * 2 : VV_INCR_STMT_DEFAULT_LEN;
+
+		vvIncrStmt *temp = ( vvIncrStmt * ) realloc( inc->fresh, inc->freshCapacity * sizeof( vvIncrStmt ) );
+		assert( temp );
+		inc->fresh = temp;
+	}
+
+	inc->fresh[ inc->freshCnt++ ] = st;
+}
+
+static void iparse( void *ud )
+{
+	vvIncrJob *job = ( vvIncrJob * ) ud;
+	vvIncr *inc = job->inc;
+	vvParser *p = job->p;
+	size_t after = inc->stmtCapacity - inc->stmtGapEnd;
+
+	// old is where the next old statement starts, counted before the edit
+	size_t old = job->start;
+
+	// origin of the statement being parsed, relative to start
+	size_t stOff = 0, stRow = 1, stCol = 1;
+
+	p->tkBuf = vv_lexerRead( p->lex );
+
+	// only blanks left after start, they belong to the statement in front
+	if ( p->tkBuf.tt == TT_EOF && inc->stmtGap > 0 )
+	{
+		job->drops = after;
+		job->blanks = 1;
+		job->tail = p->tkBuf;
+		return;
+	}
+
+	for ( ;; )
+	{
+		vvSyntaxContainer *syn = NULL;
+
+		if ( p->tkBuf.tt != TT_EOF )
+		{
+			syn = vv_newSyntaxContainer( p );
+			parseStatement( p, syn );
+
+			// separators stay with the statement they end
+			while ( p->tkBuf.tt == TT_SEMICOLON )
+				p->tkBuf = vv_lexerRead( p->lex );
+		}
+
+		vvToken next = p->tkBuf;
+		size_t nb = job->start + next.span.off;
+
+		// the old statements that were damaged or that the new text ran over
+		while ( job->drops < after &&
+				( next.tt == TT_EOF || old < job->oldEnd || old + job->len < nb + job->removed ) )
+			old += inc->stmts[ inc->stmtGapEnd + job->drops++ ].len;
+
+		irebase( syn, stOff, stRow, stCol );
+		ifresh( inc, ( vvIncrStmt ){ next.span.off - stOff, next.row - stRow, syn, NULL } );
+
+		if ( next.tt == TT_EOF )
+			break;
+
+		// back in step with the old statements, the rest is unchanged
+		if ( job->drops < after && old >= job->oldEnd && old + job->len == nb + job->removed )
+			break;
+
+		stOff = next.span.off;
+		stRow = next.row;
+		stCol = next.col;
+	}
+}
+
+// line breaks in len bytes at off, a "\r\n" or "\n\r" pair counts once
+static size_t irows( vvIncr *inc, size_t off, size_t len )
+{
+	size_t rsl = 0;
+
+	for ( size_t i = off; i < off + len; i++ )
+	{
+		char c = ichar( inc, i );
+
+		if ( c != '\r' && c != '\n' )
+			continue;
+
+		rsl++;
+
+		if ( i + 1 < off + len && ( ichar( inc, i + 1 ) == '\r' || ichar( inc, i + 1 ) == '\n' ) && ichar( inc, i + 1 ) != c )
+			i++;
+	}
+
+	return rsl;
+}
+
+vvResult vv_incrEdit( vvIncr *inc, size_t off, size_t removed, const char *text, size_t len, vvError *err )
+{
+	size_t docLen = vv_incrLength( inc );
+
+	if ( off > docLen || removed > docLen - off )
+	{
+		vv_setError( err, VV_ERR_INTERNAL, inc->fileName, 0, 0, "Edit of %zd bytes at %zd is out of range", removed, off );
+		return err->code;
+	}
+
+	// park the gap in front of the statement holding off, there is always one after the gap
+	while ( inc->stmtGap > 0 && off < inc->gapOff )
+		istmtBack( inc );
+	while ( inc->stmtGapEnd + 1 < inc->stmtCapacity && off >= inc->gapOff + inc->stmts[ inc->stmtGapEnd ].len )
+		istmtForward( inc );
+
+	// the previous statement ended where it saw the first token of this one, so it is redone too.
+	// Text that did not parse ends at an old boundary and waits for an edit of its own
+	if ( inc->stmtGap > 0 && inc->stmts[ inc->stmtGap - 1 ].syn )
+		istmtBack( inc );
+
+	itextMove( inc, off );
+	inc->textGapEnd += removed;
+	itextReserve( inc, len );
+	memcpy( inc->text + inc->textGap, text, len );
+	inc->textGap += len;
+
+	size_t start = inc->gapOff;
+
+	vvIncrCursor cur = { inc, start };
+	vvLexer *lex = vv_newStreamLexer( irefill, &cur, inc->fileName, VV_CHAR_BUFFER_DEFAULT_LEN, inc->tbl );
+	vvParser *p = vv_newParser( lex );
+
+	vvIncrJob job = { inc, p, start, off + removed, removed, len, 0, 0, { 0 } };
+
+	inc->freshCnt = 0;
+
+	vvResult rsl = vv_try( err, iparse, &job );
+
+	vvIncrPass *pass = ( vvIncrPass * ) malloc( sizeof( vvIncrPass ) );
+	assert( pass );
+	pass->arena = vv_parserTakeArena( p );
+	pass->refs = inc->freshCnt;
+
+	// where the parse gave up, old is the first old statement past it
+	size_t at = start + lex->base + lex->inputIdx, old = start;
+
+	vv_freeParser( p );
+	vv_freeLexer( lex );
+
+	if ( rsl != VV_OK )
+	{
+		job.drops = 0;
+
+		while ( inc->stmtGapEnd + job.drops < inc->stmtCapacity &&
+				( old < off + removed || old + len <= at + removed ) )
+			old += inc->stmts[ inc->stmtGapEnd + job.drops++ ].len;
+
+		if ( err->row > 0 )
+			ilocate( inc, start, inc->gapRows, &err->row, &err->col );
+	}
+
+	while ( job.drops-- > 0 )
+		istmtDrop( inc );
+
+	if ( job.blanks )
+	{
+		inc->stmts[ inc->stmtGap - 1 ].len += job.tail.span.off;
+		inc->stmts[ inc->stmtGap - 1 ].rows += job.tail.row - 1;
+		inc->gapOff += job.tail.span.off;
+		inc->gapRows += job.tail.row - 1;
+	}
+
+	for ( size_t i = 0; i < inc->freshCnt; i++ )
+	{
+		inc->fresh[ i ].pass = pass;
+		istmtPush( inc, inc->fresh[ i ] );
+	}
+
+	// the text stays as edited, what is left up to the next old statement
+	// becomes one statement without a tree until an edit repairs it
+	if ( rsl != VV_OK )
+	{
+		size_t end = old + len - removed;
+
+		istmtPush( inc, ( vvIncrStmt ){ end - inc->gapOff, irows( inc, inc->gapOff, end - inc->gapOff ), NULL, NULL } );
+	}
+
+	if ( pass->refs == 0 )
+	{
+		vv_freeSyntaxArena( pass->arena );
+		free( pass );
+	}
+
+	return rsl;
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#ifndef VV_INCR
+#define VV_INCR
+
+#include "vvlex.h"
+#include "vvparser.h"
+
+#include <stdlib.h>
+
+/*
+Incremental front end for sources that are edited in place. The document is
+kept as a list of top-level statements, each owning the bytes from its first
+token up to the next statement ( the first one also owns the leading
+comments and blanks ). An edit re-lexes and reparses from the statement
+before the damage until the new statements line up with an old statement
+boundary again, everything past that point is reused as it is.
+
+Tokens inside a statement tree are relative to that statement: span.off
+counts from its first byte and row 1 is its first line, use vv_incrLocate
+for file positions. Both the text and the statement list are gap buffers
+parked at the last edit, so the cost of an edit depends on the size of the
+damaged statements and the distance from the previous edit, not on the file.
+
+An edit that does not parse still goes in. The statements parsed before
+the error are kept, and the rest up to the next old statement past where the
+parse gave up becomes one statement without a tree. An edit over it parses
+it again, edits around it leave it alone.
+*/
+
+#define VV_INCR_REFILL_LEN 1024
+
+// statements parsed by one edit share its arena, which goes with the last of them
+typedef struct vvIncrPass
+{
+	vvSyntaxArena *arena;
+	size_t refs;
+} vvIncrPass;
+
+typedef struct vvIncrStmt
+{
+	size_t len, rows;
+
+	// NULL for a document without any statement and for text that did not parse
+	vvSyntaxContainer *syn;
+	vvIncrPass *pass;
+} vvIncrStmt;
+
+typedef struct vvIncr
+{
+	char *fileName;
+	vvLexTable *tbl;
+
+	char *text;
+	size_t textGap, textGapEnd, textCapacity;
+
+	vvIncrStmt *stmts;
+	size_t stmtGap, stmtGapEnd, stmtCapacity;
+
+	// file offset and row count of the statements before the gap
+	size_t gapOff, gapRows;
+
+	// statements parsed by the running edit, they go in once it is through
+	vvIncrStmt *fresh;
+	size_t freshCnt, freshCapacity;
+} vvIncr;
+
+// err gets the error of src, the document is made either way
+vvIncr *vv_newIncr( const char *src, size_t len, char *fn, vvLexTable *tbl, vvError *err );
+void vv_freeIncr( vvIncr *inc );
+// replaces the removed bytes at off with len bytes of text, err gets the first error of the new text
+vvResult vv_incrEdit( vvIncr *inc, size_t off, size_t removed, const char *text, size_t len, vvError *err );
+
+size_t vv_incrLength( vvIncr *inc );
+size_t vv_incrStatementCount( vvIncr *inc );
+vvSyntaxContainer *vv_incrStatement( vvIncr *inc, size_t idx );
+// file row and column of a token taken from the tree of statement idx
+void vv_incrLocate( vvIncr *inc, size_t idx, vvToken tk, size_t *row, size_t *col );
+// copies len bytes of the current text at off into buf
+void vv_incrRead( vvIncr *inc, size_t off, char *buf, size_t len );
+
+#endif
\ No newline at end of file
@@ -0,0 +1,1156 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "vvir.h"
+#include "vvlex.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VV_IR_DEFAULT_LEN 16
+
+// what the passes know of a value
+#define IF_NUMBER 1
+#define IF_FAULT 2
+#define IF_NEEDED 4
+
+// grows *sto to hold at least need items of size bytes
+static void igrow( void **sto, size_t *len, size_t need, size_t size )
+{
+	if ( need <= *len )
+		return;
+
+	size_t l = *len ? *len : VV_IR_DEFAULT_LEN;
+
+	while ( l < need )
+		l *= 2;
+
+	void *temp = realloc( *sto, l * size );
+	assert( temp );
+
+	*sto = temp;
+	*len = l;
+}
+
+vvIR *vv_newIR( )
+{
+	vvIR *rsl = ( vvIR * ) calloc( 1, sizeof( vvIR ) );
+	assert( rsl );
+
+	vv_irReset( rsl );
+
+	return rsl;
+}
+
+void vv_irReset( vvIR *ir )
+{
+	ir->instCnt = ir->blockCnt = ir->layoutCnt = 0;
+	ir->loopCnt = ir->argCnt = 0;
+	ir->openCnt = ir->fillCnt = 0;
+	ir->row = ir->col = 0;
+	ir->hoisted = ir->merged = 0;
+
+	ir->mapCnt = 0;
+
+	if ( ++ir->stamp == 0 )
+	{
+		memset( ir->stamps, 0, ir->mapLen * sizeof( unsigned ) );
+		ir->stamp = 1;
+	}
+
+	size_t entry = vv_irBlock( ir );
+
+	ir->blocks[ entry ].sealed = ir->blocks[ entry ].live = ir->blocks[ entry ].reload = 1;
+	vv_irPlace( ir, entry );
+}
+
+void vv_freeIR( vvIR *ir )
+{
+	free( ir->insts );
+	free( ir->blocks );
+	free( ir->layout );
+	free( ir->loops );
+	free( ir->args );
+	free( ir->keys );
+	free( ir->vals );
+	free( ir->stamps );
+	free( ir->open );
+	free( ir->fill );
+	free( ir->facts );
+	free( ir->ords );
+	free( ir->lasts );
+	free( ir->cls );
+	free( ir->regs );
+	free( ir->set );
+	free( ir->ends );
+	free( ir->labels );
+
+	free( ir );
+}
+
+size_t vv_irBlock( vvIR *ir )
+{
+	igrow( ( void ** ) &ir->blocks, &ir->blockLen, ir->blockCnt + 1, sizeof( vvIRBlock ) );
+
+	ir->blocks[ ir->blockCnt ] = ( vvIRBlock ){
+		.first = VV_IR_NONE,
+		.last = VV_IR_NONE,
+		.exit = EXIT_FALL,
+		.val = VV_IR_NONE,
+		.pos = VV_IR_NONE,
+		.idom = VV_IR_NONE,
+		.loop = VV_IR_NONE,
+	};
+
+	return ir->blockCnt++;
+}
+
+void vv_irPlace( vvIR *ir, size_t block )
+{
+	igrow( ( void ** ) &ir->layout, &ir->layoutLen, ir->layoutCnt + 1, sizeof( size_t ) );
+
+	ir->blocks[ block ].pos = ir->layoutCnt;
+	ir->layout[ ir->layoutCnt++ ] = block;
+	ir->cur = block;
+}
+
+// an edge control can take, nothing comes out of a block it can not get to
+static void iedge( vvIR *ir, size_t from, size_t to )
+{
+	vvIRBlock *f = &ir->blocks[ from ];
+	vvIRBlock *t = &ir->blocks[ to ];
+
+	if ( !f->live )
+		return;
+
+	assert( !t->sealed && t->predCnt < 2 );
+
+	f->succs[ f->succCnt++ ] = to;
+	t->preds[ t->predCnt++ ] = from;
+	t->live = 1;
+}
+
+static void iexit( vvIR *ir, vvIRExit exit, size_t val )
+{
+	vvIRBlock *blk = &ir->blocks[ ir->cur ];
+
+	blk->exit = exit;
+	blk->val = val;
+	blk->info[ 0 ] = ir->row;
+	blk->info[ 1 ] = ir->col;
+}
+
+void vv_irGoto( vvIR *ir, size_t to )
+{
+	iexit( ir, EXIT_GOTO, VV_IR_NONE );
+	iedge( ir, ir->cur, to );
+}
+
+void vv_irBranch( vvIR *ir, size_t cond, size_t t, size_t f )
+{
+	iexit( ir, EXIT_BRANCH, cond );
+	iedge( ir, ir->cur, t );
+	iedge( ir, ir->cur, f );
+}
+
+void vv_irReturn( vvIR *ir, size_t val )
+{
+	iexit( ir, EXIT_RETURN, val );
+}
+
+void vv_irLoop( vvIR *ir, size_t pre, size_t head )
+{
+	igrow( ( void ** ) &ir->loops, &ir->loopLen, ir->loopCnt + 1, sizeof( vvIRLoop ) );
+	ir->loops[ ir->loopCnt++ ] = ( vvIRLoop ){ pre, head, ir->cur };
+}
+
+static size_t inew( vvIR *ir, unsigned op, size_t a, size_t b, size_t imm )
+{
+	igrow( ( void ** ) &ir->insts, &ir->instLen, ir->instCnt + 1, sizeof( vvIRInst ) );
+
+	size_t rsl = ir->instCnt++;
+
+	ir->insts[ rsl ] = ( vvIRInst ){
+		.op = op,
+		.block = VV_IR_NONE,
+		.a = a,
+		.b = b,
+		.imm = imm,
+		.info = { ir->row, ir->col },
+		.prev = VV_IR_NONE,
+		.next = VV_IR_NONE,
+		.repl = rsl,
+	};
+
+	return rsl;
+}
+
+// puts val into block after at, first when at is VV_IR_NONE
+static void ilink( vvIR *ir, size_t val, size_t block, size_t at )
+{
+	vvIRBlock *blk = &ir->blocks[ block ];
+	vvIRInst *inst = &ir->insts[ val ];
+	size_t next = at == VV_IR_NONE ? blk->first : ir->insts[ at ].next;
+
+	inst->block = block;
+	inst->prev = at;
+	inst->next = next;
+
+	if ( at == VV_IR_NONE )
+		blk->first = val;
+	else
+		ir->insts[ at ].next = val;
+
+	if ( next == VV_IR_NONE )
+		blk->last = val;
+	else
+		ir->insts[ next ].prev = val;
+}
+
+static void iunlink( vvIR *ir, size_t val )
+{
+	vvIRInst *inst = &ir->insts[ val ];
+	vvIRBlock *blk = &ir->blocks[ inst->block ];
+
+	if ( inst->prev == VV_IR_NONE )
+		blk->first = inst->next;
+	else
+		ir->insts[ inst->prev ].next = inst->next;
+
+	if ( inst->next == VV_IR_NONE )
+		blk->last = inst->prev;
+	else
+		ir->insts[ inst->next ].prev = inst->prev;
+
+	inst->block = VV_IR_NONE;
+}
+
+// at the start of block, after its phis
+static size_t ihead( vvIR *ir, size_t block, unsigned op, size_t imm )
+{
+	size_t rsl = inew( ir, op, 0, 0, imm );
+	size_t at = VV_IR_NONE;
+
+	for ( size_t v = ir->blocks[ block ].first; v != VV_IR_NONE && ir->insts[ v ].op == VV_IR_PHI; v = ir->insts[ v ].next )
+		at = v;
+
+	ilink( ir, rsl, block, at );
+
+	return rsl;
+}
+
+size_t vv_irEmit( vvIR *ir, unsigned op, size_t a, size_t b, size_t imm )
+{
+	size_t rsl = inew( ir, op, a, b, imm );
+
+	ilink( ir, rsl, ir->cur, ir->blocks[ ir->cur ].last );
+
+	return rsl;
+}
+
+size_t vv_irCall( vvIR *ir, size_t fn, const size_t *args, size_t argc )
+{
+	igrow( ( void ** ) &ir->args, &ir->argLen, ir->argCnt + argc, sizeof( size_t ) );
+
+	// args stays NULL until a call has some
+	if ( argc )
+		memcpy( ir->args + ir->argCnt, args, argc * sizeof( size_t ) );
+
+	size_t rsl = vv_irEmit( ir, OP_CALL, fn, ir->argCnt, argc );
+	size_t after = vv_irBlock( ir );
+
+	ir->argCnt += argc;
+
+	vv_irGoto( ir, after );
+	vv_irSeal( ir, after );
+	ir->blocks[ after ].reload = 1;
+	vv_irPlace( ir, after );
+
+	return rsl;
+}
+
+static size_t ihash( size_t var, size_t block, size_t len )
+{
+	uint64_t key = ( uint64_t ) var * 0x9E3779B97F4A7C15ull + block;
+
+	return ( size_t ) ( ( key * 0x9E3779B97F4A7C15ull ) >> 32 ) & ( len - 1 );
+}
+
+// NULL when the block has no value for var yet
+static size_t *iget( vvIR *ir, size_t var, size_t block )
+{
+	if ( ir->mapLen == 0 )
+		return NULL;
+
+	for ( size_t i = ihash( var, block, ir->mapLen );; i = ( i + 1 ) & ( ir->mapLen - 1 ) )
+	{
+		if ( ir->stamps[ i ] != ir->stamp )
+			return NULL;
+		if ( ir->keys[ 2 * i ] == var && ir->keys[ 2 * i + 1 ] == block )
+			return &ir->vals[ i ];
+	}
+}
+
+static void iput( vvIR *ir, size_t var, size_t block, size_t val );
+
+// kept at most half full
+static void imapGrow( vvIR *ir )
+{
+	size_t *keys = ir->keys, *vals = ir->vals;
+	unsigned *stamps = ir->stamps, stamp = ir->stamp;
+	size_t len = ir->mapLen;
+
+	ir->mapLen = len ? 2 * len : VV_IR_DEFAULT_LEN;
+	ir->keys = ( size_t * ) malloc( 2 * ir->mapLen * sizeof( size_t ) );
+	assert( ir->keys );
+	ir->vals = ( size_t * ) malloc( ir->mapLen * sizeof( size_t ) );
+	assert( ir->vals );
+	ir->stamps = ( unsigned * ) calloc( ir->mapLen, sizeof( unsigned ) );
+	assert( ir->stamps );
+	ir->stamp = 1;
+	ir->mapCnt = 0;
+
+	for ( size_t i = 0; i < len; i++ )
+		if ( stamps[ i ] == stamp )
+			iput( ir, keys[ 2 * i ], keys[ 2 * i + 1 ], vals[ i ] );
+
+	free( keys );
+	free( vals );
+	free( stamps );
+}
+
+static void iput( vvIR *ir, size_t var, size_t block, size_t val )
+{
+	if ( 2 * ( ir->mapCnt + 1 ) > ir->mapLen )
+		imapGrow( ir );
+
+	for ( size_t i = ihash( var, block, ir->mapLen );; i = ( i + 1 ) & ( ir->mapLen - 1 ) )
+	{
+		if ( ir->stamps[ i ] != ir->stamp )
+		{
+			ir->keys[ 2 * i ] = var;
+			ir->keys[ 2 * i + 1 ] = block;
+			ir->stamps[ i ] = ir->stamp;
+			ir->mapCnt++;
+		}
+		else if ( ir->keys[ 2 * i ] != var || ir->keys[ 2 * i + 1 ] != block )
+			continue;
+
+		ir->vals[ i ] = val;
+		return;
+	}
+}
+
+static void ipush( size_t **sto, size_t *cnt, size_t *len, size_t val )
+{
+	igrow( ( void ** ) sto, len, *cnt + 1, sizeof( size_t ) );
+	( *sto )[ ( *cnt )++ ] = val;
+}
+
+/*
+The value of var at the end of block. A chain of blocks with one predecessor
+each has the value of its top and is walked in a loop, a phi gets its
+operands later from vv_irSeal or ifill, so nothing here recurses.
+*/
+static size_t iread( vvIR *ir, size_t var, size_t block )
+{
+	size_t from = block, rsl;
+
+	for ( ;; )
+	{
+		size_t *def = iget( ir, var, block );
+		vvIRBlock *blk = &ir->blocks[ block ];
+
+		if ( def )
+		{
+			rsl = *def;
+			break;
+		}
+
+		// memory is current wherever control comes from
+		if ( ( var & 1 ) && ( blk->reload || !blk->sealed || blk->predCnt == 2 ) )
+		{
+			rsl = ihead( ir, block, OP_LOAD, var >> 1 );
+			break;
+		}
+
+		if ( !blk->sealed || blk->predCnt == 2 )
+		{
+			rsl = inew( ir, VV_IR_PHI, VV_IR_NONE, VV_IR_NONE, var );
+			ilink( ir, rsl, block, VV_IR_NONE );
+
+			if ( blk->sealed )
+				ipush( &ir->fill, &ir->fillCnt, &ir->fillLen, rsl );
+			else
+				ipush( &ir->open, &ir->openCnt, &ir->openLen, rsl );
+			break;
+		}
+
+		// only where control can not get to
+		if ( blk->predCnt == 0 )
+		{
+			rsl = ihead( ir, block, OP_LOADK, TT_NIL - TT_TRUE );
+			break;
+		}
+
+		block = blk->preds[ 0 ];
+	}
+
+	for ( ; from != block; from = ir->blocks[ from ].preds[ 0 ] )
+		iput( ir, var, from, rsl );
+
+	iput( ir, var, block, rsl );
+
+	return rsl;
+}
+
+// operands for the phis of sealed blocks, reading them may make more phis
+static void ifill( vvIR *ir )
+{
+	while ( ir->fillCnt )
+	{
+		size_t phi = ir->fill[ --ir->fillCnt ];
+		size_t var = ir->insts[ phi ].imm;
+		size_t block = ir->insts[ phi ].block;
+
+		for ( size_t k = 0; k < ir->blocks[ block ].predCnt; k++ )
+		{
+			size_t val = iread( ir, var, ir->blocks[ block ].preds[ k ] );
+
+			if ( k )
+				ir->insts[ phi ].b = val;
+			else
+				ir->insts[ phi ].a = val;
+		}
+	}
+}
+
+void vv_irSeal( vvIR *ir, size_t block )
+{
+	size_t kept = 0;
+
+	ir->blocks[ block ].sealed = 1;
+
+	for ( size_t i = 0; i < ir->openCnt; i++ )
+	{
+		size_t phi = ir->open[ i ];
+
+		if ( ir->insts[ phi ].block == block )
+			ipush( &ir->fill, &ir->fillCnt, &ir->fillLen, phi );
+		else
+			ir->open[ kept++ ] = phi;
+	}
+
+	ir->openCnt = kept;
+	ifill( ir );
+}
+
+size_t vv_irRead( vvIR *ir, size_t var )
+{
+	size_t rsl = iread( ir, var, ir->cur );
+
+	ifill( ir );
+
+	return rsl;
+}
+
+void vv_irWrite( vvIR *ir, size_t var, size_t val )
+{
+	iput( ir, var, ir->cur, val );
+}
+
+size_t vv_irValue( vvIR *ir, size_t val )
+{
+	size_t rsl = val;
+
+	while ( ir->insts[ rsl ].repl != rsl )
+		rsl = ir->insts[ rsl ].repl;
+
+	while ( val != rsl )
+	{
+		size_t next = ir->insts[ val ].repl;
+
+		ir->insts[ val ].repl = rsl;
+		val = next;
+	}
+
+	return rsl;
+}
+
+static size_t iopCnt( vvIR *ir, const vvIRInst *inst )
+{
+	switch ( inst->op )
+	{
+		case VV_IR_PHI:
+			return ir->blocks[ inst->block ].predCnt;
+		case OP_CALL:
+			return 1 + inst->imm;
+		case OP_STORE:
+		case OP_NOT:
+		case OP_INV:
+			return 1;
+		case OP_LOAD:
+		case OP_LOADK:
+		case OP_LOADS:
+		case OP_LOADF:
+		case OP_POP:
+			return 0;
+		default:
+			return 2;
+	}
+}
+
+static size_t *iop( vvIR *ir, vvIRInst *inst, size_t k )
+{
+	if ( inst->op == OP_CALL && k )
+		return &ir->args[ inst->b + k - 1 ];
+
+	return k ? &inst->b : &inst->a;
+}
+
+#define iisConst( op ) ( ( op ) >= OP_LOADK && ( op ) <= OP_LOADF )
+// the same operands make the same value
+#define iisPure( op ) ( iisConst( op ) || ( ( op ) >= OP_NOT && ( op ) <= OP_DIV ) )
+#define iisEffect( op ) ( ( op ) == OP_STORE || ( op ) == OP_CALL || ( op ) == OP_POP )
+#define iisCommutative( op ) ( ( op ) == OP_EQ || ( op ) == OP_NEQ || ( op ) == OP_AND || \
+							   ( op ) == OP_OR || ( op ) == OP_ADD || ( op ) == OP_MUL )
+
+// per instruction arrays, the passes may add instructions
+static void ivals( vvIR *ir )
+{
+	size_t len = ir->valLen;
+
+	igrow( ( void ** ) &ir->facts, &len, ir->instCnt, sizeof( unsigned char ) );
+	len = ir->valLen;
+	igrow( ( void ** ) &ir->ords, &len, ir->instCnt, sizeof( size_t ) );
+	len = ir->valLen;
+	igrow( ( void ** ) &ir->lasts, &len, ir->instCnt, sizeof( size_t ) );
+	len = ir->valLen;
+	igrow( ( void ** ) &ir->cls, &len, ir->instCnt, sizeof( size_t ) );
+	len = ir->valLen;
+	igrow( ( void ** ) &ir->regs, &len, ir->instCnt, sizeof( size_t ) );
+
+	ir->valLen = len;
+}
+
+// a phi of one value besides itself is that value, taking it out may make others so
+static void itrivial( vvIR *ir )
+{
+	int changed = 1;
+
+	while ( changed )
+	{
+		changed = 0;
+
+		// later phis tend to read earlier ones
+		for ( size_t v = ir->instCnt; v--; )
+		{
+			vvIRInst *inst = &ir->insts[ v ];
+			size_t same = VV_IR_NONE;
+			int trivial = 1;
+
+			if ( inst->op != VV_IR_PHI || inst->block == VV_IR_NONE )
+				continue;
+
+			for ( size_t k = 0; k < iopCnt( ir, inst ) && trivial; k++ )
+			{
+				size_t op = vv_irValue( ir, *iop( ir, inst, k ) );
+
+				if ( op == v || op == same )
+					continue;
+
+				trivial = same == VV_IR_NONE;
+				same = op;
+			}
+
+			if ( !trivial || same == VV_IR_NONE )
+				continue;
+
+			inst->repl = same;
+			iunlink( ir, v );
+			changed = 1;
+		}
+	}
+}
+
+static size_t iintersect( vvIR *ir, size_t a, size_t b )
+{
+	while ( a != b )
+	{
+		while ( ir->blocks[ a ].pos > ir->blocks[ b ].pos )
+			a = ir->blocks[ a ].idom;
+		while ( ir->blocks[ b ].pos > ir->blocks[ a ].pos )
+			b = ir->blocks[ b ].idom;
+	}
+
+	return a;
+}
+
+/*
+The layout is in order of the edges but the ones from a latch, a block's
+dominator comes before it and a single walk settles them: the latch is
+dominated by its head and adds nothing to it.
+*/
+static void idominate( vvIR *ir )
+{
+	ir->blocks[ ir->layout[ 0 ] ].idom = ir->layout[ 0 ];
+
+	for ( size_t i = 1; i < ir->layoutCnt; i++ )
+	{
+		vvIRBlock *blk = &ir->blocks[ ir->layout[ i ] ];
+		size_t dom = VV_IR_NONE;
+
+		if ( !blk->live )
+			continue;
+
+		for ( size_t k = 0; k < blk->predCnt; k++ )
+		{
+			size_t pred = blk->preds[ k ];
+
+			if ( ir->blocks[ pred ].pos >= i )
+				continue;
+
+			dom = dom == VV_IR_NONE ? pred : iintersect( ir, pred, dom );
+		}
+
+		blk->idom = dom;
+	}
+
+	// loops end after the ones nested in them, so inner ones are marked last
+	for ( size_t i = 0; i < ir->layoutCnt; i++ )
+		ir->blocks[ ir->layout[ i ] ].loop = VV_IR_NONE;
+
+	for ( size_t l = ir->loopCnt; l--; )
+	{
+		size_t hi = ir->blocks[ ir->loops[ l ].latch ].pos;
+
+		for ( size_t i = ir->blocks[ ir->loops[ l ].head ].pos; i <= hi; i++ )
+			ir->blocks[ ir->layout[ i ] ].loop = l;
+	}
+}
+
+static int idominates( vvIR *ir, size_t a, size_t b )
+{
+	while ( ir->blocks[ b ].pos > ir->blocks[ a ].pos )
+		b = ir->blocks[ b ].idom;
+
+	return a == b;
+}
+
+/*
+Numbers are constants of the pool and what arithmetic makes, a phi is one
+when all it merges are, assumed first and taken back. What the VM checks
+the operand types of may fail unless they are numbers, a division always may.
+*/
+static void itypes( vvIR *ir )
+{
+	unsigned char *facts = ir->facts;
+	int changed = 1;
+
+	for ( size_t v = 0; v < ir->instCnt; v++ )
+	{
+		unsigned op = ir->insts[ v ].op;
+
+		facts[ v ] = 0;
+
+		if ( op == VV_IR_PHI || op == OP_INV || ( op >= OP_ADD && op <= OP_DIV ) ||
+			 ( op == OP_LOADK && ir->insts[ v ].imm >= VV_CONST_BUILTINS ) )
+			facts[ v ] = IF_NUMBER;
+	}
+
+	while ( changed )
+	{
+		changed = 0;
+
+		for ( size_t v = 0; v < ir->instCnt; v++ )
+		{
+			vvIRInst *inst = &ir->insts[ v ];
+
+			if ( inst->op != VV_IR_PHI || inst->block == VV_IR_NONE || !( facts[ v ] & IF_NUMBER ) )
+				continue;
+
+			for ( size_t k = 0; k < iopCnt( ir, inst ); k++ )
+			{
+				if ( !( facts[ vv_irValue( ir, *iop( ir, inst, k ) ) ] & IF_NUMBER ) )
+				{
+					facts[ v ] = 0;
+					changed = 1;
+					break;
+				}
+			}
+		}
+	}
+
+	for ( size_t v = 0; v < ir->instCnt; v++ )
+	{
+		vvIRInst *inst = &ir->insts[ v ];
+
+		if ( inst->block == VV_IR_NONE )
+			continue;
+
+		if ( inst->op == OP_INV && !( facts[ vv_irValue( ir, inst->a ) ] & IF_NUMBER ) )
+			facts[ v ] |= IF_FAULT;
+
+		if ( inst->op >= OP_GE && inst->op <= OP_DIV )
+			if ( inst->op == OP_DIV || !( facts[ vv_irValue( ir, inst->a ) ] & IF_NUMBER ) ||
+				 !( facts[ vv_irValue( ir, inst->b ) ] & IF_NUMBER ) )
+				facts[ v ] |= IF_FAULT;
+	}
+}
+
+// operands read through to the values they are, ordered when the order does not matter
+static void iresolve( vvIR *ir, size_t val )
+{
+	vvIRInst *inst = &ir->insts[ val ];
+
+	for ( size_t k = 0; k < iopCnt( ir, inst ); k++ )
+		*iop( ir, inst, k ) = vv_irValue( ir, *iop( ir, inst, k ) );
+
+	if ( iisCommutative( inst->op ) && inst->a > inst->b )
+	{
+		size_t a = inst->a;
+
+		inst->a = inst->b;
+		inst->b = a;
+	}
+}
+
+static int iequal( vvIR *ir, const vvIRInst *a, const vvIRInst *b )
+{
+	size_t n = iopCnt( ir, a );
+
+	return a->op == b->op && a->imm == b->imm && ( n < 1 || a->a == b->a ) && ( n < 2 || a->b == b->b );
+}
+
+/*
+An instruction computing what one in a dominating block already did is
+replaced with that one. One that may fail would have failed there first.
+The table keeps the last of equal ones: the blocks a block dominates follow
+it in the layout, so once one is passed that it does not dominate, none of
+the rest are either.
+*/
+static void icse( vvIR *ir )
+{
+	size_t len = VV_IR_DEFAULT_LEN;
+
+	while ( len < 2 * ir->instCnt )
+		len *= 2;
+
+	igrow( ( void ** ) &ir->set, &ir->setLen, len, sizeof( size_t ) );
+	memset( ir->set, 0xff, len * sizeof( size_t ) );
+
+	for ( size_t i = 0; i < ir->layoutCnt; i++ )
+	{
+		size_t block = ir->layout[ i ];
+
+		if ( !ir->blocks[ block ].live )
+			continue;
+
+		for ( size_t v = ir->blocks[ block ].first, next; v != VV_IR_NONE; v = next )
+		{
+			vvIRInst *inst = &ir->insts[ v ];
+			size_t n = iopCnt( ir, inst );
+
+			next = inst->next;
+
+			if ( !iisPure( inst->op ) )
+				continue;
+
+			iresolve( ir, v );
+
+			uint64_t key = ( ( uint64_t ) inst->op << 48 ) ^ inst->imm ^
+						   ( ( uint64_t ) ( n > 0 ? inst->a : 0 ) << 16 ) ^
+						   ( ( uint64_t ) ( n > 1 ? inst->b : 0 ) << 32 );
+
+			for ( size_t h = ( size_t ) ( ( key * 0x9E3779B97F4A7C15ull ) >> 32 ) & ( len - 1 );; h = ( h + 1 ) & ( len - 1 ) )
+			{
+				size_t other = ir->set[ h ];
+
+				if ( other != VV_IR_NONE && !iequal( ir, &ir->insts[ other ], inst ) )
+					continue;
+
+				if ( other != VV_IR_NONE && idominates( ir, ir->insts[ other ].block, block ) )
+				{
+					inst->repl = other;
+					iunlink( ir, v );
+					ir->merged++;
+				}
+				else
+					ir->set[ h ] = v;
+				break;
+			}
+		}
+	}
+}
+
+// the instructions of a loop are the blocks laid out from its head to its latch
+#define iinLoop( ir, val, lo, hi ) ( ir->blocks[ ir->insts[ val ].block ].pos >= ( lo ) && \
+									 ir->blocks[ ir->insts[ val ].block ].pos <= ( hi ) )
+
+/*
+The same on every turn: its operands come from before the loop or are
+constants. A memory slot is when the loop makes no call and ir->fill, the
+slots it stores to, does not hold it.
+*/
+static int iinvariant( vvIR *ir, size_t val, size_t lo, size_t hi, int calls )
+{
+	vvIRInst *inst = &ir->insts[ val ];
+
+	if ( inst->op == OP_LOAD && !calls )
+	{
+		for ( size_t i = 0; i < ir->fillCnt; i++ )
+			if ( ir->fill[ i ] == inst->imm )
+				return 0;
+
+		return 1;
+	}
+
+	if ( inst->op < OP_NOT || inst->op > OP_DIV )
+		return 0;
+
+	for ( size_t k = 0; k < iopCnt( ir, inst ); k++ )
+	{
+		size_t op = vv_irValue( ir, *iop( ir, inst, k ) );
+
+		if ( iinLoop( ir, op, lo, hi ) && !iisConst( ir->insts[ op ].op ) )
+			return 0;
+	}
+
+	return 1;
+}
+
+// to the end of pre, constants of the loop it reads are copied along
+static void ihoist( vvIR *ir, size_t val, size_t pre, size_t lo, size_t hi )
+{
+	for ( size_t k = 0; k < iopCnt( ir, &ir->insts[ val ] ); k++ )
+	{
+		size_t op = vv_irValue( ir, *iop( ir, &ir->insts[ val ], k ) );
+
+		if ( iinLoop( ir, op, lo, hi ) )
+		{
+			size_t copy = inew( ir, ir->insts[ op ].op, 0, 0, ir->insts[ op ].imm );
+
+			ir->insts[ copy ].info[ 0 ] = ir->insts[ op ].info[ 0 ];
+			ir->insts[ copy ].info[ 1 ] = ir->insts[ op ].info[ 1 ];
+			ilink( ir, copy, pre, ir->blocks[ pre ].last );
+
+			ivals( ir );
+			ir->facts[ copy ] = ir->facts[ op ];
+			op = copy;
+		}
+
+		*iop( ir, &ir->insts[ val ], k ) = op;
+	}
+
+	iunlink( ir, val );
+	ilink( ir, val, pre, ir->blocks[ pre ].last );
+	ir->hoisted++;
+}
+
+/*
+Loops are taken inner first, so what leaves one may leave the one around it
+as well. What can not fail is moved from anywhere in the loop, memory reads
+included. What may fail
+only from a block run on every turn, and only while nothing before it in the
+loop may fail or show: a store, a call, a return or a loop nested before it
+that might not end. pre is only run when the loop is entered, so it then
+fails where the first turn would have.
+*/
+static void iloops( vvIR *ir )
+{
+	for ( size_t l = 0; l < ir->loopCnt; l++ )
+	{
+		vvIRLoop loop = ir->loops[ l ];
+		size_t lo = ir->blocks[ loop.head ].pos, hi = ir->blocks[ loop.latch ].pos;
+		int clear = 1, calls = 0;
+
+		ir->fillCnt = 0;
+
+		for ( size_t i = lo; i <= hi; i++ )
+		{
+			for ( size_t v = ir->blocks[ ir->layout[ i ] ].first; v != VV_IR_NONE; v = ir->insts[ v ].next )
+			{
+				if ( ir->insts[ v ].op == OP_CALL )
+					calls = 1;
+				if ( ir->insts[ v ].op == OP_STORE )
+					ipush( &ir->fill, &ir->fillCnt, &ir->fillLen, ir->insts[ v ].imm );
+			}
+		}
+
+		for ( size_t i = lo; i <= hi; i++ )
+		{
+			size_t block = ir->layout[ i ];
+			vvIRBlock *blk = &ir->blocks[ block ];
+
+			if ( !blk->live )
+				continue;
+
+			if ( i > lo && blk->predCnt == 2 && ir->blocks[ blk->preds[ 1 ] ].pos >= i )
+				clear = 0;
+
+			int always = idominates( ir, block, loop.latch );
+
+			for ( size_t v = blk->first, next; v != VV_IR_NONE; v = next )
+			{
+				int fault = ir->facts[ v ] & IF_FAULT;
+
+				next = ir->insts[ v ].next;
+
+				if ( iinvariant( ir, v, lo, hi, calls ) && ( !fault || ( clear && always ) ) )
+					ihoist( ir, v, loop.pre, lo, hi );
+				else if ( fault || iisEffect( ir->insts[ v ].op ) )
+					clear = 0;
+			}
+
+			if ( blk->exit == EXIT_RETURN )
+				clear = 0;
+		}
+	}
+}
+
+/*
+What is needed: effects, what may fail, branch conditions and returned
+values, and what those read. The rest goes.
+*/
+static void idead( vvIR *ir )
+{
+	unsigned char *facts = ir->facts;
+
+	ir->fillCnt = 0;
+
+	for ( size_t i = 0; i < ir->layoutCnt; i++ )
+	{
+		vvIRBlock *blk = &ir->blocks[ ir->layout[ i ] ];
+
+		if ( !blk->live )
+			continue;
+
+		for ( size_t v = blk->first; v != VV_IR_NONE; v = ir->insts[ v ].next )
+		{
+			if ( iisEffect( ir->insts[ v ].op ) || ( facts[ v ] & IF_FAULT ) )
+			{
+				facts[ v ] |= IF_NEEDED;
+				ipush( &ir->fill, &ir->fillCnt, &ir->fillLen, v );
+			}
+		}
+
+		if ( blk->val != VV_IR_NONE )
+		{
+			blk->val = vv_irValue( ir, blk->val );
+
+			if ( !( facts[ blk->val ] & IF_NEEDED ) )
+			{
+				facts[ blk->val ] |= IF_NEEDED;
+				ipush( &ir->fill, &ir->fillCnt, &ir->fillLen, blk->val );
+			}
+		}
+	}
+
+	while ( ir->fillCnt )
+	{
+		vvIRInst *inst = &ir->insts[ ir->fill[ --ir->fillCnt ] ];
+
+		for ( size_t k = 0; k < iopCnt( ir, inst ); k++ )
+		{
+			size_t op = vv_irValue( ir, *iop( ir, inst, k ) );
+
+			if ( facts[ op ] & IF_NEEDED )
+				continue;
+
+			facts[ op ] |= IF_NEEDED;
+			ipush( &ir->fill, &ir->fillCnt, &ir->fillLen, op );
+		}
+	}
+
+	for ( size_t i = 0; i < ir->layoutCnt; i++ )
+	{
+		vvIRBlock *blk = &ir->blocks[ ir->layout[ i ] ];
+
+		if ( !blk->live )
+			continue;
+
+		for ( size_t v = blk->first, next; v != VV_IR_NONE; v = next )
+		{
+			next = ir->insts[ v ].next;
+
+			if ( !( facts[ v ] & IF_NEEDED ) )
+				iunlink( ir, v );
+		}
+	}
+}
+
+void vv_irOptimize( vvIR *ir )
+{
+	ivals( ir );
+
+	itrivial( ir );
+	idominate( ir );
+	itypes( ir );
+	icse( ir );
+	iloops( ir );
+	icse( ir );
+	idead( ir );
+}
+
+// a use at position at from block, a value from before a loop the use is in is needed on every turn of it
+static void iuse( vvIR *ir, size_t val, size_t block, size_t at )
+{
+	size_t def = ir->blocks[ ir->insts[ val ].block ].pos;
+
+	for ( size_t l = ir->blocks[ block ].loop; l != VV_IR_NONE; l = ir->blocks[ ir->loops[ l ].pre ].loop )
+	{
+		vvIRLoop *loop = &ir->loops[ l ];
+
+		if ( def >= ir->blocks[ loop->head ].pos && def <= ir->blocks[ loop->latch ].pos )
+			break;
+		if ( ir->ends[ loop->latch ] > at )
+			at = ir->ends[ loop->latch ];
+	}
+
+	if ( at > ir->lasts[ val ] )
+		ir->lasts[ val ] = at;
+}
+
+// whether a value sharing the register of phi would overlap with what else does
+static int iclash( vvIR *ir, size_t phi, size_t val )
+{
+	vvIRBlock *blk = &ir->blocks[ ir->insts[ phi ].block ];
+
+	for ( size_t k = 0; k < blk->predCnt; k++ )
+	{
+		size_t op = ir->insts[ phi ].a, end = ir->ends[ blk->preds[ k ] ];
+
+		if ( k )
+			op = ir->insts[ phi ].b;
+
+		// a move at the end of the predecessor writes the register
+		if ( op != val && ir->cls[ op ] != phi && end > ir->ords[ val ] && end < ir->lasts[ val ] )
+			return 1;
+	}
+
+	for ( size_t k = 0; k <= blk->predCnt; k++ )
+	{
+		size_t other = k == blk->predCnt ? phi : k ? ir->insts[ phi ].b : ir->insts[ phi ].a;
+
+		if ( other == val || ( other != phi && ir->cls[ other ] != phi ) )
+			continue;
+
+		if ( ir->lasts[ other ] > ir->ords[ val ] && ir->lasts[ val ] > ir->ords[ other ] )
+			return 1;
+	}
+
+	return 0;
+}
+
+void vv_irCoalesce( vvIR *ir )
+{
+	size_t n = 0;
+
+	size_t len = ir->endLen;
+
+	ivals( ir );
+	igrow( ( void ** ) &ir->labels, &len, 3 * ir->blockCnt, sizeof( size_t ) );
+	igrow( ( void ** ) &ir->ends, &ir->endLen, 3 * ir->blockCnt, sizeof( size_t ) );
+
+	for ( size_t i = 0; i < ir->layoutCnt; i++ )
+	{
+		size_t block = ir->layout[ i ];
+		vvIRBlock *blk = &ir->blocks[ block ];
+		size_t start = n++;
+
+		if ( !blk->live )
+			continue;
+
+		for ( size_t v = blk->first; v != VV_IR_NONE; v = ir->insts[ v ].next )
+		{
+			for ( size_t k = 0; k < iopCnt( ir, &ir->insts[ v ] ); k++ )
+				*iop( ir, &ir->insts[ v ], k ) = vv_irValue( ir, *iop( ir, &ir->insts[ v ], k ) );
+
+			ir->ords[ v ] = ir->insts[ v ].op == VV_IR_PHI ? start : n++;
+			ir->lasts[ v ] = ir->ords[ v ];
+			ir->cls[ v ] = v;
+			ir->regs[ v ] = VV_IR_NONE;
+		}
+
+		if ( blk->val != VV_IR_NONE )
+			blk->val = vv_irValue( ir, blk->val );
+
+		ir->ends[ block ] = n++;
+	}
+
+	for ( size_t i = 0; i < ir->layoutCnt; i++ )
+	{
+		size_t block = ir->layout[ i ];
+		vvIRBlock *blk = &ir->blocks[ block ];
+
+		if ( !blk->live )
+			continue;
+
+		for ( size_t v = blk->first; v != VV_IR_NONE; v = ir->insts[ v ].next )
+		{
+			vvIRInst *inst = &ir->insts[ v ];
+
+			for ( size_t k = 0; k < iopCnt( ir, inst ); k++ )
+			{
+				if ( inst->op == VV_IR_PHI )
+					iuse( ir, *iop( ir, inst, k ), blk->preds[ k ], ir->ends[ blk->preds[ k ] ] );
+				else
+					iuse( ir, *iop( ir, inst, k ), block, ir->ords[ v ] );
+			}
+		}
+
+		if ( blk->val != VV_IR_NONE )
+			iuse( ir, blk->val, block, ir->ends[ block ] );
+	}
+
+	// operands that end on the edge into the phi, from the loop the edge is in
+	for ( size_t i = 0; i < ir->layoutCnt; i++ )
+	{
+		vvIRBlock *blk = &ir->blocks[ ir->layout[ i ] ];
+
+		if ( !blk->live )
+			continue;
+
+		for ( size_t p = blk->first; p != VV_IR_NONE && ir->insts[ p ].op == VV_IR_PHI; p = ir->insts[ p ].next )
+		{
+			for ( size_t k = 0; k < blk->predCnt; k++ )
+			{
+				size_t pred = blk->preds[ k ], w = k ? ir->insts[ p ].b : ir->insts[ p ].a;
+				vvIRInst *inst = &ir->insts[ w ];
+
+				if ( inst->op == VV_IR_PHI || inst->op == OP_STORE || iisConst( inst->op ) || ir->cls[ w ] != w )
+					continue;
+
+				if ( ir->blocks[ inst->block ].loop != ir->blocks[ pred ].loop || ir->lasts[ w ] > ir->ends[ pred ] )
+					continue;
+
+				if ( !iclash( ir, p, w ) )
+					ir->cls[ w ] = p;
+			}
+		}
+	}
+}
\ No newline at end of file
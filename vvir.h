@@ -0,0 +1,189 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#ifndef VV_IR
+#define VV_IR
+
+#include <stddef.h>
+#include "vvop.h"
+
+// merges what the predecessors of its block hold, an operand per predecessor
+#define VV_IR_PHI ( OP_DIV + 1 )
+#define VV_IR_NONE SIZE_MAX
+
+typedef enum vvIRExit
+{
+	// the end of module code, what is generated next follows it
+	EXIT_FALL,
+	EXIT_GOTO,
+	// to succs[ 0 ] when val holds, to succs[ 1 ] otherwise
+	EXIT_BRANCH,
+	// with val, nil when there is none
+	EXIT_RETURN,
+} vvIRExit;
+
+/*
+A VM opcode on values, the value an instruction makes being the instruction
+itself. a and b are the operands, imm is what is not a value: the constant,
+string, function or memory slot, and the argument count of an OP_CALL whose
+arguments are args[ b ] on. OP_POP takes a parameter, OP_STORE writes a to
+slot imm. Phis keep the variable they merge in imm.
+*/
+typedef struct vvIRInst
+{
+	unsigned op;
+	// VV_IR_NONE once it is taken out
+	size_t block;
+	size_t a, b, imm;
+	size_t info[ 2 ];
+	// neighbours in the block, phis lead
+	size_t prev, next;
+	// the value it turned out to be, itself otherwise
+	size_t repl;
+} vvIRInst;
+
+typedef struct vvIRBlock
+{
+	size_t first, last;
+	size_t preds[ 2 ], succs[ 2 ];
+	unsigned char predCnt, succCnt, exit;
+	// every predecessor is known, control can get here, memory slots are
+	// read anew at its start ( the entry and the blocks after a call )
+	unsigned char sealed, live, reload;
+	// the branch condition or the returned value
+	size_t val;
+	size_t info[ 2 ];
+	// place in the layout and the immediate dominator
+	size_t pos, idom;
+	// innermost loop it is part of
+	size_t loop;
+} vvIRBlock;
+
+// a while loop, laid out from head to latch, pre is only run when the body will be
+typedef struct vvIRLoop
+{
+	size_t pre, head, latch;
+} vvIRLoop;
+
+/*
+Static single assignment form of a function, or of module code, as a graph
+of basic blocks. Variables are looked up the way Braun et al. do: a block
+with one predecessor has the value of that one, a join makes a phi, and a
+loop head gets phis as it is read before its latch is known. A variable is
+( index << 1 ) | 1 for a memory slot and index << 1 for a local. Memory slots
+are stored on every assignment and read again after a call and where
+control joins, so a function sees what the caller assigned and the caller
+what the function did, and they take no phis.
+*/
+typedef struct vvIR
+{
+	vvIRInst *insts;
+	size_t instCnt, instLen;
+	vvIRBlock *blocks;
+	size_t blockCnt, blockLen;
+	size_t *layout;
+	size_t layoutCnt, layoutLen;
+	vvIRLoop *loops;
+	size_t loopCnt, loopLen;
+	size_t *args;
+	size_t argCnt, argLen;
+
+	// the block instructions go to and the position they get
+	size_t cur;
+	size_t row, col;
+
+	// the value of a variable at the end of a block, keyed by both
+	size_t *keys, *vals;
+	unsigned *stamps;
+	size_t mapCnt, mapLen;
+	// entries of another stamp are free
+	unsigned stamp;
+
+	// phis of unsealed blocks, and phis waiting for their operands
+	size_t *open, *fill;
+	size_t openCnt, openLen, fillCnt, fillLen;
+
+	// per instruction: what the passes know of it, position in the layout,
+	// position of the last use, the value whose register it shares, register
+	// once generated
+	unsigned char *facts;
+	size_t *ords, *lasts, *cls, *regs;
+	size_t valLen;
+	// values by what they compute
+	size_t *set;
+	size_t setLen;
+	// per block: position of its end, where its code starts, where the code
+	// for its edges starts when it is not inline ( at 3 * block, 1 and 2 on )
+	size_t *ends, *labels;
+	size_t endLen;
+
+	// what vv_irOptimize did
+	size_t hoisted, merged;
+} vvIR;
+
+vvIR *vv_newIR( );
+// an entry block and nothing else, buffers are kept
+void vv_irReset( vvIR *ir );
+void vv_freeIR( vvIR *ir );
+
+// a block of its own, laid out once it is placed
+size_t vv_irBlock( vvIR *ir );
+// instructions go to block from here on, after the blocks placed before
+void vv_irPlace( vvIR *ir, size_t block );
+// no predecessor is added to block anymore
+void vv_irSeal( vvIR *ir, size_t block );
+// ends the current block
+void vv_irGoto( vvIR *ir, size_t to );
+void vv_irBranch( vvIR *ir, size_t cond, size_t t, size_t f );
+void vv_irReturn( vvIR *ir, size_t val );
+// for a loop from head to the current block
+void vv_irLoop( vvIR *ir, size_t pre, size_t head );
+
+size_t vv_irEmit( vvIR *ir, unsigned op, size_t a, size_t b, size_t imm );
+// continues in a block of its own after the call
+size_t vv_irCall( vvIR *ir, size_t fn, const size_t *args, size_t argc );
+size_t vv_irRead( vvIR *ir, size_t var );
+void vv_irWrite( vvIR *ir, size_t var, size_t val );
+
+/*
+Once every block is sealed: drops the phis merging one value, replaces an
+instruction with an equal one that dominates it, moves what a loop computes
+the same on every turn to before it, and drops values nothing needs. What
+may fail in the VM is only moved where it would have run anyway, before
+anything else the loop does that shows.
+*/
+void vv_irOptimize( vvIR *ir );
+// the value an operand refers to
+size_t vv_irValue( vvIR *ir, size_t val );
+
+/*
+Fills ords, lasts, ends and cls. A phi shares its register with an operand
+that is not needed after the phi takes it, its move is then left out.
+*/
+void vv_irCoalesce( vvIR *ir );
+
+#endif
\ No newline at end of file
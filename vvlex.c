@@ -33,6 +33,7 @@ SOFTWARE.
 #include <assert.h>
 #include <string.h>
 #include "vvcom.h"
+#include "vvscan.h"
 
 static const char *const reservedWords[] = {
 	"?",
@@ -71,36 +72,107 @@ static const char *const reservedWords[] = {
 
 	"KW_START",
 
-	"def",
-	"when",
-	"while",
-	"partial",
-	"return",
-
-	"true",
-	"false",
-	"nil",
+#define VV_KW_STRING( tt, str ) str,
+	VV_KEYWORDS( VV_KW_STRING )
+#undef VV_KW_STRING
 
 	"KW_END",
 };
 
+#define VV_KW_LENGTH( tt, str ) sizeof( str ) - 1,
+static const unsigned char keywordLen[] = { VV_KEYWORDS( VV_KW_LENGTH ) };
+#undef VV_KW_LENGTH
+
+#define VV_KW_COUNT ( TT_KW_END - TT_KW_START - 1 )
+
 const char *vv_tkToString( vvToken tk )
 {
 	return reservedWords[ tk.tt >= TT_NONE && tk.tt <= TT_KW_END ? tk.tt : TT_NONE ];
 }
 
-static unsigned int DJBHash( char *str )
+static unsigned int DJBHash( unsigned int hash, const char *str, size_t len )
+{
+	for ( size_t i = 0; i < len; i++ )
+	{
+		hash = ( ( hash << 5 ) + hash ) + ( unsigned char ) str[ i ];
+	}
+
+	return hash;
+}
+
+// DJB leaves the low bits poorly mixed, and those pick the slot
+static unsigned lmix( unsigned hash )
+{
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3bu;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+static char *larenaAlloc( vvLexArena **arena, size_t len )
 {
-	unsigned int hash = 5381;
+	vvLexArena *blk = *arena;
 
-	while ( *str )
+	if ( blk == NULL || blk->capacity - blk->used < len )
 	{
-		hash = ( ( hash << 5 ) + hash ) + ( *str );
+		size_t cap = len > VV_LEX_ARENA_BLOCK ? len : VV_LEX_ARENA_BLOCK;
+
+		blk = ( vvLexArena * ) malloc( sizeof( vvLexArena ) + cap );
+		assert( blk );
 
-		str++;
+		blk->used = 0;
+		blk->capacity = cap;
+
+		// an oversized string gets its own block behind the current one
+		if ( *arena && cap > VV_LEX_ARENA_BLOCK )
+		{
+			blk->next = ( *arena )->next;
+			( *arena )->next = blk;
+		}
+		else
+		{
+			blk->next = *arena;
+			*arena = blk;
+		}
 	}
 
-	return hash;
+	char *rsl = ( char * ) ( blk + 1 ) + blk->used;
+	blk->used += len;
+
+	return rsl;
+}
+
+static void larenaFree( vvLexArena *arena )
+{
+	while ( arena )
+	{
+		vvLexArena *next = arena->next;
+		free( arena );
+		arena = next;
+	}
+}
+
+static void lslotsResize( vvLexTable *tbl, size_t len )
+{
+	size_t *slots = ( size_t * ) calloc( len, sizeof( size_t ) );
+	assert( slots );
+
+	size_t mask = len - 1;
+
+	for ( size_t i = 0; i < tbl->size; i++ )
+	{
+		size_t pos = tbl->hashSto[ i ] & mask;
+
+		while ( slots[ pos ] )
+			pos = ( pos + 1 ) & mask;
+
+		slots[ pos ] = i + 1;
+	}
+
+	free( tbl->slots );
+	tbl->slots = slots;
+	tbl->slotMask = mask;
 }
 
 vvLexTable *vv_newLexTable( )
@@ -113,28 +185,56 @@ vvLexTable *vv_newLexTable( )
 
 	rsl->sto = ( char ** ) calloc( VV_LEX_TABLE_DEFAULT_LEN, sizeof( char * ) );
 	assert( rsl->sto );
+	rsl->lenSto = ( size_t * ) malloc( VV_LEX_TABLE_DEFAULT_LEN * sizeof( size_t ) );
+	assert( rsl->lenSto );
 	rsl->hashSto = ( unsigned * ) malloc( VV_LEX_TABLE_DEFAULT_LEN * sizeof( unsigned ) );
 	assert( rsl->hashSto );
 
+	rsl->slots = NULL;
+	lslotsResize( rsl, VV_LEX_TABLE_DEFAULT_LEN * 2 );
+
+	rsl->arena = NULL;
+
+	rsl->consts = vv_newConstPool( );
+
+	rsl->stripes = NULL;
+
 	return rsl;
 }
 
-vvString vv_lexTableAdd( vvLexTable *tbl, char *str )
+vvLexTable *vv_newSharedLexTable( )
 {
-	unsigned strHash = DJBHash( str );
+	vvLexTable *rsl = vv_newLexTable( );
 
-	for ( size_t i = 0; i < tbl->size; i++ )
+	rsl->stripes = ( vvLexStripe * ) malloc( VV_LEX_STRIPE_COUNT * sizeof( vvLexStripe ) );
+	assert( rsl->stripes );
+
+	for ( size_t i = 0; i < VV_LEX_STRIPE_COUNT; i++ )
 	{
-		unsigned tblHash = tbl->hashSto[ i ];
-		if ( tblHash == strHash )
-		{
-			return ( vvString ) i;
-		}
+		vvLexStripe *stripe = &rsl->stripes[ i ];
+
+		vv_mutexInit( &stripe->lock );
+
+		stripe->slots = ( vvLexEntry * ) calloc( VV_LEX_STRIPE_DEFAULT_LEN, sizeof( vvLexEntry ) );
+		assert( stripe->slots );
+		stripe->cnt = 0;
+		stripe->slotMask = VV_LEX_STRIPE_DEFAULT_LEN - 1;
+
+		stripe->arena = NULL;
 	}
 
+	vv_mutexInit( &rsl->storeLock );
+	vv_mutexInit( &rsl->constLock );
+
+	return rsl;
+}
+
+// appends an interned string to the id arrays and returns its id
+static vvString ltableStore( vvLexTable *tbl, char *str, size_t len, unsigned hash )
+{
 	if ( tbl->size >= tbl->capacity )
 	{
-		tbl->capacity += VV_LEX_TABLE_STEP;
+		tbl->capacity *= 2;
 
 		void *temp;
 
@@ -142,351 +242,1709 @@ vvString vv_lexTableAdd( vvLexTable *tbl, char *str )
 		assert( temp );
 		tbl->sto = ( char ** ) temp;
 
+		temp = realloc( tbl->lenSto, tbl->capacity * sizeof( size_t ) );
+		assert( temp );
+		tbl->lenSto = ( size_t * ) temp;
+
 		temp = realloc( tbl->hashSto, tbl->capacity * sizeof( unsigned ) );
 		assert( temp );
 		tbl->hashSto = ( unsigned * ) temp;
 	}
 
-	// avoid warning
-	*( tbl->sto + tbl->size ) = str;
-	*( tbl->hashSto + tbl->size ) = strHash;
+	size_t idx = tbl->size++;
+
+	tbl->sto[ idx ] = str;
+	tbl->lenSto[ idx ] = len;
+	tbl->hashSto[ idx ] = hash;
 
-	return tbl->size++;
+	return ( vvString ) idx;
 }
 
-void vv_freeLexTable( vvLexTable *tbl )
+static void lstripeResize( vvLexStripe *stripe, size_t len )
 {
-	for ( size_t i = 0; i < tbl->size; i++ )
+	vvLexEntry *slots = ( vvLexEntry * ) calloc( len, sizeof( vvLexEntry ) );
+	assert( slots );
+
+	size_t mask = len - 1;
+
+	for ( size_t i = 0; i <= stripe->slotMask; i++ )
 	{
-		free( tbl->sto[ i ] );
-	}
+		if ( stripe->slots[ i ].str == NULL )
+			continue;
 
-	free( tbl->sto );
-	free( tbl->hashSto );
+		size_t pos = stripe->slots[ i ].hash & mask;
 
-	free( tbl );
+		while ( slots[ pos ].str )
+			pos = ( pos + 1 ) & mask;
+
+		slots[ pos ] = stripe->slots[ i ];
+	}
+
+	free( stripe->slots );
+	stripe->slots = slots;
+	stripe->slotMask = mask;
 }
 
-vvLexer *vv_newLexer( char *input, char *fn, size_t bufLen, vvLexTable *tbl )
+/*
+Shared table path of ltableIntern. Probing only looks at the entries of the
+stripe, never at the id arrays, so a thread that appends under storeLock
+cannot move anything a lookup in another stripe is reading.
+*/
+static vvString lstripeIntern( vvLexTable *tbl, unsigned strHash, const char *prefix, size_t plen, const char *str, size_t len )
 {
-	vvLexer *rsl = ( vvLexer * ) malloc( sizeof( vvLexer ) );
-	assert( rsl );
+	vvLexStripe *stripe = &tbl->stripes[ strHash >> ( 32 - VV_LEX_STRIPE_BITS ) ];
 
-	rsl->bufIdx = rsl->inputIdx = 0;
-	rsl->fileName = fn;
-	rsl->input = input;
-	rsl->chrBuf = ( char * ) calloc( bufLen, sizeof( char ) );
-	rsl->bufLen = bufLen;
-	rsl->tbl = tbl;
+	vv_mutexLock( &stripe->lock );
 
-	rsl->row = rsl->col = 1;
+	size_t pos = strHash & stripe->slotMask;
 
-	return rsl;
+	for ( ; stripe->slots[ pos ].str; pos = ( pos + 1 ) & stripe->slotMask )
+	{
+		vvLexEntry *e = &stripe->slots[ pos ];
+
+		if ( e->hash == strHash && e->len == plen + len &&
+			 !memcmp( e->str, prefix, plen ) && !memcmp( e->str + plen, str, len ) )
+		{
+			vvString id = e->id;
+
+			vv_mutexUnlock( &stripe->lock );
+
+			return id;
+		}
+	}
+
+	char *dest = larenaAlloc( &stripe->arena, plen + len + 1 );
+	memcpy( dest, prefix, plen );
+	memcpy( dest + plen, str, len );
+	dest[ plen + len ] = '\0';
+
+	vv_mutexLock( &tbl->storeLock );
+	vvString id = ltableStore( tbl, dest, plen + len, strHash );
+	vv_mutexUnlock( &tbl->storeLock );
+
+	stripe->slots[ pos ] = ( vvLexEntry ){ dest, plen + len, strHash, id };
+
+	if ( ++stripe->cnt * 2 > stripe->slotMask + 1 )
+		lstripeResize( stripe, ( stripe->slotMask + 1 ) * 2 );
+
+	vv_mutexUnlock( &stripe->lock );
+
+	return id;
 }
 
-void vv_freeLexer( vvLexer *lex )
+// interns prefix followed by str, the prefix tags strings apart from identifiers
+static vvString ltableIntern( vvLexTable *tbl, const char *prefix, size_t plen, const char *str, size_t len )
 {
-	free( lex->chrBuf );
-	free( lex );
-}
+	unsigned strHash = lmix( DJBHash( DJBHash( 5381, prefix, plen ), str, len ) );
 
-#define lcurr( lex ) ( lex->input[ lex->inputIdx ] )
-#define llookahead( lex ) ( lcurr( lex ) == '\0' ? '\0' : lex->input[ lex->inputIdx + 1 ] )
+	if ( tbl->stripes )
+		return lstripeIntern( tbl, strHash, prefix, plen, str, len );
 
-static char lnext( vvLexer *lex )
-{
-	char cur = lcurr( lex );
+	size_t pos = strHash & tbl->slotMask;
 
-	if ( cur == '\r' || cur == '\n' )
+	for ( size_t slot; ( slot = tbl->slots[ pos ] ); pos = ( pos + 1 ) & tbl->slotMask )
 	{
-		lex->row++;
-		lex->col = 1;
-		char nex = llookahead( lex );
-		if ( ( nex == '\r' || nex == '\n' ) && nex != cur )
-			lex->inputIdx++;
+		size_t i = slot - 1;
+
+		if ( tbl->hashSto[ i ] == strHash && tbl->lenSto[ i ] == plen + len &&
+			 !memcmp( tbl->sto[ i ], prefix, plen ) && !memcmp( tbl->sto[ i ] + plen, str, len ) )
+		{
+			return ( vvString ) i;
+		}
+	}
+
+	char *dest = larenaAlloc( &tbl->arena, plen + len + 1 );
+	memcpy( dest, prefix, plen );
+	memcpy( dest + plen, str, len );
+	dest[ plen + len ] = '\0';
+
+	vvString idx = ltableStore( tbl, dest, plen + len, strHash );
+
+	// keep the load factor at or below 1/2
+	if ( tbl->size * 2 > tbl->slotMask + 1 )
+	{
+		lslotsResize( tbl, ( tbl->slotMask + 1 ) * 2 );
 	}
 	else
 	{
-		lex->col++;
+		tbl->slots[ pos ] = idx + 1;
 	}
 
-	if ( cur != '\0' )
-		lex->inputIdx++;
-
-	return cur;
+	return idx;
 }
 
-static void lwrite( vvLexer *lex, char c )
+vvString vv_lexTableAddLen( vvLexTable *tbl, const char *str, size_t len )
 {
-	if ( lex->bufIdx < lex->bufLen )
-		lex->chrBuf[ lex->bufIdx++ ] = c;
-	else
-		vv_error( "[%s %zd:%zd] Too long content", lex->fileName, lex->row, lex->col );
+	return ltableIntern( tbl, "", 0, str, len );
 }
 
-static vvToken lsave( vvLexer *lex, vvTokenType tt, size_t row, size_t col )
+vvString vv_lexTableAdd( vvLexTable *tbl, const char *str )
 {
-	char *rsl = ( char * ) calloc( lex->bufIdx + 1, sizeof( char ) );
-	assert( rsl );
-
-	for ( size_t i = 0; i < lex->bufIdx; i++ )
-	{
-		rsl[ i ] = lex->chrBuf[ i ];
-	}
+	return vv_lexTableAddLen( tbl, str, strlen( str ) );
+}
 
-	lex->bufIdx = 0;
+void vv_freeLexTable( vvLexTable *tbl )
+{
+	larenaFree( tbl->arena );
 
-	if ( isalpha( *rsl ) )
+	if ( tbl->stripes )
 	{
-		for ( size_t i = TT_KW_START + 1; i < TT_KW_END; i++ )
+		for ( size_t i = 0; i < VV_LEX_STRIPE_COUNT; i++ )
 		{
-			if ( !strcmp( rsl, reservedWords[ i ] ) )
-				return ( vvToken ){
-					.tt = i,
-					.val = 0,
-					.row = row,
-					.col = col,
-				};
+			vv_mutexDestroy( &tbl->stripes[ i ].lock );
+			free( tbl->stripes[ i ].slots );
+			larenaFree( tbl->stripes[ i ].arena );
 		}
+
+		free( tbl->stripes );
+
+		vv_mutexDestroy( &tbl->storeLock );
+		vv_mutexDestroy( &tbl->constLock );
 	}
 
-	size_t presize = lex->tbl->size;
-	vvString str = vv_lexTableAdd( lex->tbl, rsl );
+	free( tbl->sto );
+	free( tbl->lenSto );
+	free( tbl->hashSto );
+	free( tbl->slots );
 
-	if ( presize == lex->tbl->size )
-		free( rsl );
+	vv_freeConstPool( tbl->consts );
 
-	return ( vvToken ){
-		.tt = tt,
-		.val = str,
-		.row = row,
-		.col = col,
-	};
+	free( tbl );
 }
 
-static vvToken readString( vvLexer *lex )
+static size_t lconstHash( vvConst cst )
 {
-	char sign = lnext( lex );
-	lwrite( lex, '$' );
+	uint64_t bits;
 
-	size_t row = lex->row, col = lex->col;
+	if ( cst.ct == CST_FLOAT )
+		memcpy( &bits, &cst.val.float_val, sizeof( bits ) );
+	else
+		bits = ( uint64_t ) cst.val.int_val;
 
-	for ( ;; )
-	{
-		char c = lcurr( lex );
+	bits ^= ( uint64_t ) cst.ct << 63 | cst.ct;
+	bits ^= bits >> 33;
+	bits *= 0xff51afd7ed558ccdull;
+	bits ^= bits >> 33;
 
-		if ( c == sign )
-			break;
-		if ( c == '\0' )
-			vv_error( "[%s EOF] Expected '%c'", lex->fileName, sign );
-		if ( c == '\r' || c == '\n' )
-			vv_error( "[%s %zd:%zd] Unexpected new line", lex->fileName, lex->row, lex->col - 1 );
+	return ( size_t ) bits;
+}
 
-		lwrite( lex, c );
-		lnext( lex );
-	}
+// compares bit patterns, so 0.0 and -0.0 stay apart
+static int lconstSame( vvConst a, vvConst b )
+{
+	if ( a.ct != b.ct )
+		return 0;
 
-	lnext( lex );
-	return lsave( lex, TT_STRING, row, col );
+	if ( a.ct == CST_FLOAT )
+		return !memcmp( &a.val.float_val, &b.val.float_val, sizeof( double ) );
+
+	return a.val.int_val == b.val.int_val;
 }
 
-static vvToken readNumber( vvLexer *lex )
+static void lconstSlotsResize( vvConstPool *pool, size_t len )
 {
-	int meetPoint = 0;
+	size_t *slots = ( size_t * ) calloc( len, sizeof( size_t ) );
+	assert( slots );
 
-	size_t row = lex->row, col = lex->col;
+	size_t mask = len - 1;
 
-	while ( isalnum( lcurr( lex ) ) || lcurr( lex ) == '.' || lcurr( lex ) == '_' )
+	for ( size_t i = 0; i < pool->size; i++ )
 	{
-		if ( lcurr( lex ) == '.' )
-		{
-			if ( meetPoint )
-			{
-				vv_error( "[%s %zd:%zd] Unexpected character '.'", lex->fileName, lex->row, lex->col );
-			}
-			meetPoint = 1;
-		}
-		if ( lcurr( lex ) != '_' )
-			lwrite( lex, lcurr( lex ) );
-		lnext( lex );
+		size_t pos = lconstHash( pool->sto[ i ] ) & mask;
+
+		while ( slots[ pos ] )
+			pos = ( pos + 1 ) & mask;
+
+		slots[ pos ] = i + 1;
 	}
 
-	return lsave( lex, TT_NUMBER, row, col );
+	free( pool->slots );
+	pool->slots = slots;
+	pool->slotMask = mask;
 }
 
-static vvToken readAlpha( vvLexer *lex )
+vvConstPool *vv_newConstPool( )
 {
-	if ( !isalpha( lcurr( lex ) ) )
-		vv_error( "[%s %zd:%zd] Unexpected character '%c'", lex->fileName, lex->row, lex->col, lcurr( lex ) );
+	vvConstPool *rsl = ( vvConstPool * ) malloc( sizeof( vvConstPool ) );
+	assert( rsl );
 
-	size_t row = lex->row, col = lex->col;
+	rsl->size = 0;
+	rsl->capacity = VV_CONST_POOL_DEFAULT_LEN;
+
+	rsl->sto = ( vvConst * ) malloc( VV_CONST_POOL_DEFAULT_LEN * sizeof( vvConst ) );
+	assert( rsl->sto );
+
+	rsl->slots = NULL;
+	lconstSlotsResize( rsl, VV_CONST_POOL_DEFAULT_LEN * 2 );
+
+	return rsl;
+}
 
-	while ( isalpha( lcurr( lex ) ) || lcurr( lex ) == '_' )
+size_t vv_constPoolAdd( vvConstPool *pool, vvConst cst )
+{
+	size_t pos = lconstHash( cst ) & pool->slotMask;
+
+	for ( size_t slot; ( slot = pool->slots[ pos ] ); pos = ( pos + 1 ) & pool->slotMask )
 	{
-		lwrite( lex, lnext( lex ) );
+		if ( lconstSame( pool->sto[ slot - 1 ], cst ) )
+			return slot - 1;
 	}
 
-	return lsave( lex, TT_IDENTIFIER, row, col );
-}
+	if ( pool->size >= pool->capacity )
+	{
+		pool->capacity *= 2;
 
-#define retSingle( op ) \
-	lnext( lex );       \
-	return ( vvToken )  \
-	{                   \
-		.tt = op,       \
-		.val = 0,       \
-		.row = row,     \
-		.col = col,     \
+		vvConst *temp = ( vvConst * ) realloc( pool->sto, pool->capacity * sizeof( vvConst ) );
+		assert( temp );
+		pool->sto = temp;
 	}
 
-#define retTwo( sec, op )                                                           \
-	if ( nex != sec )                                                               \
-		vv_error( "[%s %zd:%zd] Expected '%c'", lex->fileName, row, col + 1, sec ); \
-	lnext( lex ), lnext( lex );                                                     \
-	return ( vvToken ){                                                             \
-		.tt = op,                                                                   \
-		.val = 0,                                                                   \
-		.row = row,                                                                 \
-		.col = col,                                                                 \
-	};
+	size_t idx = pool->size++;
+	pool->sto[ idx ] = cst;
 
-#define retSingleOrTwo( op1, sec, op2 ) \
-	lnext( lex );                       \
-	if ( nex == sec )                   \
-	{                                   \
-		lnext( lex );                   \
-		return ( vvToken ){             \
-			.tt = op2,                  \
-			.val = 0,                   \
-			.row = row,                 \
-			.col = col,                 \
-		};                              \
-	}                                   \
-	return ( vvToken ){                 \
-		.tt = op1,                      \
-		.val = 0,                       \
-		.row = row,                     \
-		.col = col,                     \
-	};
+	if ( pool->size * 2 > pool->slotMask + 1 )
+		lconstSlotsResize( pool, ( pool->slotMask + 1 ) * 2 );
+	else
+		pool->slots[ pos ] = idx + 1;
 
-vvToken vv_lexerRead( vvLexer *lex )
+	return idx;
+}
+
+void vv_freeConstPool( vvConstPool *pool )
 {
-	for ( ;; )
+	free( pool->sto );
+	free( pool->slots );
+
+	free( pool );
+}
+
+// number literals are rarer than names, one lock covers the pool of a shared table
+static size_t lconstAdd( vvLexTable *tbl, vvConst cst )
+{
+	if ( tbl->stripes == NULL )
+		return vv_constPoolAdd( tbl->consts, cst );
+
+	vv_mutexLock( &tbl->constLock );
+	size_t rsl = vv_constPoolAdd( tbl->consts, cst );
+	vv_mutexUnlock( &tbl->constLock );
+
+	return rsl;
+}
+
+size_t vv_lexTableAddConst( vvLexTable *tbl, vvConst cst )
+{
+	return lconstAdd( tbl, cst );
+}
+
+vvConst vv_lexTableGetConst( vvLexTable *tbl, size_t idx )
+{
+	if ( tbl->stripes == NULL )
+		return vv_lexTableConst( tbl, idx );
+
+	vv_mutexLock( &tbl->constLock );
+	vvConst rsl = vv_lexTableConst( tbl, idx );
+	vv_mutexUnlock( &tbl->constLock );
+
+	return rsl;
+}
+
+#define VV_KW_SLOTS 32
+
+#define lkwHash( seed, str, len )                                                                 \
+	( ( ( ( unsigned char ) ( str )[ 0 ] * 31u + ( unsigned char ) ( str )[ ( len ) > 1 ] * 7u +      \
+		  ( unsigned char ) ( str )[ ( len ) - 1 ] * 3u + ( unsigned ) ( len ) ) * ( seed ) >> 7 ) & \
+	  ( VV_KW_SLOTS - 1 ) )
+
+// perfect hash over VV_KEYWORDS, slots hold a token type or TT_NONE. 0 until lkwBuild ran, and if it found none
+static unsigned kwSeed;
+static unsigned char kwSlots[ VV_KW_SLOTS ];
+static vvOnce kwOnce = VV_ONCE_INIT;
+
+// searches a multiplier that sends every keyword to its own slot, once per process
+static void lkwBuild( )
+{
+	for ( unsigned seed = 1; seed < 1u << 16; seed += 2 )
 	{
-		size_t row = lex->row, col = lex->col;
+		memset( kwSlots, TT_NONE, sizeof( kwSlots ) );
 
-		char cur = lcurr( lex ), nex = llookahead( lex );
+		size_t i;
 
-		switch ( cur )
+		for ( i = 0; i < VV_KW_COUNT; i++ )
 		{
-			case '\0':
-				return ( vvToken ){
-					.tt = TT_EOF,
-					.val = 0,
-					.row = row,
-					.col = col,
-				};
-			case '\r':
-			case '\n':
-			case ' ':
-			case '\t':
-				lnext( lex );
-				continue;
-			case '#':
-				if ( llookahead( lex ) == '#' )
-				{
-					for ( ;; )
-					{
-						lnext( lex );
-						cur = lcurr( lex );
-
-						if ( cur == '#' && llookahead( lex ) == '#' )
-						{
-							lnext( lex );
-							lnext( lex );
-							break;
-						}
-						if ( cur == '\0' )
-						{
-							vv_error( "[%s EOF] Expected \"##\"", lex->fileName );
-							break;
-						}
-					}
-				}
-				else
-				{
-					for ( ;; )
-					{
-						lnext( lex );
-						cur = lcurr( lex );
-
-						if ( cur == '\r' || cur == '\n' || cur == '\0' )
-							break;
-					}
-				}
-				continue;
-			case '\'':
-			case '"':
-				return readString( lex );
-			case '0':
-			case '1':
-			case '2':
-			case '3':
-			case '4':
-			case '5':
-			case '6':
-			case '7':
-			case '8':
-			case '9':
-				goto number;
-			case '$':
-				retSingle( TT_MONEY );
-			case '+':
-				retSingle( TT_ADD );
-			case '-':
-				retSingle( TT_MINUS );
-			number:
-				return readNumber( lex );
-			case ':':
-				retSingleOrTwo( TT_COLON, '=', TT_IS );
-			case ';':
-				retSingle( TT_SEMICOLON );
-			case '=':
-				if ( nex == '=' )
-				{
-					lnext( lex );
-					retSingle( TT_EQ );
-				}
-				vv_error( "[%s %zd:%zd] Unexpected character '='", lex->fileName, row, col );
+			const char *kw = reservedWords[ TT_KW_START + 1 + i ];
+			unsigned h = lkwHash( seed, kw, keywordLen[ i ] );
+
+			if ( kwSlots[ h ] != TT_NONE )
 				break;
-			case '!':
-				retSingle( TT_NOT );
-			case '>':
-				retSingleOrTwo( TT_GT, '=', TT_GE );
-			case '<':
-				retSingleOrTwo( TT_LT, '=', TT_LE );
-			case '*':
-				retSingle( TT_MUL );
-			case '/':
-				retSingle( TT_DIV );
-			case '&':
-				retTwo( '&', TT_AND );
-			case '|':
-				retTwo( '|', TT_OR );
-			case ',':
-				retSingle( TT_COMMA );
-			case '(':
-				retSingle( TT_LPAREN );
-			case ')':
-				retSingle( TT_RPAREN );
-			case '{':
-				retSingle( TT_LBRACE );
-			case '}':
-				retSingle( TT_RBRACE );
-			default:
-				return readAlpha( lex );
+
+			kwSlots[ h ] = ( unsigned char ) ( TT_KW_START + 1 + i );
+		}
+
+		if ( i == VV_KW_COUNT )
+		{
+			kwSeed = seed;
+			return;
 		}
 	}
+}
+
+static vvTokenType lkeyword( const char *str, size_t len )
+{
+	if ( len > 255 )
+		return TT_NONE;
+
+	unsigned char tt = kwSlots[ lkwHash( kwSeed, str, len ) ];
 
-	return ( vvToken ){ 0 };
+	if ( tt != TT_NONE && keywordLen[ tt - TT_KW_START - 1 ] == len &&
+		 !memcmp( str, reservedWords[ tt ], len ) )
+		return ( vvTokenType ) tt;
+
+	return TT_NONE;
 }
+
+vvLexer *vv_newLexer( char *input, char *fn, size_t bufLen, vvLexTable *tbl )
+{
+	vv_once( &kwOnce, lkwBuild );
+
+	if ( kwSeed == 0 )
+		vv_error( VV_ERR_INTERNAL, NULL, 0, 0, "No perfect hash for the keyword list, widen VV_KW_SLOTS" );
+
+	vvLexer *rsl = ( vvLexer * ) malloc( sizeof( vvLexer ) );
+	assert( rsl );
+
+	rsl->bufIdx = rsl->inputIdx = 0;
+	rsl->fileName = fn;
+	rsl->input = input;
+	rsl->chrBuf = ( char * ) calloc( bufLen + 1, sizeof( char ) );
+	rsl->bufLen = bufLen;
+	rsl->tbl = tbl;
+
+	rsl->row = rsl->col = 1;
+
+	rsl->refill = NULL;
+	rsl->refillData = NULL;
+	rsl->base = rsl->inputLen = rsl->inputCapacity = 0;
+	rsl->inputEnd = 1;
+
+	return rsl;
+}
+
+vvLexer *vv_newStreamLexer( vvLexRefill refill, void *ud, char *fn, size_t bufLen, vvLexTable *tbl )
+{
+	char *window = ( char * ) calloc( VV_STREAM_WINDOW_DEFAULT_LEN, sizeof( char ) );
+	assert( window );
+
+	vvLexer *rsl = vv_newLexer( window, fn, bufLen, tbl );
+
+	rsl->refill = refill;
+	rsl->refillData = ud;
+	rsl->inputCapacity = VV_STREAM_WINDOW_DEFAULT_LEN;
+	rsl->inputEnd = 0;
+
+	return rsl;
+}
+
+void vv_lexerReset( vvLexer *lex, char *input, char *fn, vvLexTable *tbl )
+{
+	// a stream lexer owns its window, the reset one reads plain input
+	if ( lex->refill )
+		free( lex->input );
+
+	lex->bufIdx = lex->inputIdx = 0;
+	lex->fileName = fn;
+	lex->input = input;
+	lex->tbl = tbl;
+
+	lex->row = lex->col = 1;
+
+	lex->refill = NULL;
+	lex->refillData = NULL;
+	lex->base = lex->inputLen = lex->inputCapacity = 0;
+	lex->inputEnd = 1;
+}
+
+void vv_freeLexer( vvLexer *lex )
+{
+	if ( lex->refill )
+		free( lex->input );
+
+	free( lex->chrBuf );
+	free( lex );
+}
+
+// the scan stopped at the end of the window, not at the end of the stream
+#define lwindowEnd( lex, p ) ( !lex->inputEnd && ( size_t ) ( ( p ) - lex->input ) >= lex->inputLen )
+
+/*
+Drops the window bytes before *keep and reads more of the stream behind the
+rest. Everything indexing the window moves with it, *keep included.
+The window only grows when a single token fills most of it.
+*/
+static int lmore( vvLexer *lex, size_t *keep )
+{
+	size_t shift = *keep;
+
+	memmove( lex->input, lex->input + shift, lex->inputLen - shift );
+	lex->inputLen -= shift;
+	lex->inputIdx -= shift;
+	lex->base += shift;
+	*keep = 0;
+
+	if ( lex->inputLen * 2 >= lex->inputCapacity )
+	{
+		lex->inputCapacity *= 2;
+
+		char *temp = ( char * ) realloc( lex->input, lex->inputCapacity * sizeof( char ) );
+		assert( temp );
+		lex->input = temp;
+	}
+
+	size_t n = lex->refill( lex->refillData, lex->input + lex->inputLen, lex->inputCapacity - 1 - lex->inputLen );
+
+	lex->inputLen += n;
+	lex->input[ lex->inputLen ] = '\0';
+
+	if ( n == 0 )
+		lex->inputEnd = 1;
+
+	return n != 0;
+}
+
+#define lcurr( lex ) ( lex->input[ lex->inputIdx ] )
+#define llookahead( lex ) ( lcurr( lex ) == '\0' ? '\0' : lex->input[ lex->inputIdx + 1 ] )
+
+static char lnext( vvLexer *lex )
+{
+	char cur = lcurr( lex );
+
+	if ( cur == '\r' || cur == '\n' )
+	{
+		lex->row++;
+		lex->col = 1;
+		char nex = llookahead( lex );
+		if ( ( nex == '\r' || nex == '\n' ) && nex != cur )
+			lex->inputIdx++;
+	}
+	else
+	{
+		lex->col++;
+	}
+
+	if ( cur != '\0' )
+		lex->inputIdx++;
+
+	return cur;
+}
+
+// moves to end in one step, row and col follow the line breaks skipped over
+static void lskip( vvLexer *lex, const char *end )
+{
+	const char *cur = lex->input + lex->inputIdx, *line;
+	size_t lines = vv_scanLines( cur, end, &line );
+
+	if ( lines )
+	{
+		lex->row += lines;
+		lex->col = ( size_t ) ( end - line ) + 1;
+	}
+	else
+	{
+		lex->col += ( size_t ) ( end - cur );
+	}
+
+	lex->inputIdx = ( size_t ) ( end - lex->input );
+}
+
+/*
+Where a skip may stop before the window slides. A "\r\n" or "\n\r" pair must
+not be cut in two, nor may a trailing '#' that could open the closing "##".
+*/
+static const char *lsafeCut( vvLexer *lex, const char *end )
+{
+	const char *cut = end;
+
+	while ( cut > lex->input + lex->inputIdx && ( cut[ -1 ] == '\r' || cut[ -1 ] == '\n' ) )
+		cut--;
+
+	if ( cut == end )
+		return cut > lex->input + lex->inputIdx ? cut - 1 : cut;
+
+	// pairs newlines the way vv_scanLines does, a lone last one may pair with the next byte
+	while ( end - cut >= 2 )
+		cut += cut[ 0 ] != cut[ 1 ] ? 2 : 1;
+
+	return cut;
+}
+
+// moves to end over bytes that hold no line break
+#define lskipInline( lex, end )                                   \
+	( lex->col += ( size_t ) ( ( end ) - lex->input ) - lex->inputIdx, \
+	  lex->inputIdx = ( size_t ) ( ( end ) - lex->input ) )
+
+// runs a skipping kernel from input + from across window refills, returns where it stopped
+static const char *lskipRun( vvLexer *lex, const char *( *scan )( const char * ), size_t from )
+{
+	const char *end = scan( lex->input + from );
+
+	while ( lwindowEnd( lex, end ) )
+	{
+		lskip( lex, lsafeCut( lex, end ) );
+
+		size_t keep = lex->inputIdx;
+		lmore( lex, &keep );
+
+		end = scan( lex->input + lex->inputIdx );
+	}
+
+	return end;
+}
+
+// chrBuf is only scratch space, it doubles when a token outgrows it
+static void lwrite( vvLexer *lex, char c )
+{
+	if ( lex->bufIdx >= lex->bufLen )
+	{
+		lex->bufLen = lex->bufLen ? lex->bufLen * 2 : VV_CHAR_BUFFER_DEFAULT_LEN;
+
+		char *temp = ( char * ) realloc( lex->chrBuf, lex->bufLen + 1 );
+		assert( temp );
+		lex->chrBuf = temp;
+	}
+
+	lex->chrBuf[ lex->bufIdx++ ] = c;
+}
+
+// token spelled by the source bytes [ start, inputIdx ), interned without an intermediate copy
+static vvToken lsaveSpan( vvLexer *lex, vvTokenType tt, size_t start, size_t row, size_t col )
+{
+	const char *str = lex->input + start;
+	size_t len = lex->inputIdx - start;
+	vvString val = 0;
+
+	if ( tt == TT_IDENTIFIER )
+	{
+		vvTokenType kw = lkeyword( str, len );
+
+		if ( kw != TT_NONE )
+			tt = kw;
+		else
+			val = vv_lexTableAddLen( lex->tbl, str, len );
+	}
+	else
+	{
+		// skip the quotes, strings are tagged with '$' in the table
+		val = ltableIntern( lex->tbl, "$", 1, str + 1, len - 2 );
+	}
+
+	return ( vvToken ){
+		.tt = tt,
+		.val = val,
+		.row = row,
+		.col = col,
+		.span = { lex->base + start, len },
+	};
+}
+
+// exact powers of ten, a double holds them all without rounding
+static const double lpow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+Decimal to double, correctly rounded. With at most 2^53 as the digits and a
+power of ten up to 1e22, both operands are exact and the single IEEE
+multiply or divide rounds once ( Clinger's fast path ); anything else goes
+to strtod.
+*/
+static double lparseFloat( vvLexer *lex, const char *str, const char *end )
+{
+	uint64_t w = 0;
+	int exp = 0, significant = 0, point = 0;
+
+	for ( const char *c = str; c < end; c++ )
+	{
+		if ( *c == '_' )
+			continue;
+
+		if ( *c == '.' )
+		{
+			point = 1;
+			continue;
+		}
+
+		if ( significant || *c != '0' )
+		{
+			if ( ++significant > 19 )
+				break;
+
+			w = w * 10 + ( uint64_t ) ( *c - '0' );
+		}
+
+		if ( point )
+			exp--;
+	}
+
+	if ( significant <= 19 && w <= ( 1ull << 53 ) && exp >= -22 )
+		return exp ? ( double ) w / lpow10[ -exp ] : ( double ) w;
+
+	// digit separators are dropped on the way into chrBuf
+	for ( const char *c = str; c < end; c++ )
+	{
+		if ( *c != '_' )
+			lwrite( lex, *c );
+	}
+
+	lex->chrBuf[ lex->bufIdx ] = '\0';
+	lex->bufIdx = 0;
+
+	return strtod( lex->chrBuf, NULL );
+}
+
+static vvToken readString( vvLexer *lex )
+{
+	size_t start = lex->inputIdx;
+	size_t row = lex->row, col = lex->col;
+
+	char sign = lnext( lex );
+
+	for ( ;; )
+	{
+		char c = lcurr( lex );
+
+		if ( c == sign )
+			break;
+		if ( c == '\0' && lwindowEnd( lex, lex->input + lex->inputIdx ) )
+		{
+			lmore( lex, &start );
+			continue;
+		}
+		if ( c == '\0' )
+			vv_error( VV_ERR_SYNTAX, lex->fileName, lex->row, lex->col, "Expected '%c' before the end of the input", sign );
+		if ( c == '\r' || c == '\n' )
+			vv_error( VV_ERR_SYNTAX, lex->fileName, lex->row, lex->col - 1, "Unexpected new line" );
+
+		lnext( lex );
+	}
+
+	lnext( lex );
+	return lsaveSpan( lex, TT_STRING, start, row, col );
+}
+
+// the dispatch hands over [ 0-9._ ]+ starting with a digit, the value goes to the constant pool
+static vvToken readNumber( vvLexer *lex, const char *end )
+{
+	size_t start = lex->inputIdx;
+	size_t row = lex->row, col = lex->col;
+
+	const char *str = lex->input + start, *point = NULL;
+	uint64_t v = 0;
+	int wide = 0;
+
+	for ( const char *c = str; c < end; c++ )
+	{
+		if ( *c == '.' )
+		{
+			if ( point )
+				vv_error( VV_ERR_SYNTAX, lex->fileName, row, col + ( c - str ), "Unexpected character '.'" );
+
+			point = c;
+		}
+		else if ( *c != '_' && !point && !wide )
+		{
+			uint64_t d = ( uint64_t ) ( *c - '0' );
+
+			// only an error once the literal turns out to have no '.'
+			if ( v > ( ( uint64_t ) INT64_MAX - d ) / 10 )
+				wide = 1;
+			else
+				v = v * 10 + d;
+		}
+	}
+
+	if ( wide && !point )
+		vv_error( VV_ERR_SYNTAX, lex->fileName, row, col, "Integer literal out of range" );
+
+	vvConst cst;
+
+	if ( point )
+	{
+		cst.ct = CST_FLOAT;
+		cst.val.float_val = lparseFloat( lex, str, end );
+	}
+	else
+	{
+		cst.ct = CST_INT;
+		cst.val.int_val = ( int64_t ) v;
+	}
+
+	lskipInline( lex, end );
+
+	return ( vvToken ){
+		.tt = TT_NUMBER,
+		.val = lconstAdd( lex->tbl, cst ),
+		.row = row,
+		.col = col,
+		.span = { lex->base + start, lex->inputIdx - start },
+	};
+}
+
+// the dispatch hands over [ a-zA-Z_ ]+ starting with a letter
+static vvToken readAlpha( vvLexer *lex, const char *end )
+{
+	size_t start = lex->inputIdx;
+	size_t row = lex->row, col = lex->col;
+
+	lskipInline( lex, end );
+
+	return lsaveSpan( lex, TT_IDENTIFIER, start, row, col );
+}
+
+/*
+Every byte falls into a class, and a state machine over the classes picks
+the token. Operators are recognised by the table alone; whitespace,
+comments and the variable length tokens hand over to their scanners.
+*/
+#define VV_LEX_CLASSES( X, v )                                                   \
+	X( LC_OTHER, v ) X( LC_NUL, v ) X( LC_BLANK, v ) X( LC_BREAK, v ) X( LC_HASH, v ) \
+	X( LC_QUOTE, v ) X( LC_DIGIT, v ) X( LC_ALPHA, v ) X( LC_UNDERSCORE, v )      \
+	X( LC_DOT, v ) X( LC_COLON, v )                                               \
+	X( LC_EQ, v ) X( LC_GT, v ) X( LC_LT, v ) X( LC_BANG, v ) X( LC_AMP, v )      \
+	X( LC_PIPE, v ) X( LC_MONEY, v ) X( LC_ADD, v ) X( LC_MINUS, v )              \
+	X( LC_SEMICOLON, v ) X( LC_MUL, v ) X( LC_DIV, v ) X( LC_COMMA, v )           \
+	X( LC_LPAREN, v ) X( LC_RPAREN, v ) X( LC_LBRACKET, v ) X( LC_RBRACKET, v )   \
+	X( LC_LBRACE, v ) X( LC_RBRACE, v )
+
+#define LC_ENUM( c, v ) c,
+#define LC_ROW( c, at ) [ c ] = at( c ),
+
+typedef enum vvLexClass
+{
+	VV_LEX_CLASSES( LC_ENUM, 0 )
+
+	LC_COUNT
+} vvLexClass;
+
+#define LC_LETTERS( c ) [ c ] = LC_ALPHA, [ c - 'a' + 'A' ] = LC_ALPHA,
+
+static const unsigned char lclass[ 256 ] = {
+	[ '\0' ] = LC_NUL,
+	[ ' ' ] = LC_BLANK, [ '\t' ] = LC_BLANK, [ '\r' ] = LC_BREAK, [ '\n' ] = LC_BREAK,
+	[ '#' ] = LC_HASH,
+	[ '"' ] = LC_QUOTE, [ '\'' ] = LC_QUOTE,
+	[ '0' ] = LC_DIGIT, [ '1' ] = LC_DIGIT, [ '2' ] = LC_DIGIT, [ '3' ] = LC_DIGIT, [ '4' ] = LC_DIGIT,
+	[ '5' ] = LC_DIGIT, [ '6' ] = LC_DIGIT, [ '7' ] = LC_DIGIT, [ '8' ] = LC_DIGIT, [ '9' ] = LC_DIGIT,
+	LC_LETTERS( 'a' ) LC_LETTERS( 'b' ) LC_LETTERS( 'c' ) LC_LETTERS( 'd' ) LC_LETTERS( 'e' )
+	LC_LETTERS( 'f' ) LC_LETTERS( 'g' ) LC_LETTERS( 'h' ) LC_LETTERS( 'i' ) LC_LETTERS( 'j' )
+	LC_LETTERS( 'k' ) LC_LETTERS( 'l' ) LC_LETTERS( 'm' ) LC_LETTERS( 'n' ) LC_LETTERS( 'o' )
+	LC_LETTERS( 'p' ) LC_LETTERS( 'q' ) LC_LETTERS( 'r' ) LC_LETTERS( 's' ) LC_LETTERS( 't' )
+	LC_LETTERS( 'u' ) LC_LETTERS( 'v' ) LC_LETTERS( 'w' ) LC_LETTERS( 'x' ) LC_LETTERS( 'y' )
+	LC_LETTERS( 'z' )
+	[ '_' ] = LC_UNDERSCORE, [ '.' ] = LC_DOT,
+	[ ':' ] = LC_COLON, [ '=' ] = LC_EQ, [ '>' ] = LC_GT, [ '<' ] = LC_LT,
+	[ '!' ] = LC_BANG, [ '&' ] = LC_AMP, [ '|' ] = LC_PIPE, [ '$' ] = LC_MONEY,
+	[ '+' ] = LC_ADD, [ '-' ] = LC_MINUS, [ ';' ] = LC_SEMICOLON, [ '*' ] = LC_MUL,
+	[ '/' ] = LC_DIV, [ ',' ] = LC_COMMA, [ '(' ] = LC_LPAREN, [ ')' ] = LC_RPAREN,
+	[ '[' ] = LC_LBRACKET, [ ']' ] = LC_RBRACKET, [ '{' ] = LC_LBRACE, [ '}' ] = LC_RBRACE,
+};
+
+/*
+A table entry is one of
+	a state below LS_COUNT: take the byte and go on,
+	an action below LA_TOKEN: hand the rest over to the code in vv_lexerRead,
+	LA_TOKEN | tt: the token ends before the byte, LA_TAKE adds the byte to it.
+LA_ERROR is 0, so every pair the table leaves out is an error.
+*/
+enum
+{
+	LA_ERROR = 0,
+
+	LS_START,
+	LS_ALPHA,
+	LS_NUMBER,
+	LS_HASH,
+	LS_COLON,
+	LS_EQ,
+	LS_GT,
+	LS_LT,
+	LS_BANG,
+	LS_AMP,
+	LS_PIPE,
+
+	LS_COUNT,
+
+	LA_EOF = LS_COUNT,
+	LA_SPACE,
+	LA_LINE_COMMENT,
+	LA_BLOCK_COMMENT,
+	LA_STRING,
+	LA_NUMBER,
+	LA_ALPHA,
+
+	// token types stay below 0x40
+	LA_TOKEN = 0x40,
+	LA_TAKE = 0x80,
+};
+
+#define LA_TK( tt ) ( LA_TOKEN | LA_TAKE | ( tt ) )
+
+// the states that end their token on most classes name every entry, so none is written twice
+#define LT_ALPHA( c ) ( ( c ) == LC_ALPHA || ( c ) == LC_UNDERSCORE ? LS_ALPHA : LA_ALPHA )
+#define LT_NUMBER( c ) \
+	( ( c ) == LC_DIGIT || ( c ) == LC_DOT || ( c ) == LC_UNDERSCORE ? LS_NUMBER : ( c ) == LC_ALPHA ? LA_ERROR : LA_NUMBER )
+#define LT_HASH( c ) ( ( c ) == LC_HASH ? LA_BLOCK_COMMENT : LA_LINE_COMMENT )
+
+// a one byte operator, or a two byte one when '=' follows
+#define LT_EQ_OR( c, eq, tt ) ( ( c ) == LC_EQ ? LA_TK( eq ) : LA_TOKEN | ( tt ) )
+#define LT_COLON( c ) LT_EQ_OR( c, TT_IS, TT_COLON )
+#define LT_GT( c ) LT_EQ_OR( c, TT_GE, TT_GT )
+#define LT_LT( c ) LT_EQ_OR( c, TT_LE, TT_LT )
+#define LT_BANG( c ) LT_EQ_OR( c, TT_NEQ, TT_NOT )
+
+static const unsigned char ltrans[ LS_COUNT ][ LC_COUNT ] = {
+	[ LS_START ] = {
+		[ LC_NUL ] = LA_EOF,
+		[ LC_BLANK ] = LS_START,
+		[ LC_BREAK ] = LA_SPACE,
+		[ LC_HASH ] = LS_HASH,
+		[ LC_QUOTE ] = LA_STRING,
+		[ LC_DIGIT ] = LS_NUMBER,
+		[ LC_ALPHA ] = LS_ALPHA,
+		[ LC_COLON ] = LS_COLON,
+		[ LC_EQ ] = LS_EQ,
+		[ LC_GT ] = LS_GT,
+		[ LC_LT ] = LS_LT,
+		[ LC_BANG ] = LS_BANG,
+		[ LC_AMP ] = LS_AMP,
+		[ LC_PIPE ] = LS_PIPE,
+		[ LC_MONEY ] = LA_TK( TT_MONEY ),
+		[ LC_ADD ] = LA_TK( TT_ADD ),
+		[ LC_MINUS ] = LA_TK( TT_MINUS ),
+		[ LC_SEMICOLON ] = LA_TK( TT_SEMICOLON ),
+		[ LC_MUL ] = LA_TK( TT_MUL ),
+		[ LC_DIV ] = LA_TK( TT_DIV ),
+		[ LC_COMMA ] = LA_TK( TT_COMMA ),
+		[ LC_LPAREN ] = LA_TK( TT_LPAREN ),
+		[ LC_RPAREN ] = LA_TK( TT_RPAREN ),
+		[ LC_LBRACKET ] = LA_TK( TT_LBRACKET ),
+		[ LC_RBRACKET ] = LA_TK( TT_RBRACKET ),
+		[ LC_LBRACE ] = LA_TK( TT_LBRACE ),
+		[ LC_RBRACE ] = LA_TK( TT_RBRACE ),
+	},
+	[ LS_ALPHA ] = { VV_LEX_CLASSES( LC_ROW, LT_ALPHA ) },
+	[ LS_NUMBER ] = { VV_LEX_CLASSES( LC_ROW, LT_NUMBER ) },
+	[ LS_HASH ] = { VV_LEX_CLASSES( LC_ROW, LT_HASH ) },
+	[ LS_COLON ] = { VV_LEX_CLASSES( LC_ROW, LT_COLON ) },
+	[ LS_EQ ] = {
+		[ LC_EQ ] = LA_TK( TT_EQ ),
+	},
+	[ LS_GT ] = { VV_LEX_CLASSES( LC_ROW, LT_GT ) },
+	[ LS_LT ] = { VV_LEX_CLASSES( LC_ROW, LT_LT ) },
+	[ LS_BANG ] = { VV_LEX_CLASSES( LC_ROW, LT_BANG ) },
+	[ LS_AMP ] = {
+		[ LC_AMP ] = LA_TK( TT_AND ),
+	},
+	[ LS_PIPE ] = {
+		[ LC_PIPE ] = LA_TK( TT_OR ),
+	},
+};
+
+// the byte a half written operator still needs
+static const char lexpected[ LS_COUNT ] = {
+	[ LS_EQ ] = '=',
+	[ LS_AMP ] = '&',
+	[ LS_PIPE ] = '|',
+};
+
+vvToken vv_lexerRead( vvLexer *lex )
+{
+	for ( ;; )
+	{
+		const unsigned char *p = ( const unsigned char * ) lex->input + lex->inputIdx;
+		const unsigned char *tk = p;
+		unsigned state = LS_START, act;
+
+		for ( ;; )
+		{
+			while ( ( act = ltrans[ state ][ lclass[ *p ] ] ) - 1u < LS_COUNT - 1u )
+			{
+				state = act;
+				p++;
+
+				// blanks loop back to the start state, the token begins after them
+				if ( state == LS_START )
+					tk = p;
+			}
+
+			if ( lex->inputEnd || p < ( const unsigned char * ) lex->input + lex->inputLen )
+				break;
+
+			// the window ended under the scan: keep the token, refill and go on from the same state
+			size_t keep = ( size_t ) ( tk - ( const unsigned char * ) lex->input ), at = ( size_t ) ( p - tk );
+
+			lex->col += keep - lex->inputIdx;
+			lex->inputIdx = keep;
+			lmore( lex, &keep );
+
+			tk = ( const unsigned char * ) lex->input + keep;
+			p = tk + at;
+		}
+
+		size_t start = ( size_t ) ( tk - ( const unsigned char * ) lex->input );
+
+		lex->col += start - lex->inputIdx;
+		lex->inputIdx = start;
+
+		size_t row = lex->row, col = lex->col;
+
+		if ( act & LA_TOKEN )
+		{
+			p += ( act & LA_TAKE ) != 0;
+
+			size_t len = ( size_t ) ( p - tk );
+
+			lex->inputIdx += len;
+			lex->col += len;
+
+			return ( vvToken ){
+				.tt = ( vvTokenType ) ( act & ( LA_TOKEN - 1 ) ),
+				.val = 0,
+				.row = row,
+				.col = col,
+				.span = { lex->base + start, len },
+			};
+		}
+
+		switch ( act )
+		{
+			case LA_EOF:
+				return ( vvToken ){
+					.tt = TT_EOF,
+					.val = 0,
+					.row = row,
+					.col = col,
+					.span = { lex->base + start, 0 },
+				};
+			case LA_SPACE:
+				lskip( lex, lskipRun( lex, vv_scanSpace, start ) );
+				continue;
+			case LA_LINE_COMMENT:
+				lskip( lex, lskipRun( lex, vv_scanLineEnd, start + 1 ) );
+				continue;
+			case LA_BLOCK_COMMENT:
+			{
+				// the second '#' of the opening may already start the closing "##"
+				const char *end = lskipRun( lex, vv_scanBlockEnd, start + 1 );
+
+				if ( *end == '\0' )
+					vv_error( VV_ERR_SYNTAX, lex->fileName, row, col, "Expected \"##\" before the end of the input" );
+
+				lskip( lex, end + 2 );
+				continue;
+			}
+			case LA_STRING:
+				return readString( lex );
+			case LA_NUMBER:
+				return readNumber( lex, ( const char * ) p );
+			case LA_ALPHA:
+				return readAlpha( lex, ( const char * ) p );
+			default:
+				if ( lexpected[ state ] )
+					vv_error( VV_ERR_SYNTAX, lex->fileName, row, col + 1, "Expected '%c'", lexpected[ state ] );
+
+				vv_error( VV_ERR_SYNTAX, lex->fileName, row, col + ( p - tk ), "Unexpected character '%c'", *p );
+				return ( vvToken ){ 0 };
+		}
+	}
+}
+
+vvTokenBuffer *vv_newTokenBuffer( )
+{
+	vvTokenBuffer *rsl = ( vvTokenBuffer * ) malloc( sizeof( vvTokenBuffer ) );
+	assert( rsl );
+
+	rsl->len = rsl->lineCnt = 0;
+	rsl->capacity = rsl->lineCapacity = VV_TOKEN_BUFFER_DEFAULT_LEN;
+
+	rsl->types = ( unsigned char * ) malloc( VV_TOKEN_BUFFER_DEFAULT_LEN * sizeof( unsigned char ) );
+	assert( rsl->types );
+	rsl->ids = ( uint32_t * ) malloc( VV_TOKEN_BUFFER_DEFAULT_LEN * sizeof( uint32_t ) );
+	assert( rsl->ids );
+	rsl->offs = ( uint32_t * ) malloc( VV_TOKEN_BUFFER_DEFAULT_LEN * sizeof( uint32_t ) );
+	assert( rsl->offs );
+
+	rsl->lineRows = ( uint32_t * ) malloc( VV_TOKEN_BUFFER_DEFAULT_LEN * sizeof( uint32_t ) );
+	assert( rsl->lineRows );
+	rsl->lineStarts = ( uint32_t * ) malloc( VV_TOKEN_BUFFER_DEFAULT_LEN * sizeof( uint32_t ) );
+	assert( rsl->lineStarts );
+
+	return rsl;
+}
+
+void vv_freeTokenBuffer( vvTokenBuffer *buf )
+{
+	free( buf->types );
+	free( buf->ids );
+	free( buf->offs );
+	free( buf->lineRows );
+	free( buf->lineStarts );
+
+	free( buf );
+}
+
+void vv_tokenBufferClear( vvTokenBuffer *buf )
+{
+	buf->len = buf->lineCnt = 0;
+}
+
+void vv_tokenBufferPush( vvTokenBuffer *buf, vvToken tk )
+{
+	if ( tk.val > UINT32_MAX || tk.span.off > UINT32_MAX || tk.row > UINT32_MAX )
+		vv_error( VV_ERR_INTERNAL, NULL, tk.row, tk.col, "Input too large for a token buffer" );
+
+	if ( buf->len >= buf->capacity )
+	{
+		buf->capacity *= 2;
+
+		void *temp;
+
+		temp = realloc( buf->types, buf->capacity * sizeof( unsigned char ) );
+		assert( temp );
+		buf->types = ( unsigned char * ) temp;
+
+		temp = realloc( buf->ids, buf->capacity * sizeof( uint32_t ) );
+		assert( temp );
+		buf->ids = ( uint32_t * ) temp;
+
+		temp = realloc( buf->offs, buf->capacity * sizeof( uint32_t ) );
+		assert( temp );
+		buf->offs = ( uint32_t * ) temp;
+	}
+
+	buf->types[ buf->len ] = ( unsigned char ) tk.tt;
+	buf->ids[ buf->len ] = ( uint32_t ) tk.val;
+	buf->offs[ buf->len ] = ( uint32_t ) tk.span.off;
+	buf->len++;
+
+	// first token on a new line records where that line starts
+	if ( buf->lineCnt == 0 || buf->lineRows[ buf->lineCnt - 1 ] != tk.row )
+	{
+		if ( buf->lineCnt >= buf->lineCapacity )
+		{
+			buf->lineCapacity *= 2;
+
+			void *temp;
+
+			temp = realloc( buf->lineRows, buf->lineCapacity * sizeof( uint32_t ) );
+			assert( temp );
+			buf->lineRows = ( uint32_t * ) temp;
+
+			temp = realloc( buf->lineStarts, buf->lineCapacity * sizeof( uint32_t ) );
+			assert( temp );
+			buf->lineStarts = ( uint32_t * ) temp;
+		}
+
+		buf->lineRows[ buf->lineCnt ] = ( uint32_t ) tk.row;
+		buf->lineStarts[ buf->lineCnt ] = ( uint32_t ) ( tk.span.off - ( tk.col - 1 ) );
+		buf->lineCnt++;
+	}
+}
+
+void vv_tokenBufferPos( vvTokenBuffer *buf, size_t idx, size_t *row, size_t *col )
+{
+	uint32_t off = buf->offs[ idx ];
+	size_t lo = 0, hi = buf->lineCnt;
+
+	// last line starting at or before off
+	while ( hi - lo > 1 )
+	{
+		size_t mid = ( lo + hi ) / 2;
+
+		if ( buf->lineStarts[ mid ] <= off )
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	*row = buf->lineRows[ lo ];
+	*col = off - buf->lineStarts[ lo ] + 1;
+}
+
+vvToken vv_tokenBufferGet( vvTokenBuffer *buf, size_t idx )
+{
+	vvToken rsl = {
+		.tt = ( vvTokenType ) buf->types[ idx ],
+		.val = buf->ids[ idx ],
+		.span = { buf->offs[ idx ], 0 },
+	};
+
+	vv_tokenBufferPos( buf, idx, &rsl.row, &rsl.col );
+
+	return rsl;
+}
+
+typedef struct vvLexAll
+{
+	vvLexer *lex;
+	vvTokenBuffer *buf;
+} vvLexAll;
+
+static void lreadAll( void *ud )
+{
+	vvLexAll *all = ( vvLexAll * ) ud;
+	vvToken tk;
+
+	do
+	{
+		tk = vv_lexerRead( all->lex );
+		vv_tokenBufferPush( all->buf, tk );
+	} while ( tk.tt != TT_EOF );
+}
+
+vvResult vv_lexerReadAll( vvLexer *lex, vvTokenBuffer *buf, vvError *err )
+{
+	vvLexAll all = { lex, buf };
+	vvResult rsl = vv_try( err, lreadAll, &all );
+
+	if ( rsl != VV_OK )
+		vv_tokenBufferClear( buf );
+
+	return rsl;
+}
+
+// one piece of the input for vv_lexParallel
+typedef struct vvLexChunk
+{
+	size_t start, len, lines;
+	char *copy;
+
+	// per start state ( outside or inside a block comment ): where the
+	// chunk ends inside a still open block comment, NULL if it does not
+	const char *open[ 2 ];
+
+	int inComment;
+	size_t row;
+
+	// where the block comment the chunk starts in was opened
+	size_t openRow, openCol;
+
+	vvLexTable *tbl;
+	vvTokenBuffer *buf;
+	vvToken eof;
+
+	// lexing runs under vv_try on the worker, the first failed chunk is reported
+	vvLexer *lex;
+	int last;
+	vvResult result;
+	vvError err;
+
+	// chunk ids to tbl ids, for strings and for the constant pool
+	size_t *map, *constMap, at, lineAt;
+} vvLexChunk;
+
+typedef struct vvLexJob
+{
+	const char *input;
+	char *fileName;
+	vvLexChunk *chunks;
+	size_t cnt;
+	vvTokenBuffer *out;
+} vvLexJob;
+
+/*
+Follows only what decides whether a byte is inside a block comment: line
+comments, strings ( which can not span lines ) and "##" pairs. Returns where
+a block comment left open at the end of p starts.
+*/
+static const char *lopenComment( const char *p, int comment )
+{
+	const char *open = p;
+
+	for ( ;; )
+	{
+		if ( comment )
+		{
+			const char *close = vv_scanBlockEnd( p );
+
+			if ( *close == '\0' )
+				return open;
+
+			p = close + 2;
+			comment = 0;
+		}
+
+		p += strcspn( p, "#\"'" );
+
+		if ( *p == '\0' )
+			return NULL;
+
+		if ( *p == '#' )
+		{
+			if ( p[ 1 ] == '#' )
+			{
+				// the second '#' of the opening may already start the closing "##"
+				open = p++;
+				comment = 1;
+			}
+			else
+			{
+				p = vv_scanLineEnd( p + 1 );
+			}
+			continue;
+		}
+
+		char quote = *p++;
+
+		p += strcspn( p, quote == '"' ? "\"\r\n" : "'\r\n" );
+		if ( *p == quote )
+			p++;
+	}
+}
+
+static void lchunkScan( void *ctx, size_t idx )
+{
+	vvLexJob *job = ( vvLexJob * ) ctx;
+	vvLexChunk *ch = &job->chunks[ idx ];
+
+	ch->copy = ( char * ) malloc( ( ch->len + 1 ) * sizeof( char ) );
+	assert( ch->copy );
+
+	memcpy( ch->copy, job->input + ch->start, ch->len );
+	ch->copy[ ch->len ] = '\0';
+
+	const char *line;
+	ch->lines = vv_scanLines( ch->copy, ch->copy + ch->len, &line );
+
+	ch->open[ 0 ] = lopenComment( ch->copy, 0 );
+	ch->open[ 1 ] = lopenComment( ch->copy, 1 );
+}
+
+static void lchunkRead( void *ud )
+{
+	vvLexChunk *ch = ( vvLexChunk * ) ud;
+	vvLexer *lex = ch->lex;
+
+	if ( ch->inComment )
+	{
+		const char *close = vv_scanBlockEnd( ch->copy );
+
+		if ( *close == '\0' && ch->last )
+			vv_error( VV_ERR_SYNTAX, lex->fileName, ch->openRow, ch->openCol, "Expected \"##\" before the end of the input" );
+
+		const char *line, *end = *close ? close + 2 : close;
+		size_t lines = vv_scanLines( ch->copy, end, &line );
+
+		lex->row += lines;
+		lex->col = ( size_t ) ( end - ( lines ? line : ch->copy ) ) + 1;
+		lex->inputIdx = ( size_t ) ( end - ch->copy );
+	}
+
+	for ( ;; )
+	{
+		vvToken tk = vv_lexerRead( lex );
+
+		if ( tk.tt == TT_EOF )
+		{
+			ch->eof = tk;
+			break;
+		}
+
+		vv_tokenBufferPush( ch->buf, tk );
+	}
+}
+
+static void lchunkLex( void *ctx, size_t idx )
+{
+	vvLexJob *job = ( vvLexJob * ) ctx;
+	vvLexChunk *ch = &job->chunks[ idx ];
+
+	ch->last = idx == job->cnt - 1;
+
+	const char *open = ch->open[ ch->inComment ];
+
+	// a comment running into the next chunk is skipped there, only the last chunk may fail on it
+	if ( open && !ch->last )
+		ch->copy[ open - ch->copy ] = '\0';
+
+	ch->lex = vv_newLexer( ch->copy, job->fileName, VV_CHAR_BUFFER_DEFAULT_LEN, ch->tbl );
+	ch->lex->base = ch->start;
+	ch->lex->row = ch->row;
+
+	ch->result = vv_try( &ch->err, lchunkRead, ch );
+
+	vv_freeLexer( ch->lex );
+	free( ch->copy );
+}
+
+static void lchunkMerge( void *ctx, size_t idx )
+{
+	vvLexJob *job = ( vvLexJob * ) ctx;
+	vvLexChunk *ch = &job->chunks[ idx ];
+	vvTokenBuffer *out = job->out;
+
+	memcpy( out->types + ch->at, ch->buf->types, ch->buf->len * sizeof( unsigned char ) );
+	memcpy( out->offs + ch->at, ch->buf->offs, ch->buf->len * sizeof( uint32_t ) );
+
+	for ( size_t i = 0; i < ch->buf->len; i++ )
+	{
+		unsigned char tt = ch->buf->types[ i ];
+		uint32_t id = ch->buf->ids[ i ];
+
+		if ( tt == TT_NUMBER )
+			id = ( uint32_t ) ch->constMap[ id ];
+		else if ( tt == TT_IDENTIFIER || tt == TT_STRING )
+			id = ( uint32_t ) ch->map[ id ];
+
+		out->ids[ ch->at + i ] = id;
+	}
+
+	memcpy( out->lineRows + ch->lineAt, ch->buf->lineRows, ch->buf->lineCnt * sizeof( uint32_t ) );
+	memcpy( out->lineStarts + ch->lineAt, ch->buf->lineStarts, ch->buf->lineCnt * sizeof( uint32_t ) );
+
+	free( ch->map );
+	free( ch->constMap );
+	vv_freeLexTable( ch->tbl );
+	vv_freeTokenBuffer( ch->buf );
+}
+
+// grows buf to hold at least cnt tokens and lineCnt lines
+static void ltokenBufferReserve( vvTokenBuffer *buf, size_t cnt, size_t lineCnt )
+{
+	void *temp;
+
+	if ( cnt > buf->capacity )
+	{
+		buf->capacity = cnt;
+
+		temp = realloc( buf->types, buf->capacity * sizeof( unsigned char ) );
+		assert( temp );
+		buf->types = ( unsigned char * ) temp;
+
+		temp = realloc( buf->ids, buf->capacity * sizeof( uint32_t ) );
+		assert( temp );
+		buf->ids = ( uint32_t * ) temp;
+
+		temp = realloc( buf->offs, buf->capacity * sizeof( uint32_t ) );
+		assert( temp );
+		buf->offs = ( uint32_t * ) temp;
+	}
+
+	if ( lineCnt > buf->lineCapacity )
+	{
+		buf->lineCapacity = lineCnt;
+
+		temp = realloc( buf->lineRows, buf->lineCapacity * sizeof( uint32_t ) );
+		assert( temp );
+		buf->lineRows = ( uint32_t * ) temp;
+
+		temp = realloc( buf->lineStarts, buf->lineCapacity * sizeof( uint32_t ) );
+		assert( temp );
+		buf->lineStarts = ( uint32_t * ) temp;
+	}
+}
+
+/*
+Chunks end right after a line break and never between the two bytes of a
+"\r\n" or "\n\r" pair, so every chunk starts a line. Whether it starts inside
+a block comment is settled before lexing: each chunk is skimmed for both
+possible start states in parallel and the states are chained in order.
+*/
+vvResult vv_lexParallel( vvPool *pool, const char *input, size_t len, char *fn, vvLexTable *tbl, vvTokenBuffer *buf, vvError *err )
+{
+	size_t want = len / VV_LEX_CHUNK_MIN;
+	size_t most = ( pool->size + 1 ) * 4;
+
+	if ( want > most )
+		want = most;
+	if ( want == 0 )
+		want = 1;
+
+	vvLexChunk *chunks = ( vvLexChunk * ) calloc( want, sizeof( vvLexChunk ) );
+	assert( chunks );
+
+	size_t cnt = 0, start = 0;
+
+	while ( start < len || cnt == 0 )
+	{
+		size_t end = cnt == want - 1 ? len : ( len / want ) * ( cnt + 1 );
+
+		if ( end < start )
+			end = start;
+
+		if ( end < len )
+		{
+			// back to the start of the run of breaks, then pair them up the way vv_scanLines does
+			const char *p = input + end + strcspn( input + end, "\r\n" );
+
+			while ( p > input + start && ( p[ -1 ] == '\r' || p[ -1 ] == '\n' ) )
+				p--;
+
+			if ( *p == '\0' )
+				end = len;
+			else
+				end = ( size_t ) ( p - input ) + ( ( p[ 1 ] == '\r' || p[ 1 ] == '\n' ) && p[ 1 ] != p[ 0 ] ? 2 : 1 );
+		}
+
+		chunks[ cnt ].start = start;
+		chunks[ cnt ].len = end - start;
+		cnt++;
+
+		start = end;
+	}
+
+	vvLexJob job = {
+		.input = input,
+		.fileName = fn,
+		.chunks = chunks,
+		.cnt = cnt,
+		.out = buf,
+	};
+
+	vv_poolRun( pool, lchunkScan, &job, cnt );
+
+	size_t row = 1, openRow = 0, openCol = 0;
+	int inComment = 0;
+
+	for ( size_t i = 0; i < cnt; i++ )
+	{
+		vvLexChunk *ch = &chunks[ i ];
+		const char *open = ch->open[ inComment ];
+
+		ch->inComment = inComment;
+		ch->row = row;
+		ch->openRow = openRow;
+		ch->openCol = openCol;
+		ch->tbl = vv_newLexTable( );
+		ch->buf = vv_newTokenBuffer( );
+
+		// a comment left open here and not just carried through is reported where it starts
+		if ( open && !( inComment && open == ch->copy ) )
+		{
+			const char *line;
+			size_t lines = vv_scanLines( ch->copy, open, &line );
+
+			openRow = row + lines;
+			openCol = ( size_t ) ( open - ( lines ? line : ch->copy ) ) + 1;
+		}
+
+		inComment = open != NULL;
+		row += ch->lines;
+	}
+
+	vv_poolRun( pool, lchunkLex, &job, cnt );
+
+	// the serial lexer would have stopped at the first error in the input
+	for ( size_t i = 0; i < cnt; i++ )
+	{
+		if ( chunks[ i ].result == VV_OK )
+			continue;
+
+		*err = chunks[ i ].err;
+
+		for ( size_t j = 0; j < cnt; j++ )
+		{
+			vv_freeLexTable( chunks[ j ].tbl );
+			vv_freeTokenBuffer( chunks[ j ].buf );
+		}
+
+		free( chunks );
+		vv_tokenBufferClear( buf );
+
+		return err->code;
+	}
+
+	// interning in chunk order hands out ids in the order the serial lexer would
+	size_t tokens = 0, lines = 0;
+
+	for ( size_t i = 0; i < cnt; i++ )
+	{
+		vvLexChunk *ch = &chunks[ i ];
+
+		ch->map = ( size_t * ) malloc( ( ch->tbl->size + 1 ) * sizeof( size_t ) );
+		assert( ch->map );
+
+		for ( size_t j = 0; j < ch->tbl->size; j++ )
+			ch->map[ j ] = vv_lexTableAddLen( tbl, vv_lexTableGet( ch->tbl, j ), vv_lexTableLen( ch->tbl, j ) );
+
+		ch->constMap = ( size_t * ) malloc( ( ch->tbl->consts->size + 1 ) * sizeof( size_t ) );
+		assert( ch->constMap );
+
+		for ( size_t j = 0; j < ch->tbl->consts->size; j++ )
+			ch->constMap[ j ] = lconstAdd( tbl, vv_lexTableConst( ch->tbl, j ) );
+
+		ch->at = tokens;
+		ch->lineAt = lines;
+		tokens += ch->buf->len;
+		lines += ch->buf->lineCnt;
+	}
+
+	vv_tokenBufferClear( buf );
+	ltokenBufferReserve( buf, tokens + 1, lines + 1 );
+
+	vv_poolRun( pool, lchunkMerge, &job, cnt );
+
+	buf->len = tokens;
+	buf->lineCnt = lines;
+
+	vv_tokenBufferPush( buf, chunks[ cnt - 1 ].eof );
+
+	free( chunks );
+
+	err->code = VV_OK;
+
+	return VV_OK;
+}
+
+static void rwake( vvTokenRing *ring )
+{
+	vv_mutexLock( &ring->lock );
+	vv_condBroadcast( &ring->cond );
+	vv_mutexUnlock( &ring->lock );
+}
+
+/*
+Hands an index over and wakes the other side if it sleeps. The waiter sets
+its flag before it looks at the index one last time, so either it sees val
+or this sees the flag.
+*/
+static void rpublish( vvTokenRing *ring, volatile size_t *idx, size_t val, volatile size_t *waits )
+{
+	vv_atomicStore( idx, val );
+
+	if ( vv_atomicLoad( waits ) )
+		rwake( ring );
+}
+
+// waits until *idx moves past seen or the ring is freed, returns the last value read
+static size_t rwait( vvTokenRing *ring, volatile size_t *idx, size_t seen, volatile size_t *waits )
+{
+	size_t val;
+
+	for ( int i = 0; i < VV_TOKEN_RING_SPIN; i++ )
+	{
+		if ( ( val = vv_atomicLoad( idx ) ) != seen )
+			return val;
+	}
+
+	vv_mutexLock( &ring->lock );
+	vv_atomicStore( waits, 1 );
+
+	while ( ( val = vv_atomicLoad( idx ) ) == seen && !vv_atomicLoad( &ring->quit ) )
+		vv_condWait( &ring->cond, &ring->lock );
+
+	vv_atomicStore( waits, 0 );
+	vv_mutexUnlock( &ring->lock );
+
+	return val;
+}
+
+static void rlex( void *ud )
+{
+	vvTokenRing *ring = ( vvTokenRing * ) ud;
+
+	for ( ;; )
+	{
+		if ( ring->writeIdx == ring->writeLimit )
+		{
+			rpublish( ring, &ring->tail, ring->writeIdx, &ring->readerWaits );
+			ring->writeLimit = rwait( ring, &ring->head, ring->writeLimit - VV_TOKEN_RING_LEN, &ring->writerWaits ) + VV_TOKEN_RING_LEN;
+
+			if ( vv_atomicLoad( &ring->quit ) )
+				return;
+		}
+
+		vvToken tk = vv_lexerRead( ring->lex );
+		ring->tokens[ ring->writeIdx++ & ( VV_TOKEN_RING_LEN - 1 ) ] = tk;
+
+		if ( tk.tt == TT_EOF )
+		{
+			rpublish( ring, &ring->tail, ring->writeIdx, &ring->readerWaits );
+			return;
+		}
+
+		if ( ring->writeIdx % VV_TOKEN_RING_BATCH == 0 )
+		{
+			rpublish( ring, &ring->tail, ring->writeIdx, &ring->readerWaits );
+
+			// the reader may leave before the end of the input
+			if ( vv_atomicLoad( &ring->quit ) )
+				return;
+		}
+	}
+}
+
+static void rproduce( void *ud )
+{
+	vvTokenRing *ring = ( vvTokenRing * ) ud;
+
+	if ( vv_try( &ring->err, rlex, ring ) == VV_OK )
+		return;
+
+	// a slot is always free while lexing, the failed token never took it
+	vvToken tk = { 0 };
+	tk.tt = TT_NONE;
+
+	ring->tokens[ ring->writeIdx++ & ( VV_TOKEN_RING_LEN - 1 ) ] = tk;
+	rpublish( ring, &ring->tail, ring->writeIdx, &ring->readerWaits );
+}
+
+vvTokenRing *vv_newTokenRing( vvLexer *lex )
+{
+	vvTokenRing *rsl = ( vvTokenRing * ) malloc( sizeof( vvTokenRing ) );
+	assert( rsl );
+
+	rsl->lex = lex;
+
+	rsl->tokens = ( vvToken * ) malloc( VV_TOKEN_RING_LEN * sizeof( vvToken ) );
+	assert( rsl->tokens );
+
+	rsl->head = rsl->tail = 0;
+	rsl->readerWaits = rsl->writerWaits = rsl->quit = 0;
+	rsl->readIdx = rsl->readEnd = 0;
+	rsl->writeIdx = 0;
+	rsl->writeLimit = VV_TOKEN_RING_LEN;
+
+	vv_mutexInit( &rsl->lock );
+	vv_condInit( &rsl->cond );
+
+	vv_threadStart( &rsl->producer, rproduce, rsl );
+
+	return rsl;
+}
+
+vvToken vv_tokenRingRead( vvTokenRing *ring )
+{
+	if ( ring->readIdx == ring->readEnd )
+	{
+		rpublish( ring, &ring->head, ring->readIdx, &ring->writerWaits );
+		ring->readEnd = rwait( ring, &ring->tail, ring->readIdx, &ring->readerWaits );
+	}
+
+	vvToken tk = ring->tokens[ ring->readIdx & ( VV_TOKEN_RING_LEN - 1 ) ];
+
+	// left in place, the producer has stopped behind it
+	if ( tk.tt == TT_EOF )
+		return tk;
+
+	if ( tk.tt == TT_NONE )
+		vv_raise( &ring->err );
+
+	if ( ++ring->readIdx % VV_TOKEN_RING_BATCH == 0 )
+		rpublish( ring, &ring->head, ring->readIdx, &ring->writerWaits );
+
+	return tk;
+}
+
+void vv_freeTokenRing( vvTokenRing *ring )
+{
+	vv_atomicStore( &ring->quit, 1 );
+	rwake( ring );
+
+	vv_threadJoin( ring->producer );
+
+	vv_mutexDestroy( &ring->lock );
+	vv_condDestroy( &ring->cond );
+
+	free( ring->tokens );
+	free( ring );
+}
\ No newline at end of file
@@ -29,6 +29,24 @@ SOFTWARE.
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+
+#include "vvcom.h"
+#include "vvthread.h"
+
+// adding a keyword here is enough, the first lexer of a process searches the keyword hash over this list
+#define VV_KEYWORDS( X )       \
+	X( TT_DEF, "def" )         \
+	X( TT_WHEN, "when" )       \
+	X( TT_WHILE, "while" )     \
+	X( TT_PARTIAL, "partial" ) \
+	X( TT_RETURN, "return" )   \
+                               \
+	X( TT_TRUE, "true" )       \
+	X( TT_FALSE, "false" )     \
+	X( TT_NIL, "nil" )
+
+#define VV_KW_ENUM( tt, str ) tt,
 
 typedef enum vvTokenType
 {
@@ -68,47 +86,145 @@ typedef enum vvTokenType
 
 	TT_KW_START,
 
-	TT_DEF,
-	TT_WHEN,
-	TT_WHILE,
-	TT_PARTIAL,
-	TT_RETURN,
-	
-	TT_TRUE,
-	TT_FALSE,
-	TT_NIL,
+	VV_KEYWORDS( VV_KW_ENUM )
 
 	TT_KW_END
 } vvTokenType;
 
 #define VV_LEX_TABLE_DEFAULT_LEN 16
-#define VV_LEX_TABLE_STEP 2
+#define VV_LEX_ARENA_BLOCK 4096
 
 typedef size_t vvString;
 
+// interned bytes live in a chain of blocks, so pointers stay valid while the table grows
+typedef struct vvLexArena
+{
+	struct vvLexArena *next;
+	size_t used, capacity;
+} vvLexArena;
+
+typedef enum vvConstType
+{
+	CST_INT,
+	CST_FLOAT,
+} vvConstType;
+
+// a number literal, converted once by the lexer
+typedef struct vvConst
+{
+	vvConstType ct;
+
+	union
+	{
+		int64_t int_val;   // INT
+		double float_val;  // FLOAT
+	} val;
+} vvConst;
+
+#define VV_CONST_POOL_DEFAULT_LEN 16
+
+// deduplicated number literals, TT_NUMBER tokens carry an index into it
+typedef struct vvConstPool
+{
+	size_t size, capacity;
+	vvConst *sto;
+
+	// open addressing set of ( idx + 1 ), 0 means empty
+	size_t *slots;
+	size_t slotMask;
+} vvConstPool;
+#define vv_constPoolGet( pool, idx ) ( pool->sto[ idx ] )
+
+vvConstPool *vv_newConstPool( );
+size_t vv_constPoolAdd( vvConstPool *pool, vvConst cst );
+void vv_freeConstPool( vvConstPool *pool );
+
+#define VV_LEX_STRIPE_BITS 4
+#define VV_LEX_STRIPE_COUNT ( 1 << VV_LEX_STRIPE_BITS )
+#define VV_LEX_STRIPE_DEFAULT_LEN 64
+
+// an interned string as a stripe sees it, str is NULL for an empty slot
+typedef struct vvLexEntry
+{
+	const char *str;
+	size_t len;
+	unsigned hash;
+	vvString id;
+} vvLexEntry;
+
+// the strings whose hash falls in one stripe, with their own lock and arena
+typedef struct vvLexStripe
+{
+	vvMutex lock;
+
+	vvLexEntry *slots;
+	size_t cnt, slotMask;
+
+	vvLexArena *arena;
+} vvLexStripe;
+
 typedef struct vvLexTable
 {
 	size_t size, capacity;
 
 	char **sto;
+	size_t *lenSto;
 	unsigned *hashSto;
+
+	// open addressing set of ( id + 1 ), 0 means empty
+	size_t *slots;
+	size_t slotMask;
+
+	vvLexArena *arena;
+
+	vvConstPool *consts;
+
+	/*
+	Shared tables only, NULL otherwise. Lookups and inserts lock the stripe
+	picked by the top bits of the hash, the id arrays above are only touched
+	under storeLock when a new string comes in. They may move meanwhile, so
+	read entries once every thread interning into the table is done.
+	*/
+	vvLexStripe *stripes;
+	vvMutex storeLock, constLock;
 } vvLexTable;
 #define vv_lexTableGet( tbl, idx ) ( tbl->sto[ idx ] )
+#define vv_lexTableLen( tbl, idx ) ( tbl->lenSto[ idx ] )
+#define vv_lexTableConst( tbl, idx ) ( vv_constPoolGet( tbl->consts, idx ) )
 
 vvLexTable *vv_newLexTable( );
-vvString vv_lexTableAdd( vvLexTable *tbl, char *str );
+// a table any number of lexers may intern into at the same time
+vvLexTable *vv_newSharedLexTable( );
+vvString vv_lexTableAdd( vvLexTable *tbl, const char *str );
+vvString vv_lexTableAddLen( vvLexTable *tbl, const char *str, size_t len );
+// index of cst in the constant pool, for numbers made after lexing
+size_t vv_lexTableAddConst( vvLexTable *tbl, vvConst cst );
+// vv_lexTableConst that may run while other threads add constants
+vvConst vv_lexTableGetConst( vvLexTable *tbl, size_t idx );
 void vv_freeLexTable( vvLexTable *tbl );
 
+// a slice of the lexer input: the token as it was written in the source
+typedef struct vvSpan
+{
+	size_t off, len;
+} vvSpan;
+
 typedef struct vvToken
 {
 	vvTokenType tt;
 	vvString val;
 	size_t row, col;
+	vvSpan span;
 } vvToken;
 
 const char *vv_tkToString( vvToken tk );
 
+// initial size of the scratch buffer, tokens of any length are accepted
 #define VV_CHAR_BUFFER_DEFAULT_LEN 31
+#define VV_STREAM_WINDOW_DEFAULT_LEN 65536
+
+// writes at most len bytes of the stream into buf, 0 means the stream ended
+typedef size_t ( *vvLexRefill )( void *ud, char *buf, size_t len );
 
 typedef struct vvLexer
 {
@@ -117,10 +233,102 @@ typedef struct vvLexer
 	char *chrBuf, *fileName;
 
 	vvLexTable *tbl;
+
+	// stream mode: input is a window over the stream, holding inputLen bytes
+	// that start base bytes into it. Spans always count from the stream start
+	vvLexRefill refill;
+	void *refillData;
+	size_t base, inputLen, inputCapacity;
+	int inputEnd;
 } vvLexer;
 
 vvLexer *vv_newLexer( char *input, char *fn, size_t bufLen, vvLexTable *tbl );
+vvLexer *vv_newStreamLexer( vvLexRefill refill, void *ud, char *fn, size_t bufLen, vvLexTable *tbl );
+// starts over on new input, chrBuf and the keyword table are kept
+void vv_lexerReset( vvLexer *lex, char *input, char *fn, vvLexTable *tbl );
 void vv_freeLexer( vvLexer *lex );
 vvToken vv_lexerRead( vvLexer *lex );
 
+#define VV_TOKEN_BUFFER_DEFAULT_LEN 256
+
+/*
+A whole file worth of tokens in parallel arrays, 9 bytes a token.
+Rows and columns are not stored: the line table keeps the start offset of
+every line holding a token, and positions are recovered from it on demand.
+*/
+typedef struct vvTokenBuffer
+{
+	size_t len, capacity;
+
+	unsigned char *types;
+	uint32_t *ids;
+	uint32_t *offs;
+
+	size_t lineCnt, lineCapacity;
+	uint32_t *lineRows;
+	uint32_t *lineStarts;
+} vvTokenBuffer;
+
+vvTokenBuffer *vv_newTokenBuffer( );
+void vv_freeTokenBuffer( vvTokenBuffer *buf );
+void vv_tokenBufferClear( vvTokenBuffer *buf );
+void vv_tokenBufferPush( vvTokenBuffer *buf, vvToken tk );
+void vv_tokenBufferPos( vvTokenBuffer *buf, size_t idx, size_t *row, size_t *col );
+// span.len is not kept and comes back as 0
+vvToken vv_tokenBufferGet( vvTokenBuffer *buf, size_t idx );
+
+// lexes up to and including TT_EOF, buf is left empty on an error
+vvResult vv_lexerReadAll( vvLexer *lex, vvTokenBuffer *buf, vvError *err );
+
+#define VV_LEX_CHUNK_MIN ( 1 << 18 )
+
+/*
+Lexes len bytes of NUL terminated input on the pool into buf, replacing its
+contents. The input is cut into chunks at line starts; the tokens, the
+positions and the ids interned into tbl are exactly what vv_lexerReadAll
+would produce. On an error buf is left empty and err describes the first one
+in the input; names of the chunks before it may already be in tbl.
+*/
+vvResult vv_lexParallel( vvPool *pool, const char *input, size_t len, char *fn, vvLexTable *tbl, vvTokenBuffer *buf, vvError *err );
+
+#define VV_TOKEN_RING_LEN 4096
+#define VV_TOKEN_RING_BATCH 128
+#define VV_TOKEN_RING_SPIN 256
+
+/*
+Runs a lexer on a thread of its own, one token ahead of the reader by up to
+VV_TOKEN_RING_LEN. Each side owns its index and hands it over every
+VV_TOKEN_RING_BATCH tokens and before it waits, so the indices are the only
+shared words on the way; a side finding the ring empty or full spins a
+little and then sleeps on cond until the other one moves.
+*/
+typedef struct vvTokenRing
+{
+	vvLexer *lex;
+	vvThread producer;
+
+	vvToken *tokens;
+
+	// both only grow, the slot is the index modulo VV_TOKEN_RING_LEN
+	volatile size_t head, tail;
+	volatile size_t readerWaits, writerWaits, quit;
+
+	// the reader's view, only touched by the reader
+	size_t readIdx, readEnd;
+
+	// the producer's view, kept here so a lexing error doesn't lose it
+	size_t writeIdx, writeLimit;
+	// read by the reader once it meets the TT_NONE token put after the last good one
+	vvError err;
+
+	vvMutex lock;
+	vvCond cond;
+} vvTokenRing;
+
+// starts lexing lex at once, it is owned by the ring's thread until the ring is freed
+vvTokenRing *vv_newTokenRing( vvLexer *lex );
+// TT_EOF is handed out again once reached, a lexing error is raised again here
+vvToken vv_tokenRingRead( vvTokenRing *ring );
+void vv_freeTokenRing( vvTokenRing *ring );
+
 #endif
\ No newline at end of file
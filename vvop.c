@@ -0,0 +1,106 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "vvop.h"
+
+const unsigned char vv_opOperands[ ][ 3 ] = {
+	[ OP_HALT ] = { OPD_NONE, OPD_NONE, OPD_NONE },
+	[ OP_STORE ] = { OPD_IMM, OPD_USE, OPD_NONE },
+	[ OP_LOAD ] = { OPD_DEF, OPD_IMM, OPD_NONE },
+	[ OP_STOREL ] = { OPD_IMM, OPD_USE, OPD_NONE },
+	[ OP_LOADL ] = { OPD_DEF, OPD_IMM, OPD_NONE },
+	[ OP_MOV ] = { OPD_DEF, OPD_USE, OPD_NONE },
+	[ OP_LOADK ] = { OPD_DEF, OPD_IMM, OPD_NONE },
+	[ OP_LOADS ] = { OPD_DEF, OPD_IMM, OPD_NONE },
+	[ OP_LOADF ] = { OPD_DEF, OPD_IMM, OPD_NONE },
+	[ OP_PUSH ] = { OPD_USE, OPD_NONE, OPD_NONE },
+	[ OP_POP ] = { OPD_DEF, OPD_NONE, OPD_NONE },
+	[ OP_PEEK ] = { OPD_DEF, OPD_NONE, OPD_NONE },
+	[ OP_DUP ] = { OPD_NONE, OPD_NONE, OPD_NONE },
+	[ OP_CALL ] = { OPD_USE, OPD_IMM, OPD_NONE },
+	[ OP_LEAV ] = { OPD_IMM, OPD_NONE, OPD_NONE },
+	[ OP_FRAME ] = { OPD_IMM, OPD_NONE, OPD_NONE },
+	[ OP_JMP ] = { OPD_IMM, OPD_NONE, OPD_NONE },
+	[ OP_JMPT ] = { OPD_IMM, OPD_USE, OPD_NONE },
+	[ OP_JMPF ] = { OPD_IMM, OPD_USE, OPD_NONE },
+	[ OP_NOT ] = { OPD_DEF, OPD_USE, OPD_NONE },
+	[ OP_EQ ] = { OPD_DEF, OPD_USE, OPD_USE },
+	[ OP_NEQ ] = { OPD_DEF, OPD_USE, OPD_USE },
+	[ OP_AND ] = { OPD_DEF, OPD_USE, OPD_USE },
+	[ OP_OR ] = { OPD_DEF, OPD_USE, OPD_USE },
+	[ OP_INV ] = { OPD_DEF, OPD_USE, OPD_NONE },
+	[ OP_GE ] = { OPD_DEF, OPD_USE, OPD_USE },
+	[ OP_GT ] = { OPD_DEF, OPD_USE, OPD_USE },
+	[ OP_LE ] = { OPD_DEF, OPD_USE, OPD_USE },
+	[ OP_LT ] = { OPD_DEF, OPD_USE, OPD_USE },
+	[ OP_ADD ] = { OPD_DEF, OPD_USE, OPD_USE },
+	[ OP_SUB ] = { OPD_DEF, OPD_USE, OPD_USE },
+	[ OP_MUL ] = { OPD_DEF, OPD_USE, OPD_USE },
+	[ OP_DIV ] = { OPD_DEF, OPD_USE, OPD_USE },
+};
+
+const vvValue
+	TRUE_VAL = {
+		.vt = VAL_BOOL,
+		.val.cst_val = 1,
+	},
+	FALSE_VAL = {
+		.vt = VAL_BOOL,
+		.val.cst_val = 0,
+	},
+	NIL_VAL = {
+		.vt = VAL_NIL,
+		.val.cst_val = 0,
+	};
+
+vvValue vv_constValue( vvConst cst )
+{
+	return ( vvValue ){
+		.vt = VAL_NUMBER,
+		.val.num_val = cst.ct == CST_INT ? ( float ) cst.val.int_val : ( float ) cst.val.float_val,
+	};
+}
+
+size_t vv_valueEqual( vvValue *A, vvValue *B )
+{
+	if ( A->vt != B->vt )
+		return 0;
+	// a number only sets the float part of the union
+	if ( A->vt == VAL_NUMBER )
+		return A->val.num_val == B->val.num_val;
+	return A->val.cst_val == B->val.cst_val;
+}
+
+vvValue vv_valueToBool( vvValue *A )
+{
+	size_t rsl = 1;
+
+	if ( A->vt == VAL_NIL || ( A->vt == VAL_BOOL && A->val.cst_val == 0 ) )
+		rsl = 0;
+
+	return ( vvValue ){
+		.vt = VAL_BOOL,
+		.val.cst_val = rsl,
+	};
+}
\ No newline at end of file
@@ -30,6 +30,11 @@ SOFTWARE.
 #include <stdio.h>
 #include <stdint.h>
 
+#include "vvlex.h"
+
+// true, false and nil lead the VAR_CONST section, pool constants follow them
+#define VV_CONST_BUILTINS 3
+
 typedef enum vvOpcode
 {
 	// basic testing commands
@@ -37,7 +42,16 @@ typedef enum vvOpcode
 
 	OP_STORE,
 	OP_LOAD,
+	// local A := B and A := local B, locals are slots of the running call
+	OP_STOREL,
+	OP_LOADL,
 	OP_MOV,
+	// A := constant B of the VAR_CONST section ( true false nil, then the pool )
+	OP_LOADK,
+	// A := string B
+	OP_LOADS,
+	// A := function B
+	OP_LOADF,
 
 	OP_PUSH,
 	OP_POP,
@@ -45,6 +59,8 @@ typedef enum vvOpcode
 	OP_DUP,
 	OP_CALL,
 	OP_LEAV,
+	// the running call has A locals, nil until stored to
+	OP_FRAME,
 	
 	OP_JMP,
 	OP_JMPT,
@@ -69,6 +85,8 @@ typedef enum vvOpcode
 	OP_DIV,
 } vvOpcode;
 
+#define vv_isJump( op ) ( ( op ) == OP_JMP || ( op ) == OP_JMPT || ( op ) == OP_JMPF )
+
 typedef struct vvOpData
 {
 	vvOpcode op;
@@ -76,4 +94,44 @@ typedef struct vvOpData
 	size_t A, B, C;
 } vvOpData;
 
+typedef enum vvOperand
+{
+	OPD_NONE,
+	OPD_DEF,
+	OPD_USE,
+	OPD_IMM,
+} vvOperand;
+
+// what each of A, B and C is to an opcode, registers are OPD_DEF or OPD_USE
+extern const unsigned char vv_opOperands[ ][ 3 ];
+
+// values as the VM holds them, the constant folding of vvopt.c works on them too
+typedef enum vvValueType
+{
+	VAL_NIL,
+	VAL_BOOL,
+	VAL_NUMBER,
+	VAL_STRING,
+	VAL_FUNCTION,
+} vvValueType;
+
+typedef struct vvValue
+{
+	vvValueType vt;
+
+	union
+	{
+		size_t cst_val; // NIL BOOL STRING FUNCTION
+		float num_val;	// NUMBER
+	} val;
+} vvValue;
+
+extern const vvValue TRUE_VAL, FALSE_VAL, NIL_VAL;
+
+// runtime value of a constant pool entry
+vvValue vv_constValue( vvConst cst );
+// what OP_EQ and the conditional jumps make of values
+size_t vv_valueEqual( vvValue *A, vvValue *B );
+vvValue vv_valueToBool( vvValue *A );
+
 #endif
\ No newline at end of file
@@ -0,0 +1,679 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "vvopt.h"
+#include "vvvm.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+// a literal operand, vt tells which; strings only count for their truth
+static int oliteral( vvLexTable *tbl, vvSyntaxContainer *syn, vvValue *val )
+{
+	if ( syn == NULL || syn->st != ST_PRIMARY )
+		return 0;
+
+	memset( val, 0, sizeof( vvValue ) );
+
+	switch ( syn->attr.tk.tt )
+	{
+		case TT_NUMBER:
+			*val = vv_constValue( vv_lexTableGetConst( tbl, syn->attr.tk.val ) );
+			return 1;
+		case TT_STRING:
+			val->vt = VAL_STRING;
+			return 1;
+		case TT_TRUE:
+			*val = TRUE_VAL;
+			return 1;
+		case TT_FALSE:
+			*val = FALSE_VAL;
+			return 1;
+		case TT_NIL:
+			*val = NIL_VAL;
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+static int onumber( vvLexTable *tbl, vvSyntaxContainer *syn, float *num )
+{
+	vvValue val;
+
+	if ( !oliteral( tbl, syn, &val ) || val.vt != VAL_NUMBER )
+		return 0;
+
+	*num = val.val.num_val;
+
+	return 1;
+}
+
+// the VM makes a number of these or fails
+static int oisNumber( vvLexTable *tbl, vvSyntaxContainer *syn )
+{
+	float num;
+
+	switch ( syn->st )
+	{
+		case ST_ADD_EXPR:
+		case ST_SUB_EXPR:
+		case ST_MUL_EXPR:
+		case ST_DIV_EXPR:
+		case ST_INV_EXPR:
+			return 1;
+		default:
+			return onumber( tbl, syn, &num );
+	}
+}
+
+// the VM makes a bool of these
+static int oisBool( vvSyntaxContainer *syn )
+{
+	switch ( syn->st )
+	{
+		case ST_EQ_EXPR:
+		case ST_NEQ_EXPR:
+		case ST_GE_EXPR:
+		case ST_GT_EXPR:
+		case ST_LE_EXPR:
+		case ST_LT_EXPR:
+		case ST_AND_EXPR:
+		case ST_OR_EXPR:
+		case ST_NOT_EXPR:
+			return 1;
+		case ST_PRIMARY:
+			return syn->attr.tk.tt == TT_TRUE || syn->attr.tk.tt == TT_FALSE;
+		default:
+			return 0;
+	}
+}
+
+// a single load, evaluating it or not makes no difference
+static int oisPure( vvSyntaxContainer *syn )
+{
+	return syn->st == ST_PRIMARY;
+}
+
+// syn takes the place of rsl, which stays linked to its siblings
+static void oreplace( vvSyntaxContainer *rsl, vvSyntaxContainer *syn )
+{
+	vvSyntaxContainer *next = rsl->next;
+
+	*rsl = *syn;
+	rsl->next = next;
+}
+
+// turns rsl into a literal spanning from the first token of first to the last of last
+static void oliteralSet( vvSyntaxContainer *rsl, vvTokenType tt, vvString val, vvSyntaxContainer *first, vvSyntaxContainer *last )
+{
+	vvToken tk = first->attr.tk;
+	vvSpan end = last->attr.tk.span;
+
+	tk.tt = tt;
+	tk.val = val;
+	tk.span.len = end.off + end.len - tk.span.off;
+
+	rsl->st = ST_PRIMARY;
+	rsl->attr.tk = tk;
+	rsl->children[ 0 ] = rsl->children[ 1 ] = rsl->children[ 2 ] = NULL;
+}
+
+static void oboolSet( vvSyntaxContainer *rsl, int val, vvSyntaxContainer *first, vvSyntaxContainer *last )
+{
+	oliteralSet( rsl, val ? TT_TRUE : TT_FALSE, 0, first, last );
+}
+
+static void onumberSet( vvSyntaxContainer *rsl, vvLexTable *tbl, float num, vvSyntaxContainer *first, vvSyntaxContainer *last )
+{
+	vvConst cst;
+
+	// whole numbers go in as ints, like the literals they may equal; -0 keeps its sign as a float
+	if ( num == truncf( num ) && fabsf( num ) < 9.0e18f && !( num == 0 && signbit( num ) ) )
+	{
+		cst.ct = CST_INT;
+		cst.val.int_val = ( int64_t ) num;
+	}
+	else
+	{
+		cst.ct = CST_FLOAT;
+		cst.val.float_val = num;
+	}
+
+	oliteralSet( rsl, TT_NUMBER, vv_lexTableAddConst( tbl, cst ), first, last );
+}
+
+static void ounary( vvSyntaxContainer *rsl, vvLexTable *tbl )
+{
+	vvSyntaxContainer *arg = rsl->children[ 0 ];
+	vvValue val;
+	float num;
+
+	if ( rsl->st == ST_NOT_EXPR )
+	{
+		if ( oliteral( tbl, arg, &val ) )
+			oboolSet( rsl, !vv_valueToBool( &val ).val.cst_val, rsl, arg );
+		// !!x is x when x is a bool already
+		else if ( arg->st == ST_NOT_EXPR && oisBool( arg->children[ 0 ] ) )
+			oreplace( rsl, arg->children[ 0 ] );
+	}
+	else
+	{
+		if ( onumber( tbl, arg, &num ) )
+			onumberSet( rsl, tbl, -num, rsl, arg );
+		else if ( arg->st == ST_INV_EXPR && oisNumber( tbl, arg->children[ 0 ] ) )
+			oreplace( rsl, arg->children[ 0 ] );
+	}
+}
+
+/*
+x - 0, x * 1, 1 * x and x / 1 reduced to x, the identities exact in float.
+x + 0 is not one of them, it turns -0 into 0.
+*/
+static void oidentity( vvSyntaxContainer *rsl, vvLexTable *tbl, vvSyntaxContainer *lhs, vvSyntaxContainer *rhs )
+{
+	float l = 0, r = 0;
+	int lk = onumber( tbl, lhs, &l ), rk = onumber( tbl, rhs, &r );
+
+	if ( rsl->st == ST_SUB_EXPR && rk && r == 0 && oisNumber( tbl, lhs ) )
+		oreplace( rsl, lhs );
+	else if ( ( rsl->st == ST_MUL_EXPR || rsl->st == ST_DIV_EXPR ) && rk && r == 1 && oisNumber( tbl, lhs ) )
+		oreplace( rsl, lhs );
+	else if ( rsl->st == ST_MUL_EXPR && lk && l == 1 && oisNumber( tbl, rhs ) )
+		oreplace( rsl, rhs );
+}
+
+static void obinary( vvSyntaxContainer *rsl, vvLexTable *tbl )
+{
+	vvSyntaxContainer *lhs = rsl->children[ 0 ], *rhs = rsl->children[ 1 ];
+	vvValue lv, rv;
+	int lk = oliteral( tbl, lhs, &lv ), rk = oliteral( tbl, rhs, &rv );
+
+	if ( rsl->st == ST_AND_EXPR || rsl->st == ST_OR_EXPR )
+	{
+		int stop = rsl->st == ST_OR_EXPR;
+
+		// both sides are always evaluated, the other one may only be dropped when it is a plain load
+		if ( lk && rk )
+			oboolSet( rsl, stop ? vv_valueToBool( &lv ).val.cst_val || vv_valueToBool( &rv ).val.cst_val
+								: vv_valueToBool( &lv ).val.cst_val && vv_valueToBool( &rv ).val.cst_val,
+					  lhs, rhs );
+		else if ( ( lk && ( int ) vv_valueToBool( &lv ).val.cst_val == stop && oisPure( rhs ) ) ||
+				  ( rk && ( int ) vv_valueToBool( &rv ).val.cst_val == stop && oisPure( lhs ) ) )
+			oboolSet( rsl, stop, lhs, rhs );
+
+		return;
+	}
+
+	if ( rsl->st == ST_EQ_EXPR || rsl->st == ST_NEQ_EXPR )
+	{
+		// strings compare by what they hold at run time; NaN compares by its bits there
+		if ( !lk || !rk || lv.vt == VAL_STRING || rv.vt == VAL_STRING ||
+			 ( lv.vt == VAL_NUMBER && isnan( lv.val.num_val ) ) || ( rv.vt == VAL_NUMBER && isnan( rv.val.num_val ) ) )
+			return;
+
+		size_t eq = vv_valueEqual( &lv, &rv );
+		oboolSet( rsl, rsl->st == ST_EQ_EXPR ? eq : !eq, lhs, rhs );
+
+		return;
+	}
+
+	if ( !lk || !rk || lv.vt != VAL_NUMBER || rv.vt != VAL_NUMBER )
+	{
+		oidentity( rsl, tbl, lhs, rhs );
+		return;
+	}
+
+	float l = lv.val.num_val, r = rv.val.num_val;
+
+	switch ( rsl->st )
+	{
+		case ST_ADD_EXPR:
+			onumberSet( rsl, tbl, ( float ) ( l + r ), lhs, rhs );
+			break;
+		case ST_SUB_EXPR:
+			onumberSet( rsl, tbl, ( float ) ( l - r ), lhs, rhs );
+			break;
+		case ST_MUL_EXPR:
+			onumberSet( rsl, tbl, ( float ) ( l * r ), lhs, rhs );
+			break;
+		case ST_DIV_EXPR:
+			// left for the VM to fail on
+			if ( r != 0. )
+				onumberSet( rsl, tbl, ( float ) ( l / r ), lhs, rhs );
+			break;
+		case ST_GE_EXPR:
+			oboolSet( rsl, l >= r, lhs, rhs );
+			break;
+		case ST_GT_EXPR:
+			oboolSet( rsl, l > r, lhs, rhs );
+			break;
+		case ST_LE_EXPR:
+			oboolSet( rsl, l <= r, lhs, rhs );
+			break;
+		case ST_LT_EXPR:
+			oboolSet( rsl, l < r, lhs, rhs );
+			break;
+		default:
+			break;
+	}
+}
+
+// a branch known before running takes the place of the statement, an empty block if there is none
+static void obranch( vvSyntaxContainer *rsl, vvLexTable *tbl )
+{
+	vvValue val;
+
+	if ( !oliteral( tbl, rsl->children[ 0 ], &val ) )
+		return;
+
+	int taken = ( int ) vv_valueToBool( &val ).val.cst_val;
+	vvSyntaxContainer *block;
+
+	if ( rsl->st == ST_WHEN_STMT )
+		block = taken ? rsl->children[ 1 ] : rsl->children[ 2 ];
+	else if ( !taken )
+		block = NULL;
+	else
+		return;
+
+	if ( block )
+	{
+		oreplace( rsl, block );
+		return;
+	}
+
+	rsl->st = ST_BLOCK;
+	rsl->children[ 0 ] = rsl->children[ 1 ] = rsl->children[ 2 ] = NULL;
+}
+
+static void ofold( vvSyntaxContainer *rsl, vvLexTable *tbl )
+{
+	switch ( rsl->st )
+	{
+		case ST_NOT_EXPR:
+		case ST_INV_EXPR:
+			ounary( rsl, tbl );
+			break;
+		case ST_EQ_EXPR:
+		case ST_NEQ_EXPR:
+		case ST_GE_EXPR:
+		case ST_GT_EXPR:
+		case ST_LE_EXPR:
+		case ST_LT_EXPR:
+		case ST_ADD_EXPR:
+		case ST_SUB_EXPR:
+		case ST_MUL_EXPR:
+		case ST_DIV_EXPR:
+		case ST_AND_EXPR:
+		case ST_OR_EXPR:
+			obinary( rsl, tbl );
+			break;
+		case ST_WHEN_STMT:
+		case ST_WHILE_STMT:
+			obranch( rsl, tbl );
+			break;
+		default:
+			break;
+	}
+}
+
+typedef struct vvFoldFrame
+{
+	vvSyntaxContainer *syn;
+	int done;
+} vvFoldFrame;
+
+void vv_optimizeStatement( vvSyntaxContainer *stmt, vvLexTable *tbl )
+{
+	if ( stmt == NULL )
+		return;
+
+	// children are folded before their parent, on a stack that moves to the heap for deep trees
+	vvFoldFrame local[ VV_PARSER_FRAMES_DEFAULT_LEN ];
+	size_t cnt = 0, capacity = VV_PARSER_FRAMES_DEFAULT_LEN;
+	vvFoldFrame *stack = local;
+
+	stack[ cnt++ ] = ( vvFoldFrame ){ stmt, 0 };
+
+	while ( cnt )
+	{
+		vvFoldFrame f = stack[ --cnt ];
+
+		if ( f.done )
+		{
+			ofold( f.syn, tbl );
+			continue;
+		}
+
+		if ( cnt + VV_PARSER_MAX_CHILDREN + 2 > capacity )
+		{
+			capacity *= 2;
+
+			vvFoldFrame *temp = ( vvFoldFrame * ) realloc( stack == local ? NULL : stack, capacity * sizeof( vvFoldFrame ) );
+			assert( temp );
+
+			if ( stack == local )
+				memcpy( temp, local, cnt * sizeof( vvFoldFrame ) );
+
+			stack = temp;
+		}
+
+		// the siblings of a child are in the same position, they are folded on their own
+		if ( f.syn->next && f.syn != stmt )
+			stack[ cnt++ ] = ( vvFoldFrame ){ f.syn->next, 0 };
+
+		stack[ cnt++ ] = ( vvFoldFrame ){ f.syn, 1 };
+
+		for ( int i = 0; i < VV_PARSER_MAX_CHILDREN; i++ )
+			if ( f.syn->children[ i ] )
+				stack[ cnt++ ] = ( vvFoldFrame ){ f.syn->children[ i ], 0 };
+	}
+
+	if ( stack != local )
+		free( stack );
+}
+
+// what a peephole round knows of an instruction, in the first len words of work
+#define OPT_KEEP 1u
+#define OPT_LABEL 2u
+
+#define oregBit( r ) ( ( size_t ) 1 << ( r ) )
+// a slot of memory or of the frame, as a register remembers having loaded it
+#define oslotKey( op, slot ) ( ( ( slot ) << 1 | ( ( op ) == OP_LOADL || ( op ) == OP_STOREL ) ) + 1 )
+#define OPT_NO_SLOT 0
+
+// where a jump ends up once the jumps it lands on are followed
+static size_t othread( vvOpData *code, size_t len, size_t at )
+{
+	// a chain going around forever is left as it is
+	for ( size_t n = 0; n < len && code[ at ].op == OP_JMP; n++ )
+		at = code[ at ].A;
+
+	return at;
+}
+
+// the instructions control can get to are kept, and the ones jumped to are labels
+static void oreach( vvOpData *code, size_t len, size_t *flags, size_t *stack )
+{
+	size_t cnt = 0;
+
+	memset( flags, 0, len * sizeof( size_t ) );
+	flags[ 0 ] = OPT_KEEP | OPT_LABEL;
+	stack[ cnt++ ] = 0;
+
+	while ( cnt )
+	{
+		size_t i = stack[ --cnt ];
+		vvOpcode op = code[ i ].op;
+		size_t next[ 2 ], n = 0;
+
+		if ( vv_isJump( op ) )
+		{
+			assert( code[ i ].A < len );
+			flags[ code[ i ].A ] |= OPT_LABEL;
+			next[ n++ ] = code[ i ].A;
+		}
+
+		if ( op != OP_JMP && op != OP_HALT && op != OP_LEAV && i + 1 < len )
+			next[ n++ ] = i + 1;
+
+		for ( size_t k = 0; k < n; k++ )
+		{
+			if ( flags[ next[ k ] ] & OPT_KEEP )
+				continue;
+
+			flags[ next[ k ] ] |= OPT_KEEP;
+			stack[ cnt++ ] = next[ k ];
+		}
+	}
+}
+
+/*
+One pass down each run of code no label splits. A load of a slot some
+register still holds is a move from it, moves are followed back to the
+register they copy so the move itself may go dead, and a move of a register
+to itself or a PUSH right before a POP goes away. A CALL runs code that
+changes the registers and memory, nothing is known after it.
+*/
+static void oforward( vvOpData *code, size_t len, size_t *flags )
+{
+	size_t holds[ VV_REGISTER_COUNT ], copy[ VV_REGISTER_COUNT ];
+	int fresh = 1;
+
+	for ( size_t i = 0; i < len; i++ )
+	{
+		vvOpData *inst = &code[ i ];
+		size_t *ops[ 3 ] = { &inst->A, &inst->B, &inst->C };
+
+		if ( !( flags[ i ] & OPT_KEEP ) )
+			continue;
+
+		if ( fresh || flags[ i ] & OPT_LABEL )
+		{
+			for ( int r = 0; r < VV_REGISTER_COUNT; r++ )
+				holds[ r ] = OPT_NO_SLOT, copy[ r ] = r;
+			fresh = 0;
+		}
+
+		for ( int k = 0; k < 3; k++ )
+			if ( vv_opOperands[ inst->op ][ k ] == OPD_USE )
+				*ops[ k ] = copy[ *ops[ k ] ];
+
+		if ( inst->op == OP_LOAD || inst->op == OP_LOADL )
+		{
+			size_t key = oslotKey( inst->op, inst->B );
+
+			for ( int r = 0; r < VV_REGISTER_COUNT; r++ )
+			{
+				if ( holds[ r ] == key )
+				{
+					inst->op = OP_MOV;
+					inst->B = copy[ r ];
+					break;
+				}
+			}
+		}
+		else if ( inst->op == OP_POP && i && ( flags[ i - 1 ] & OPT_KEEP ) && code[ i - 1 ].op == OP_PUSH &&
+				  !( flags[ i ] & OPT_LABEL ) )
+		{
+			flags[ i - 1 ] &= ~OPT_KEEP;
+			inst->op = OP_MOV;
+			inst->B = code[ i - 1 ].A;
+		}
+
+		if ( inst->op == OP_MOV && inst->A == inst->B )
+		{
+			flags[ i ] &= ~OPT_KEEP;
+			continue;
+		}
+
+		if ( inst->op == OP_STORE || inst->op == OP_STOREL )
+		{
+			size_t key = oslotKey( inst->op, inst->A );
+
+			for ( int r = 0; r < VV_REGISTER_COUNT; r++ )
+				if ( holds[ r ] == key )
+					holds[ r ] = OPT_NO_SLOT;
+
+			holds[ inst->B ] = key;
+		}
+
+		for ( int k = 0; k < 3; k++ )
+		{
+			if ( vv_opOperands[ inst->op ][ k ] != OPD_DEF )
+				continue;
+
+			size_t d = *ops[ k ];
+
+			for ( int r = 0; r < VV_REGISTER_COUNT; r++ )
+				if ( copy[ r ] == d )
+					copy[ r ] = r;
+
+			holds[ d ] = OPT_NO_SLOT;
+			copy[ d ] = d;
+
+			if ( inst->op == OP_MOV )
+			{
+				holds[ d ] = holds[ inst->B ];
+				copy[ d ] = inst->B;
+			}
+			else if ( inst->op == OP_LOAD || inst->op == OP_LOADL )
+				holds[ d ] = oslotKey( inst->op, inst->B );
+		}
+
+		fresh = inst->op == OP_CALL || inst->op == OP_JMP || inst->op == OP_HALT || inst->op == OP_LEAV;
+	}
+}
+
+// only put a value in a register, nothing is lost when it is never read
+static int oisPureDef( vvOpcode op )
+{
+	switch ( op )
+	{
+		case OP_LOAD:
+		case OP_LOADL:
+		case OP_MOV:
+		case OP_LOADK:
+		case OP_LOADS:
+		case OP_LOADF:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+// registers read after instruction i, from the ones read before each instruction in live
+static size_t oliveOut( vvOpData *code, size_t len, size_t *live, size_t i )
+{
+	vvOpcode op = code[ i ].op;
+	size_t rsl = 0;
+
+	if ( vv_isJump( op ) )
+		rsl |= live[ code[ i ].A ];
+	if ( op != OP_JMP && op != OP_HALT && op != OP_LEAV && i + 1 < len )
+		rsl |= live[ i + 1 ];
+
+	return rsl;
+}
+
+// drops the pure instructions whose register is not read before it is set again
+static void odead( vvOpData *code, size_t len, size_t *flags, size_t *live )
+{
+	int changed = 1;
+
+	memset( live, 0, len * sizeof( size_t ) );
+
+	// backwards, so a loop takes a pass or two more than its nesting
+	while ( changed )
+	{
+		changed = 0;
+
+		for ( size_t i = len; i-- > 0; )
+		{
+			vvOpData *inst = &code[ i ];
+			size_t ops[ 3 ] = { inst->A, inst->B, inst->C };
+			size_t in = oliveOut( code, len, live, i );
+
+			if ( flags[ i ] & OPT_KEEP )
+			{
+				for ( int k = 0; k < 3; k++ )
+					if ( vv_opOperands[ inst->op ][ k ] == OPD_DEF )
+						in &= ~oregBit( ops[ k ] );
+				for ( int k = 0; k < 3; k++ )
+					if ( vv_opOperands[ inst->op ][ k ] == OPD_USE )
+						in |= oregBit( ops[ k ] );
+			}
+
+			if ( in != live[ i ] )
+			{
+				live[ i ] = in;
+				changed = 1;
+			}
+		}
+	}
+
+	for ( size_t i = 0; i < len; i++ )
+		if ( ( flags[ i ] & OPT_KEEP ) && oisPureDef( code[ i ].op ) &&
+			 !( oliveOut( code, len, live, i ) & oregBit( code[ i ].A ) ) )
+			flags[ i ] &= ~OPT_KEEP;
+}
+
+size_t vv_optimizeCode( vvOpData *code, size_t len, size_t *work )
+{
+	size_t *flags = work, *live = work + len, *map = work + 2 * len;
+	size_t old = len + 1;
+
+	while ( len && len < old )
+	{
+		old = len;
+
+		for ( size_t i = 0; i < len; i++ )
+			if ( vv_isJump( code[ i ].op ) )
+				code[ i ].A = othread( code, len, code[ i ].A );
+
+		oreach( code, len, flags, live );
+		oforward( code, len, flags );
+		odead( code, len, flags, live );
+
+		// the first kept instruction from each one on, where a jump to it goes
+		map[ len ] = len;
+		for ( size_t i = len; i-- > 0; )
+			map[ i ] = flags[ i ] & OPT_KEEP ? i : map[ i + 1 ];
+
+		// a jump to where control goes anyway
+		for ( size_t i = 0; i < len; i++ )
+			if ( ( flags[ i ] & OPT_KEEP ) && vv_isJump( code[ i ].op ) && map[ code[ i ].A ] == map[ i + 1 ] )
+				flags[ i ] &= ~OPT_KEEP;
+
+		size_t cnt = 0;
+
+		for ( size_t i = 0; i < len; i++ )
+		{
+			map[ i ] = cnt;
+			cnt += flags[ i ] & OPT_KEEP;
+		}
+
+		// a jump to a dropped instruction goes on to the next kept one
+		map[ len ] = cnt;
+		cnt = 0;
+
+		for ( size_t i = 0; i < len; i++ )
+		{
+			if ( !( flags[ i ] & OPT_KEEP ) )
+				continue;
+
+			code[ cnt ] = code[ i ];
+			if ( vv_isJump( code[ cnt ].op ) )
+				code[ cnt ].A = map[ code[ cnt ].A ];
+			cnt++;
+		}
+
+		len = cnt;
+	}
+
+	return len;
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#ifndef VV_OPTIMIZE
+#define VV_OPTIMIZE
+
+#include "vvlex.h"
+#include "vvop.h"
+#include "vvparser.h"
+
+/*
+Folds what can be worked out before the program runs, in place. Constant
+operands are combined the way the VM would combine them, in float, and a
+new number goes to the constant pool of tbl. Nothing is folded that would
+fail at run time, a division by 0 or arithmetic on a non-number stays in the
+tree to fail in the VM as it did. Identities like x * 1 only apply when x
+is known to be a number, since the VM checks the operand types of x * 1.
+*/
+void vv_optimizeStatement( vvSyntaxContainer *stmt, vvLexTable *tbl );
+
+/*
+Peephole pass over the code of a function once its registers are allocated,
+in place. Jumps landing on a jump go to where that one goes, code control
+can not get to is dropped, a load of a slot a register still holds becomes a
+move, moves are read through to what they copy, a PUSH right before a POP is
+a move, and the moves and constant loads never read go. Jumps are fixed up
+to the code that is left. Returns its length; work is scratch for 3 * len + 1
+words the caller can keep between calls.
+*/
+size_t vv_optimizeCode( vvOpData *code, size_t len, size_t *work );
+
+#endif
\ No newline at end of file
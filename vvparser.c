@@ -35,6 +35,7 @@ SOFTWARE.
 #include <string.h>
 #include "vvlex.h"
 #include "vvcom.h"
+#include "vvopt.h"
 
 vvParser *vv_newParser( vvLexer *lex )
 {
@@ -44,343 +45,448 @@ vvParser *vv_newParser( vvLexer *lex )
 	rsl->lex = lex;
 	rsl->tkBuf.tt = TT_NONE;
 
+	rsl->arena = NULL;
+
+	rsl->explicitStack = 0;
+	rsl->frames = NULL;
+	rsl->frameCnt = rsl->frameCapacity = 0;
+
+	rsl->tokens = NULL;
+	rsl->tkIdx = rsl->lineIdx = 0;
+
+	rsl->ring = NULL;
+
+	rsl->optimize = 0;
+	rsl->stmts = NULL;
+	rsl->stmtCnt = rsl->stmtCapacity = 0;
+
 	return rsl;
 }
 
-void vv_freeParser( vvParser *p )
+vvParser *vv_newBufferedParser( vvLexer *lex, vvTokenBuffer *tokens )
 {
-	free( p );
+	vvParser *rsl = vv_newParser( lex );
+
+	rsl->tokens = tokens;
+
+	return rsl;
 }
 
-vvSyntaxContainer *vv_newSyntaxContainer( )
+vvParser *vv_newPipelinedParser( vvLexer *lex )
 {
-	vvSyntaxContainer *rsl = ( vvSyntaxContainer * ) malloc( sizeof( vvSyntaxContainer ) );
-	assert( rsl );
+	vvParser *rsl = vv_newParser( lex );
 
-	rsl->st = ST_NONE;
-	rsl->next = NULL;
-	rsl->children[ 0 ] = rsl->children[ 1 ] = rsl->children[ 2 ] = NULL;
+	rsl->ring = vv_newTokenRing( lex );
 
 	return rsl;
 }
 
-void vv_freeSyntaxContainer( vvSyntaxContainer *syn )
+void vv_parserReset( vvParser *p, vvLexer *lex )
 {
-	if ( syn == NULL )
-		return;
+	if ( p->ring )
+		vv_freeTokenRing( p->ring );
 
-	vv_freeSyntaxContainer( syn->children[ 0 ] );
-	vv_freeSyntaxContainer( syn->children[ 1 ] );
-	vv_freeSyntaxContainer( syn->children[ 2 ] );
-	free( syn );
+	// the newest block is the biggest, it is kept for the next input
+	if ( p->arena )
+	{
+		vv_freeSyntaxArena( p->arena->next );
+
+		p->arena->next = NULL;
+		p->arena->used = 0;
+	}
+
+	p->lex = lex;
+	p->tkBuf.tt = TT_NONE;
+
+	p->explicitStack = 0;
+	p->frameCnt = 0;
+	p->optimize = 0;
+
+	p->tokens = NULL;
+	p->tkIdx = p->lineIdx = 0;
+
+	p->ring = NULL;
 }
 
-#define pcurr( ) \
-	( p->tkBuf.tt == TT_NONE ? ( p->tkBuf = vv_lexerRead( p->lex ) ) : ( p->tkBuf ) )
-#define pnext( ) \
-	( p->tkBuf = vv_lexerRead( p->lex ) )
-#define pexpectg( t, msg )                                      \
-	if ( pcurr( ).tt == t )                                     \
-		pnext( );                                               \
-	else                                                        \
-		vv_error( "[%s %zd:%zd] Expected %s, got \"%s\"",       \
-				  p->lex->fileName, p->tkBuf.row, p->tkBuf.col, \
-				  msg, vv_tkToString( p->tkBuf ) );
+void vv_freeParser( vvParser *p )
+{
+	if ( p->ring )
+		vv_freeTokenRing( p->ring );
 
-void parseAssignExpr( vvParser *p, vvSyntaxContainer *rsl );
-void parseDefStmt( vvParser *p, vvSyntaxContainer *rsl );
-void parseWhenStmt( vvParser *p, vvSyntaxContainer *rsl );
-void parseWhileStmt( vvParser *p, vvSyntaxContainer *rsl );
-void parseRetStmt( vvParser *p, vvSyntaxContainer *rsl );
-void parseBlock( vvParser *p, vvSyntaxContainer *rsl );
-void parseExpr( vvParser *p, vvSyntaxContainer *rsl );
-void parseFunExpr( vvParser *p, vvSyntaxContainer *rsl );
-void parseCallExpr( vvParser *p, vvSyntaxContainer *rsl );
+	vv_freeSyntaxArena( p->arena );
+	free( p->frames );
+	free( p->stmts );
+	free( p );
+}
 
-void parseStatement( vvParser *p, vvSyntaxContainer *rsl )
+vvSyntaxContainer *vv_newSyntaxContainer( vvParser *p )
 {
-	vvToken tk = pcurr( );
+	vvSyntaxArena *blk = p->arena;
 
-	while ( 1 )
+	if ( blk == NULL || blk->used == blk->capacity )
 	{
-		switch ( tk.tt )
-		{
-			case TT_EOF:
-				return;
-			case TT_SEMICOLON: {
-				tk = pnext( );
-				continue;
-			}
-			case TT_LBRACE:
-				parseBlock( p, rsl );
-				break;
-			case TT_IDENTIFIER:
-				parseAssignExpr( p, rsl );
-				break;
-			case TT_DEF:
-				parseDefStmt( p, rsl );
-				break;
-			case TT_WHEN:
-				parseWhenStmt( p, rsl );
-				break;
-			case TT_WHILE:
-				parseWhileStmt( p, rsl );
-				break;
-			case TT_RETURN:
-				parseRetStmt( p, rsl );
-				break;
-			case TT_MONEY:
-				parseCallExpr( p, rsl );
-				break;
-			default:
-				vv_error( "[%s %zd:%zd] Unrecognised token", p->lex->fileName, tk.row, tk.col );
-				break;
-		}
-		break;
+		// blocks double up to a limit, so one statement does not pay for a whole file
+		size_t cap = blk ? blk->capacity * 2 : VV_SYNTAX_ARENA_BLOCK;
+
+		if ( cap > VV_SYNTAX_ARENA_BLOCK_MAX )
+			cap = VV_SYNTAX_ARENA_BLOCK_MAX;
+
+		blk = ( vvSyntaxArena * ) malloc( sizeof( vvSyntaxArena ) + cap * sizeof( vvSyntaxContainer ) );
+		assert( blk );
+
+		blk->used = 0;
+		blk->capacity = cap;
+		blk->next = p->arena;
+		p->arena = blk;
 	}
+
+	vvSyntaxContainer *rsl = ( vvSyntaxContainer * ) ( blk + 1 ) + blk->used++;
+
+	rsl->st = ST_NONE;
+	rsl->next = NULL;
+	rsl->children[ 0 ] = rsl->children[ 1 ] = rsl->children[ 2 ] = NULL;
+	rsl->attr.tk = ( vvToken ){ .tt = TT_NONE };
+
+	return rsl;
 }
 
-static int BINARY_PRIORITY[][ 2 ] = {
-	{ TT_MUL, 10 },
-	{ TT_DIV, 10 },
-	{ TT_ADD, 9 },
-	{ TT_MINUS, 9 },
-	{ TT_GE, 8 },
-	{ TT_GT, 8 },
-	{ TT_LE, 8 },
-	{ TT_LT, 8 },
-	{ TT_EQ, 7 },
-	{ TT_NEQ, 7 },
-	{ TT_AND, 6 },
-	{ TT_OR, 5 },
-}; // 12 elements
+vvSyntaxArena *vv_parserTakeArena( vvParser *p )
+{
+	vvSyntaxArena *rsl = p->arena;
 
-#define UNARY_PRIORITY 20
+	p->arena = NULL;
 
-int getPriority( vvTokenType tt )
+	return rsl;
+}
+
+void vv_freeSyntaxArena( vvSyntaxArena *arena )
 {
-	for ( int i = 0; i <= 12; i++ )
+	while ( arena )
 	{
-		if ( BINARY_PRIORITY[ i ][ 0 ] == tt )
-			return BINARY_PRIORITY[ i ][ 1 ];
+		vvSyntaxArena *next = arena->next;
+		free( arena );
+		arena = next;
 	}
-	return 0;
 }
 
-void parsePartExpr( vvParser *p, vvSyntaxContainer *rsl );
-
-void parseArgList( vvParser *p, vvSyntaxContainer *rsl )
+void vv_syntaxEach( vvSyntaxContainer *syn, void ( *fn )( vvSyntaxContainer *, void * ), void *ud )
 {
-	vvSyntaxContainer *start = NULL, *previous = NULL;
+	if ( syn == NULL )
+		return;
 
-	while ( p->tkBuf.tt != TT_RPAREN )
-	{
-		if ( p->tkBuf.tt == TT_EOF )
-			vv_error( "[%s %zd:%zd] Expected ')', got \"EOF\"",
-					  p->lex->fileName, p->tkBuf.row, p->tkBuf.col );
+	// starts out local and moves to the heap, a tree may be nested deeper than the C stack allows
+	vvSyntaxContainer *local[ VV_PARSER_FRAMES_DEFAULT_LEN ];
+	size_t cnt = 0, capacity = VV_PARSER_FRAMES_DEFAULT_LEN;
+	vvSyntaxContainer **stack = local;
 
-		vvSyntaxContainer *arg = vv_newSyntaxContainer( );
-		parseExpr( p, arg );
+	stack[ cnt++ ] = syn;
 
-		if ( start )
-		{
-			previous->next = arg;
-			previous = arg;
-		}
-		else
+	while ( cnt )
+	{
+		syn = stack[ --cnt ];
+		fn( syn, ud );
+
+		if ( cnt + VV_PARSER_MAX_CHILDREN + 1 > capacity )
 		{
-			previous = start = arg;
+			capacity *= 2;
+
+			vvSyntaxContainer **temp = ( vvSyntaxContainer ** ) realloc( stack == local ? NULL : stack, capacity * sizeof( vvSyntaxContainer * ) );
+			assert( temp );
+
+			if ( stack == local )
+				memcpy( temp, local, cnt * sizeof( vvSyntaxContainer * ) );
+
+			stack = temp;
 		}
 
-		if ( pcurr( ).tt != TT_RPAREN )
-			pexpectg( TT_COMMA, "','" );
+		if ( syn->next )
+			stack[ cnt++ ] = syn->next;
+
+		for ( int i = 0; i < VV_PARSER_MAX_CHILDREN; i++ )
+			if ( syn->children[ i ] )
+				stack[ cnt++ ] = syn->children[ i ];
 	}
 
-	rsl->children[ 1 ] = start;
+	if ( stack != local )
+		free( stack );
 }
 
-//primary_expr ::= <value> | '(' part_expr ')' | func_expr | call_expr
-void parsePrimaryExpr( vvParser *p, vvSyntaxContainer *rsl )
+static void tcount( vvSyntaxContainer *syn, void *ud )
 {
-	if ( pcurr( ).tt == TT_EOF )
-		return;
+	size_t *cnt = ( size_t * ) ud;
 
-	vvToken tk = pcurr( );
+	cnt[ 0 ]++;
 
-	if ( tk.tt == TT_LPAREN )
-	{
-		pnext( );
-		parsePartExpr( p, rsl );
-		pexpectg( TT_RPAREN, "')'" );
-	}
-	else if ( tk.tt == TT_LBRACKET )
-	{
-		parseFunExpr( p, rsl );
-	}
-	else if ( tk.tt < TT_BASIC_END || tk.tt == TT_TRUE || tk.tt == TT_FALSE || tk.tt == TT_NIL )
-	{
-		pnext( );
-		rsl->attr.tk = tk;
-		rsl->st = ST_PRIMARY;
-	}
-	else if ( tk.tt == TT_MONEY )
-	{
-		parseCallExpr( p, rsl );
-	}
-	else
-	{
-		vv_error( "[%s %zd:%zd] Unrecognised token", p->lex->fileName, tk.row, tk.col );
-	}
+	if ( syn->attr.tk.tt != TT_NONE )
+		cnt[ 1 ]++;
 }
 
-//tail_part_expr ::= binop part_expr
-int parseTailPartExpr( vvParser *p, vvSyntaxContainer *rsl )
+typedef struct vvFlattenFrame
 {
-	if ( pcurr( ).tt == TT_EOF )
-		return 0;
+	vvSyntaxContainer *syn;
+	vvNode *slot;
+} vvFlattenFrame;
 
-	vvToken cur = pcurr( );
-	int priority = getPriority( cur.tt );
+/*
+Lays out syn and its siblings, each followed by its subtrees, and returns the
+index of syn. Every pending node carries the slot its index goes to; next is
+pushed below the children so the siblings come after the whole subtree.
+*/
+static vvNode tflatten( vvSyntaxTree *tree, vvSyntaxContainer *syn, uint32_t *nodeIdx, uint32_t *tkIdx )
+{
+	vvSyntaxNode *nodes = vv_treeNodes( tree );
+	vvNode first = VV_NODE_NONE;
+
+	if ( syn == NULL )
+		return first;
 
-	if ( priority == 0 )
+	vvFlattenFrame local[ VV_PARSER_FRAMES_DEFAULT_LEN ];
+	size_t cnt = 0, capacity = VV_PARSER_FRAMES_DEFAULT_LEN;
+	vvFlattenFrame *stack = local;
+
+	stack[ cnt++ ] = ( vvFlattenFrame ){ syn, &first };
+
+	while ( cnt )
 	{
-		return 0;
+		vvFlattenFrame f = stack[ --cnt ];
+
+		vvNode idx = *f.slot = ( *nodeIdx )++;
+		vvSyntaxNode *node = &nodes[ idx ];
+
+		syn = f.syn;
+
+		node->st = syn->st;
+		node->tk = VV_NODE_NONE;
+		node->next = VV_NODE_NONE;
+
+		vvToken tk = syn->attr.tk;
+
+		if ( tk.tt != TT_NONE )
+		{
+			uint32_t t = node->tk = ( *tkIdx )++;
+
+			vv_treeTkVals( tree )[ t ] = ( uint32_t ) tk.val;
+			vv_treeTkRows( tree )[ t ] = ( uint32_t ) tk.row;
+			vv_treeTkCols( tree )[ t ] = ( uint32_t ) tk.col;
+			vv_treeTkOffs( tree )[ t ] = ( uint32_t ) tk.span.off;
+			vv_treeTkLens( tree )[ t ] = ( uint32_t ) tk.span.len;
+			vv_treeTkTypes( tree )[ t ] = ( unsigned char ) tk.tt;
+		}
+
+		if ( cnt + VV_PARSER_MAX_CHILDREN + 1 > capacity )
+		{
+			capacity *= 2;
+
+			vvFlattenFrame *temp = ( vvFlattenFrame * ) realloc( stack == local ? NULL : stack, capacity * sizeof( vvFlattenFrame ) );
+			assert( temp );
+
+			if ( stack == local )
+				memcpy( temp, local, cnt * sizeof( vvFlattenFrame ) );
+
+			stack = temp;
+		}
+
+		if ( syn->next )
+			stack[ cnt++ ] = ( vvFlattenFrame ){ syn->next, &node->next };
+
+		for ( int i = VV_PARSER_MAX_CHILDREN - 1; i >= 0; i-- )
+		{
+			node->children[ i ] = VV_NODE_NONE;
+
+			if ( syn->children[ i ] )
+				stack[ cnt++ ] = ( vvFlattenFrame ){ syn->children[ i ], &node->children[ i ] };
+		}
 	}
-	pnext( );
 
-	rsl->children[ 0 ] = vv_newSyntaxContainer( );
-	parsePartExpr( p, rsl->children[ 0 ] );
-	rsl->attr.tk = cur;
+	if ( stack != local )
+		free( stack );
 
-	return priority;
+	return first;
 }
 
-//part_expr ::= unop part_expr
-//			  | primary_expr { binop part_expr }
-void parsePartExpr( vvParser *p, vvSyntaxContainer *rsl )
+vvSyntaxTree *vv_newSyntaxTree( vvSyntaxContainer **stmts, size_t cnt )
 {
-	if ( pcurr( ).tt == TT_EOF )
-		return;
+	size_t counts[ 2 ] = { 0, 0 };
 
-	vvToken cur = pcurr( );
+	for ( size_t i = 0; i < cnt; i++ )
+		vv_syntaxEach( stmts[ i ], tcount, counts );
 
-	if ( cur.tt == TT_NOT || cur.tt == TT_MINUS )
-	{
-		rsl->st = cur.tt == TT_NOT ? ST_NOT_EXPR : ST_INV_EXPR;
-		rsl->children[ 0 ] = vv_newSyntaxContainer( );
-		parsePartExpr( p, rsl->children[ 0 ] );
+	size_t nodeCnt = counts[ 0 ], tkCnt = counts[ 1 ];
 
-		return;
-	}
+	if ( nodeCnt >= VV_NODE_NONE || tkCnt >= VV_NODE_NONE )
+		vv_error( VV_ERR_INTERNAL, NULL, 0, 0, "Too many syntax nodes to flatten" );
 
-	parsePrimaryExpr( p, rsl );
+	size_t size = sizeof( vvSyntaxTree ) + nodeCnt * sizeof( vvSyntaxNode ) +
+				  tkCnt * ( 5 * sizeof( uint32_t ) + sizeof( unsigned char ) );
 
-	vvSyntaxContainer *previous = rsl, *tail = vv_newSyntaxContainer( );
+	vvSyntaxTree *rsl = ( vvSyntaxTree * ) malloc( size );
+	assert( rsl );
 
-	static vvSyntaxContainer *stk[ 10 ];
-	static int stkIdx = 0;
+	rsl->size = size;
+	rsl->nodeCnt = ( uint32_t ) nodeCnt;
+	rsl->tkCnt = ( uint32_t ) tkCnt;
 
-	int priority, lastPriority = 0;
+	uint32_t nodeIdx = 0, tkIdx = 0;
+	vvNode prev = VV_NODE_NONE;
 
-	while ( priority = parseTailPartExpr( p, tail ) )
+	// top-level statements are not linked to each other, chain their roots here
+	for ( size_t i = 0; i < cnt; i++ )
 	{
-		assert( tail );
-		if ( priority >= lastPriority )
-		{
-			previous->next = tail;
-			previous = tail;
-		}
-		else
-		{
-			stk[ stkIdx++ ] = tail;
-		}
+		vvNode root = tflatten( rsl, stmts[ i ], &nodeIdx, &tkIdx );
+
+		if ( root == VV_NODE_NONE )
+			continue;
+		if ( prev != VV_NODE_NONE )
+			vv_treeNodes( rsl )[ prev ].next = root;
 
-		lastPriority = priority;
+		for ( prev = root; vv_treeNodes( rsl )[ prev ].next != VV_NODE_NONE; )
+			prev = vv_treeNodes( rsl )[ prev ].next;
 	}
 
-	for ( ; stkIdx >= 0; stkIdx-- )
-	{
-		previous->next = stk[ stkIdx ];
-		previous = stk[ stkIdx ];
+	return rsl;
+}
 
-		stkIdx--;
-	}
+void vv_freeSyntaxTree( vvSyntaxTree *tree )
+{
+	free( tree );
+}
 
-	stkIdx = 0;
+vvToken vv_treeToken( vvSyntaxTree *tree, uint32_t tk )
+{
+	assert( tk < tree->tkCnt );
+
+	return ( vvToken ){
+		.tt = ( vvTokenType ) vv_treeTkTypes( tree )[ tk ],
+		.val = vv_treeTkVals( tree )[ tk ],
+		.row = vv_treeTkRows( tree )[ tk ],
+		.col = vv_treeTkCols( tree )[ tk ],
+		.span = { vv_treeTkOffs( tree )[ tk ], vv_treeTkLens( tree )[ tk ] },
+	};
 }
 
-//expr ::= part_expr
-void parseExpr( vvParser *p, vvSyntaxContainer *rsl )
+static vvToken pread( vvParser *p )
 {
-	parsePartExpr( p, rsl );
+	vvTokenBuffer *buf = p->tokens;
+
+	if ( p->ring )
+		return vv_tokenRingRead( p->ring );
+	if ( buf == NULL )
+		return vv_lexerRead( p->lex );
+
+	// the buffer ends with TT_EOF, which is handed out again once reached
+	size_t idx = p->tkIdx < buf->len ? p->tkIdx++ : buf->len - 1;
+	uint32_t off = buf->offs[ idx ];
+
+	// tokens arrive in order, so the line cursor only moves forward
+	while ( p->lineIdx + 1 < buf->lineCnt && buf->lineStarts[ p->lineIdx + 1 ] <= off )
+		p->lineIdx++;
+
+	return ( vvToken ){
+		.tt = ( vvTokenType ) buf->types[ idx ],
+		.val = buf->ids[ idx ],
+		.row = buf->lineRows[ p->lineIdx ],
+		.col = off - buf->lineStarts[ p->lineIdx ] + 1,
+		.span = { off, 0 },
+	};
 }
 
-void parseBlock( vvParser *p, vvSyntaxContainer *rsl )
+// type of the n-th token after the current one, only known in buffered mode
+vvTokenType vv_parserPeek( vvParser *p, size_t n )
 {
-	if ( pcurr( ).tt == TT_EOF )
-		return;
+	vvTokenBuffer *buf = p->tokens;
 
-	rsl->st = ST_BLOCK;
+	if ( n == 0 )
+		return p->tkBuf.tt;
+	if ( buf == NULL )
+		return TT_NONE;
 
-	pexpectg( TT_LBRACE, "'{'" );
+	size_t idx = p->tkIdx + n - 1;
 
-	vvSyntaxContainer *start = NULL, *previous = NULL;
+	return ( vvTokenType ) buf->types[ idx < buf->len ? idx : buf->len - 1 ];
+}
 
-	while ( p->tkBuf.tt != TT_RBRACE )
-	{
-		if ( p->tkBuf.tt == TT_EOF )
-			vv_error( "[%s %zd:%zd] Expected '}', got \"EOF\"",
-					  p->lex->fileName, p->tkBuf.row, p->tkBuf.col );
-		vvSyntaxContainer *temp = vv_newSyntaxContainer( );
-		parseStatement( p, temp );
+#define pcurr( ) \
+	( p->tkBuf.tt == TT_NONE ? ( p->tkBuf = pread( p ) ) : ( p->tkBuf ) )
+#define pnext( ) \
+	( p->tkBuf = pread( p ) )
+#define pexpectg( t, msg )                                               \
+	if ( pcurr( ).tt == t )                                              \
+		pnext( );                                                        \
+	else                                                                 \
+		vv_error( VV_ERR_SYNTAX, p->lex->fileName,                       \
+				  p->tkBuf.row, p->tkBuf.col, "Expected %s, got \"%s\"", \
+				  msg, vv_tkToString( p->tkBuf ) );
 
-		if ( start )
-		{
-			previous->next = temp;
-			previous = temp;
-		}
-		else
-		{
-			previous = start = temp;
-		}
-	}
+// binding power and node type of each binary operator, 0 for tokens that are not one
+static const struct
+{
+	unsigned char priority;
+	vvSyntaxType st;
+} BINARY_OPS[ TT_KW_END + 1 ] = {
+	[TT_MUL] = { 10, ST_MUL_EXPR },
+	[TT_DIV] = { 10, ST_DIV_EXPR },
+	[TT_ADD] = { 9, ST_ADD_EXPR },
+	[TT_MINUS] = { 9, ST_SUB_EXPR },
+	[TT_GE] = { 8, ST_GE_EXPR },
+	[TT_GT] = { 8, ST_GT_EXPR },
+	[TT_LE] = { 8, ST_LE_EXPR },
+	[TT_LT] = { 8, ST_LT_EXPR },
+	[TT_EQ] = { 7, ST_EQ_EXPR },
+	[TT_NEQ] = { 7, ST_NEQ_EXPR },
+	[TT_AND] = { 6, ST_AND_EXPR },
+	[TT_OR] = { 5, ST_OR_EXPR },
+};
 
-	rsl->children[ 0 ] = start;
-}
+#define UNARY_PRIORITY 20
 
-void parseAssignExpr( vvParser *p, vvSyntaxContainer *rsl )
+int getPriority( vvTokenType tt )
 {
-	if ( pcurr( ).tt == TT_EOF )
-		return;
+	return tt <= TT_KW_END ? BINARY_OPS[ tt ].priority : 0;
+}
 
-	rsl->st = ST_ASSIGN_EXPR;
+/*
+Each rule is cut into steps that stop where a nested rule begins and return
+the node that rule has to fill, NULL when there is none. The recursive
+functions further down chain the steps through calls, the explicit stack
+mode through vvParseFrames on the heap, so both build the same tree. Like
+before, a rule that starts at the end of the input leaves its node ST_NONE.
+*/
 
+static vvSyntaxContainer *pident( vvParser *p, vvSyntaxContainer *rsl )
+{
 	if ( p->tkBuf.tt != TT_IDENTIFIER )
-		vv_error( "[%s %zd:%zd] Expected IDENTIFIER, got \"%s\"",
-				  p->lex->fileName, p->tkBuf.row, p->tkBuf.col, vv_tkToString( p->tkBuf ) );
+		vv_error( VV_ERR_SYNTAX, p->lex->fileName, p->tkBuf.row, p->tkBuf.col,
+				  "Expected IDENTIFIER, got \"%s\"", vv_tkToString( p->tkBuf ) );
 	rsl->attr.tk = p->tkBuf;
 	pnext( );
 
+	return rsl;
+}
+
+// assign_expr ::= IDENTIFIER ":=" expr
+static vvSyntaxContainer *passignHead( vvParser *p, vvSyntaxContainer *rsl )
+{
+	if ( pcurr( ).tt == TT_EOF )
+		return NULL;
+
+	rsl->st = ST_ASSIGN_EXPR;
+
+	pident( p, rsl );
 	pexpectg( TT_IS, "\":=\"" );
 
-	rsl->children[ 0 ] = vv_newSyntaxContainer( );
-	parseExpr( p, rsl->children[ 0 ] );
+	return rsl->children[ 0 ] = vv_newSyntaxContainer( p );
 }
 
-void parseDefStmt( vvParser *p, vvSyntaxContainer *rsl )
+// def_stmt ::= "def" IDENTIFIER [ ':' "partial" ] ":=" expr
+static vvSyntaxContainer *pdefHead( vvParser *p, vvSyntaxContainer *rsl )
 {
 	if ( pcurr( ).tt == TT_EOF )
-		return;
+		return NULL;
 
 	rsl->st = ST_DEF_STMT;
 
 	pexpectg( TT_DEF, "\"def\"" );
-
-	if ( p->tkBuf.tt != TT_IDENTIFIER )
-		vv_error( "[%s %zd:%zd] Expected IDENTIFIER, got \"%s\"",
-				  p->lex->fileName, p->tkBuf.row, p->tkBuf.col, vv_tkToString( p->tkBuf ) );
-	rsl->attr.tk = p->tkBuf;
-	pnext( );
+	pident( p, rsl );
 
 	if ( pcurr( ).tt == TT_COLON )
 	{
@@ -391,52 +497,50 @@ void parseDefStmt( vvParser *p, vvSyntaxContainer *rsl )
 
 	pexpectg( TT_IS, "\":=\"" );
 
-	rsl->children[ 0 ] = vv_newSyntaxContainer( );
-	parseExpr( p, rsl->children[ 0 ] );
+	return rsl->children[ 0 ] = vv_newSyntaxContainer( p );
 }
 
-void parseWhenStmt( vvParser *p, vvSyntaxContainer *rsl )
+// when_stmt ::= "when" expr block [ ':' block ], returns the condition
+static vvSyntaxContainer *pwhenHead( vvParser *p, vvSyntaxContainer *rsl )
 {
 	if ( pcurr( ).tt == TT_EOF )
-		return;
+		return NULL;
 
 	rsl->st = ST_WHEN_STMT;
 
 	pexpectg( TT_WHEN, "\"when\"" );
 
-	rsl->children[ 0 ] = vv_newSyntaxContainer( );
-	parseExpr( p, rsl->children[ 0 ] );
+	return rsl->children[ 0 ] = vv_newSyntaxContainer( p );
+}
 
-	rsl->children[ 1 ] = vv_newSyntaxContainer( );
-	parseBlock( p, rsl->children[ 1 ] );
+static vvSyntaxContainer *pwhenElse( vvParser *p, vvSyntaxContainer *rsl )
+{
+	if ( pcurr( ).tt != TT_COLON )
+		return NULL;
 
-	if ( pcurr( ).tt == TT_COLON )
-	{
-		rsl->children[ 2 ] = vv_newSyntaxContainer( );
-		parseBlock( p, rsl->children[ 2 ] );
-	}
+	pnext( );
+
+	return rsl->children[ 2 ] = vv_newSyntaxContainer( p );
 }
 
-void parseWhileStmt( vvParser *p, vvSyntaxContainer *rsl )
+// while_stmt ::= "while" expr block, returns the condition
+static vvSyntaxContainer *pwhileHead( vvParser *p, vvSyntaxContainer *rsl )
 {
 	if ( pcurr( ).tt == TT_EOF )
-		return;
+		return NULL;
 
 	rsl->st = ST_WHILE_STMT;
 
 	pexpectg( TT_WHILE, "\"while\"" );
 
-	rsl->children[ 0 ] = vv_newSyntaxContainer( );
-	parseExpr( p, rsl->children[ 0 ] );
-
-	rsl->children[ 1 ] = vv_newSyntaxContainer( );
-	parseBlock( p, rsl->children[ 1 ] );
+	return rsl->children[ 0 ] = vv_newSyntaxContainer( p );
 }
 
-void parseRetStmt( vvParser *p, vvSyntaxContainer *rsl )
+// ret_stmt ::= "return" ( ';' | expr )
+static vvSyntaxContainer *pretHead( vvParser *p, vvSyntaxContainer *rsl )
 {
 	if ( pcurr( ).tt == TT_EOF )
-		return;
+		return NULL;
 
 	rsl->st = ST_RET_STMT;
 
@@ -445,17 +549,17 @@ void parseRetStmt( vvParser *p, vvSyntaxContainer *rsl )
 	if ( pcurr( ).tt == TT_SEMICOLON )
 	{
 		pnext( );
-		return;
+		return NULL;
 	}
 
-	rsl->children[ 0 ] = vv_newSyntaxContainer( );
-	parseExpr( p, rsl->children[ 0 ] );
+	return rsl->children[ 0 ] = vv_newSyntaxContainer( p );
 }
 
-void parseFunExpr( vvParser *p, vvSyntaxContainer *rsl )
+// func_expr ::= '[' ':' { IDENTIFIER ',' } ']' ':' block, returns the body
+static vvSyntaxContainer *pfuncHead( vvParser *p, vvSyntaxContainer *rsl )
 {
 	if ( pcurr( ).tt == TT_EOF )
-		return;
+		return NULL;
 
 	rsl->st = ST_FUNC_EXPR;
 
@@ -467,15 +571,15 @@ void parseFunExpr( vvParser *p, vvSyntaxContainer *rsl )
 	while ( p->tkBuf.tt != TT_RBRACKET )
 	{
 		if ( p->tkBuf.tt == TT_EOF )
-			vv_error( "[%s %zd:%zd] Expected ']', got \"EOF\"",
-					  p->lex->fileName, p->tkBuf.row, p->tkBuf.col );
+			vv_error( VV_ERR_SYNTAX, p->lex->fileName, p->tkBuf.row, p->tkBuf.col,
+					  "Expected ']', got \"EOF\"" );
 		vvToken tk = pcurr( );
 
 		if ( tk.tt != TT_IDENTIFIER )
-			vv_error( "[%s %zd:%zd] Expected \"IDENTIFIER\", got \"%s\"",
-					  p->lex->fileName, p->tkBuf.row, p->tkBuf.col, vv_tkToString( tk ) );
+			vv_error( VV_ERR_SYNTAX, p->lex->fileName, p->tkBuf.row, p->tkBuf.col,
+					  "Expected \"IDENTIFIER\", got \"%s\"", vv_tkToString( tk ) );
 
-		vvSyntaxContainer *arg = vv_newSyntaxContainer( );
+		vvSyntaxContainer *arg = vv_newSyntaxContainer( p );
 		arg->st = ST_ARG_LIST;
 		arg->attr.tk = tk;
 
@@ -498,29 +602,627 @@ void parseFunExpr( vvParser *p, vvSyntaxContainer *rsl )
 
 	rsl->children[ 0 ] = start;
 
-	vvSyntaxContainer *blk = vv_newSyntaxContainer( );
-	parseBlock( p, blk );
-
-	rsl->children[ 1 ] = blk;
+	return rsl->children[ 1 ] = vv_newSyntaxContainer( p );
 }
 
-// call_expr ::= "$" "(" expr arg_list ")"
-void parseCallExpr( vvParser *p, vvSyntaxContainer *rsl )
+// call_expr ::= "$" "(" expr arg_list ")", returns the callee
+static vvSyntaxContainer *pcallHead( vvParser *p, vvSyntaxContainer *rsl )
 {
 	if ( pcurr( ).tt == TT_EOF )
-		return;
+		return NULL;
 
 	rsl->st = ST_CALL_EXPR;
 
 	pexpectg( TT_MONEY, "'$'" );
 	pexpectg( TT_LPAREN, "'('" );
 
-	vvSyntaxContainer *expr = vv_newSyntaxContainer( );
-	parseExpr( p, expr );
-
-	rsl->children[ 0 ] = expr;
-
-	parseArgList( p, rsl );
+	return rsl->children[ 0 ] = vv_newSyntaxContainer( p );
+}
 
-	pexpectg( TT_RPAREN, "')'" );
+// arg_list ::= { ',' expr }, returns the next argument or NULL once ')' is taken
+static vvSyntaxContainer *pcallNext( vvParser *p, vvSyntaxContainer *rsl, vvSyntaxContainer **previous )
+{
+	if ( pcurr( ).tt == TT_RPAREN )
+	{
+		pnext( );
+		return NULL;
+	}
+
+	if ( p->tkBuf.tt == TT_EOF )
+		vv_error( VV_ERR_SYNTAX, p->lex->fileName, p->tkBuf.row, p->tkBuf.col,
+				  "Expected ')', got \"EOF\"" );
+
+	pexpectg( TT_COMMA, "','" );
+
+	vvSyntaxContainer *arg = vv_newSyntaxContainer( p );
+
+	if ( *previous )
+		( *previous )->next = arg;
+	else
+		rsl->children[ 1 ] = arg;
+
+	return *previous = arg;
+}
+
+// block ::= '{' { statement } '}'
+static int pblockHead( vvParser *p, vvSyntaxContainer *rsl )
+{
+	if ( pcurr( ).tt == TT_EOF )
+		return 0;
+
+	rsl->st = ST_BLOCK;
+
+	pexpectg( TT_LBRACE, "'{'" );
+
+	return 1;
+}
+
+// next statement of the block, or NULL once '}' is taken
+static vvSyntaxContainer *pblockNext( vvParser *p, vvSyntaxContainer *rsl, vvSyntaxContainer **previous )
+{
+	// separators between statements, the last one may sit right before '}'
+	while ( pcurr( ).tt == TT_SEMICOLON )
+		pnext( );
+
+	if ( p->tkBuf.tt == TT_RBRACE )
+	{
+		pnext( );
+		return NULL;
+	}
+
+	if ( p->tkBuf.tt == TT_EOF )
+		vv_error( VV_ERR_SYNTAX, p->lex->fileName, p->tkBuf.row, p->tkBuf.col,
+				  "Expected '}', got \"EOF\"" );
+
+	vvSyntaxContainer *stmt = vv_newSyntaxContainer( p );
+
+	if ( *previous )
+		( *previous )->next = stmt;
+	else
+		rsl->children[ 0 ] = stmt;
+
+	return *previous = stmt;
+}
+
+typedef enum vvPrimaryKind
+{
+	PK_DONE,
+	PK_PAREN,
+	PK_FUNC,
+	PK_CALL,
+} vvPrimaryKind;
+
+//primary_expr ::= <value> | '(' expr ')' | func_expr | call_expr
+static vvPrimaryKind pprimary( vvParser *p, vvSyntaxContainer *rsl )
+{
+	if ( pcurr( ).tt == TT_EOF )
+		return PK_DONE;
+
+	vvToken tk = pcurr( );
+
+	if ( tk.tt == TT_LPAREN )
+	{
+		pnext( );
+		return PK_PAREN;
+	}
+	else if ( tk.tt == TT_LBRACKET )
+	{
+		return PK_FUNC;
+	}
+	else if ( tk.tt < TT_BASIC_END || tk.tt == TT_TRUE || tk.tt == TT_FALSE || tk.tt == TT_NIL )
+	{
+		pnext( );
+		rsl->attr.tk = tk;
+		rsl->st = ST_PRIMARY;
+	}
+	else if ( tk.tt == TT_MONEY )
+	{
+		return PK_CALL;
+	}
+	else
+	{
+		vv_error( VV_ERR_SYNTAX, p->lex->fileName, tk.row, tk.col, "Unrecognised token" );
+	}
+
+	return PK_DONE;
+}
+
+//unary_expr ::= unop unary_expr | primary_expr, returns the operand of a unop
+static vvSyntaxContainer *punaryHead( vvParser *p, vvSyntaxContainer *rsl )
+{
+	vvToken cur = pcurr( );
+
+	if ( cur.tt != TT_NOT && cur.tt != TT_MINUS )
+		return NULL;
+
+	pnext( );
+
+	rsl->st = cur.tt == TT_NOT ? ST_NOT_EXPR : ST_INV_EXPR;
+	rsl->attr.tk = cur;
+
+	return rsl->children[ 0 ] = vv_newSyntaxContainer( p );
+}
+
+/*
+Precedence climbing: operators binding tighter than minPriority are folded
+to the left, what was parsed so far becoming the left operand. Returns the
+right operand to parse at *priority, or NULL when the next token stops the
+expression. Only a higher priority on the right nests, so depth is bounded
+by the priority levels and not by the chain length.
+*/
+static vvSyntaxContainer *pbinaryNext( vvParser *p, vvSyntaxContainer *rsl, int minPriority, int *priority )
+{
+	vvToken op = pcurr( );
+
+	*priority = getPriority( op.tt );
+
+	if ( *priority <= minPriority )
+		return NULL;
+
+	pnext( );
+
+	vvSyntaxContainer *lhs = vv_newSyntaxContainer( p );
+	*lhs = *rsl;
+
+	rsl->st = BINARY_OPS[ op.tt ].st;
+	rsl->attr.tk = op;
+	rsl->children[ 0 ] = lhs;
+	rsl->children[ 1 ] = vv_newSyntaxContainer( p );
+	rsl->children[ 2 ] = NULL;
+
+	return rsl->children[ 1 ];
+}
+
+// explicit stack mode: one frame per rule in progress, state says which step is next
+typedef enum vvParseFrameType
+{
+	PF_STATEMENT,
+	PF_BLOCK,
+	PF_WHEN,
+	PF_WHILE,
+	PF_CALL,
+	PF_FUNC,
+	PF_PAREN,
+	PF_UNARY,
+	PF_BINARY,
+} vvParseFrameType;
+
+static void ppush( vvParser *p, vvParseFrameType type, vvSyntaxContainer *node, int priority )
+{
+	if ( p->frameCnt >= p->frameCapacity )
+	{
+		p->frameCapacity = p->frameCapacity ? p->frameCapacity * 2 : VV_PARSER_FRAMES_DEFAULT_LEN;
+
+		vvParseFrame *temp = ( vvParseFrame * ) realloc( p->frames, p->frameCapacity * sizeof( vvParseFrame ) );
+		assert( temp );
+		p->frames = temp;
+	}
+
+	p->frames[ p->frameCnt++ ] = ( vvParseFrame ){
+		.type = ( unsigned char ) type,
+		.state = 0,
+		.priority = priority,
+		.node = node,
+		.previous = NULL,
+	};
+}
+
+// the frame on top turns into another rule for the same node
+static void preplace( vvParser *p, vvParseFrameType type, vvSyntaxContainer *node, int priority )
+{
+	p->frameCnt--;
+	ppush( p, type, node, priority );
+}
+
+// runs the rule pushed last to completion, frames below it belong to the caller
+static void prun( vvParser *p, vvParseFrameType type, vvSyntaxContainer *rsl, int priority )
+{
+	size_t base = p->frameCnt;
+
+	ppush( p, type, rsl, priority );
+
+	while ( p->frameCnt > base )
+	{
+		// f only lives until the next push, which may move the frames
+		vvParseFrame *f = &p->frames[ p->frameCnt - 1 ];
+		vvSyntaxContainer *node = f->node, *next = NULL;
+		int priority;
+
+		switch ( ( vvParseFrameType ) f->type )
+		{
+			case PF_STATEMENT: {
+				vvToken tk = pcurr( );
+
+				while ( tk.tt == TT_SEMICOLON )
+					tk = pnext( );
+
+				switch ( tk.tt )
+				{
+					case TT_EOF:
+						p->frameCnt--;
+						break;
+					case TT_LBRACE:
+						preplace( p, PF_BLOCK, node, 0 );
+						break;
+					case TT_IDENTIFIER:
+					case TT_DEF:
+					case TT_RETURN:
+						if ( tk.tt == TT_IDENTIFIER )
+							next = passignHead( p, node );
+						else if ( tk.tt == TT_DEF )
+							next = pdefHead( p, node );
+						else
+							next = pretHead( p, node );
+
+						// only the expression is left, it takes over the frame
+						if ( next )
+							preplace( p, PF_BINARY, next, 0 );
+						else
+							p->frameCnt--;
+						break;
+					case TT_WHEN:
+						preplace( p, PF_WHEN, node, 0 );
+						break;
+					case TT_WHILE:
+						preplace( p, PF_WHILE, node, 0 );
+						break;
+					case TT_MONEY:
+						preplace( p, PF_CALL, node, 0 );
+						break;
+					default:
+						vv_error( VV_ERR_SYNTAX, p->lex->fileName, tk.row, tk.col, "Unrecognised token" );
+						break;
+				}
+				break;
+			}
+			case PF_BLOCK:
+				if ( f->state == 0 )
+				{
+					f->state = 1;
+
+					if ( !pblockHead( p, node ) )
+						p->frameCnt--;
+				}
+				else if ( ( next = pblockNext( p, node, &f->previous ) ) )
+					ppush( p, PF_STATEMENT, next, 0 );
+				else
+					p->frameCnt--;
+				break;
+			case PF_WHEN:
+			case PF_WHILE:
+				switch ( f->state++ )
+				{
+					case 0:
+						next = f->type == PF_WHEN ? pwhenHead( p, node ) : pwhileHead( p, node );
+
+						if ( next )
+							ppush( p, PF_BINARY, next, 0 );
+						else
+							p->frameCnt--;
+						break;
+					case 1:
+						node->children[ 1 ] = vv_newSyntaxContainer( p );
+						ppush( p, PF_BLOCK, node->children[ 1 ], 0 );
+						break;
+					case 2:
+						if ( f->type == PF_WHEN && ( next = pwhenElse( p, node ) ) )
+							ppush( p, PF_BLOCK, next, 0 );
+						else
+							p->frameCnt--;
+						break;
+					default:
+						p->frameCnt--;
+						break;
+				}
+				break;
+			case PF_CALL:
+				if ( f->state == 0 )
+				{
+					f->state = 1;
+					next = pcallHead( p, node );
+				}
+				else
+				{
+					next = pcallNext( p, node, &f->previous );
+				}
+
+				if ( next )
+					ppush( p, PF_BINARY, next, 0 );
+				else
+					p->frameCnt--;
+				break;
+			case PF_FUNC:
+				if ( ( next = pfuncHead( p, node ) ) )
+					preplace( p, PF_BLOCK, next, 0 );
+				else
+					p->frameCnt--;
+				break;
+			case PF_PAREN:
+				if ( f->state++ == 0 )
+				{
+					ppush( p, PF_BINARY, node, 0 );
+				}
+				else
+				{
+					pexpectg( TT_RPAREN, "')'" );
+					p->frameCnt--;
+				}
+				break;
+			case PF_UNARY:
+				if ( ( next = punaryHead( p, node ) ) )
+				{
+					preplace( p, PF_BINARY, next, UNARY_PRIORITY );
+					break;
+				}
+
+				switch ( pprimary( p, node ) )
+				{
+					case PK_PAREN:
+						preplace( p, PF_PAREN, node, 0 );
+						break;
+					case PK_FUNC:
+						preplace( p, PF_FUNC, node, 0 );
+						break;
+					case PK_CALL:
+						preplace( p, PF_CALL, node, 0 );
+						break;
+					default:
+						p->frameCnt--;
+						break;
+				}
+				break;
+			case PF_BINARY:
+				if ( f->state == 0 )
+				{
+					f->state = 1;
+					ppush( p, PF_UNARY, node, 0 );
+				}
+				else if ( ( next = pbinaryNext( p, node, f->priority, &priority ) ) )
+					ppush( p, PF_BINARY, next, priority );
+				else
+					p->frameCnt--;
+				break;
+		}
+	}
+}
+
+void parseAssignExpr( vvParser *p, vvSyntaxContainer *rsl );
+void parseDefStmt( vvParser *p, vvSyntaxContainer *rsl );
+void parseWhenStmt( vvParser *p, vvSyntaxContainer *rsl );
+void parseWhileStmt( vvParser *p, vvSyntaxContainer *rsl );
+void parseRetStmt( vvParser *p, vvSyntaxContainer *rsl );
+void parseFunExpr( vvParser *p, vvSyntaxContainer *rsl );
+void parseCallExpr( vvParser *p, vvSyntaxContainer *rsl );
+void parseBinaryExpr( vvParser *p, vvSyntaxContainer *rsl, int minPriority );
+
+void parseStatement( vvParser *p, vvSyntaxContainer *rsl )
+{
+	if ( p->explicitStack )
+	{
+		prun( p, PF_STATEMENT, rsl, 0 );
+		return;
+	}
+
+	vvToken tk = pcurr( );
+
+	while ( 1 )
+	{
+		switch ( tk.tt )
+		{
+			case TT_EOF:
+				return;
+			case TT_SEMICOLON: {
+				tk = pnext( );
+				continue;
+			}
+			case TT_LBRACE:
+				parseBlock( p, rsl );
+				break;
+			case TT_IDENTIFIER:
+				parseAssignExpr( p, rsl );
+				break;
+			case TT_DEF:
+				parseDefStmt( p, rsl );
+				break;
+			case TT_WHEN:
+				parseWhenStmt( p, rsl );
+				break;
+			case TT_WHILE:
+				parseWhileStmt( p, rsl );
+				break;
+			case TT_RETURN:
+				parseRetStmt( p, rsl );
+				break;
+			case TT_MONEY:
+				parseCallExpr( p, rsl );
+				break;
+			default:
+				vv_error( VV_ERR_SYNTAX, p->lex->fileName, tk.row, tk.col, "Unrecognised token" );
+				break;
+		}
+		break;
+	}
+}
+
+void parsePrimaryExpr( vvParser *p, vvSyntaxContainer *rsl )
+{
+	switch ( pprimary( p, rsl ) )
+	{
+		case PK_PAREN:
+			parseBinaryExpr( p, rsl, 0 );
+			pexpectg( TT_RPAREN, "')'" );
+			break;
+		case PK_FUNC:
+			parseFunExpr( p, rsl );
+			break;
+		case PK_CALL:
+			parseCallExpr( p, rsl );
+			break;
+		default:
+			break;
+	}
+}
+
+void parseUnaryExpr( vvParser *p, vvSyntaxContainer *rsl )
+{
+	vvSyntaxContainer *operand = punaryHead( p, rsl );
+
+	if ( operand )
+		parseBinaryExpr( p, operand, UNARY_PRIORITY );
+	else
+		parsePrimaryExpr( p, rsl );
+}
+
+void parseBinaryExpr( vvParser *p, vvSyntaxContainer *rsl, int minPriority )
+{
+	vvSyntaxContainer *rhs;
+	int priority;
+
+	parseUnaryExpr( p, rsl );
+
+	while ( ( rhs = pbinaryNext( p, rsl, minPriority, &priority ) ) )
+		parseBinaryExpr( p, rhs, priority );
+}
+
+//expr ::= unary_expr { binop unary_expr }
+void parseExpr( vvParser *p, vvSyntaxContainer *rsl )
+{
+	if ( p->explicitStack )
+		prun( p, PF_BINARY, rsl, 0 );
+	else
+		parseBinaryExpr( p, rsl, 0 );
+}
+
+void parseBlock( vvParser *p, vvSyntaxContainer *rsl )
+{
+	if ( p->explicitStack )
+	{
+		prun( p, PF_BLOCK, rsl, 0 );
+		return;
+	}
+
+	if ( !pblockHead( p, rsl ) )
+		return;
+
+	vvSyntaxContainer *stmt, *previous = NULL;
+
+	while ( ( stmt = pblockNext( p, rsl, &previous ) ) )
+		parseStatement( p, stmt );
+}
+
+void parseAssignExpr( vvParser *p, vvSyntaxContainer *rsl )
+{
+	vvSyntaxContainer *expr = passignHead( p, rsl );
+
+	if ( expr )
+		parseExpr( p, expr );
+}
+
+void parseDefStmt( vvParser *p, vvSyntaxContainer *rsl )
+{
+	vvSyntaxContainer *expr = pdefHead( p, rsl );
+
+	if ( expr )
+		parseExpr( p, expr );
+}
+
+void parseWhenStmt( vvParser *p, vvSyntaxContainer *rsl )
+{
+	vvSyntaxContainer *cond = pwhenHead( p, rsl ), *other;
+
+	if ( cond == NULL )
+		return;
+
+	parseExpr( p, cond );
+
+	rsl->children[ 1 ] = vv_newSyntaxContainer( p );
+	parseBlock( p, rsl->children[ 1 ] );
+
+	if ( ( other = pwhenElse( p, rsl ) ) )
+		parseBlock( p, other );
+}
+
+void parseWhileStmt( vvParser *p, vvSyntaxContainer *rsl )
+{
+	vvSyntaxContainer *cond = pwhileHead( p, rsl );
+
+	if ( cond == NULL )
+		return;
+
+	parseExpr( p, cond );
+
+	rsl->children[ 1 ] = vv_newSyntaxContainer( p );
+	parseBlock( p, rsl->children[ 1 ] );
+}
+
+void parseRetStmt( vvParser *p, vvSyntaxContainer *rsl )
+{
+	vvSyntaxContainer *expr = pretHead( p, rsl );
+
+	if ( expr )
+		parseExpr( p, expr );
+}
+
+void parseFunExpr( vvParser *p, vvSyntaxContainer *rsl )
+{
+	vvSyntaxContainer *body = pfuncHead( p, rsl );
+
+	if ( body )
+		parseBlock( p, body );
+}
+
+void parseCallExpr( vvParser *p, vvSyntaxContainer *rsl )
+{
+	vvSyntaxContainer *arg = pcallHead( p, rsl ), *previous = NULL;
+
+	if ( arg == NULL )
+		return;
+
+	parseExpr( p, arg );
+
+	while ( ( arg = pcallNext( p, rsl, &previous ) ) )
+		parseExpr( p, arg );
+}
+
+static void pmodule( void *ud )
+{
+	vvParser *p = ( vvParser * ) ud;
+
+	while ( pcurr( ).tt != TT_EOF )
+	{
+		vvSyntaxContainer *stmt = vv_newSyntaxContainer( p );
+		parseStatement( p, stmt );
+
+		if ( p->optimize )
+			vv_optimizeStatement( stmt, p->lex->tbl );
+
+		while ( pcurr( ).tt == TT_SEMICOLON )
+			pnext( );
+
+		if ( p->stmtCnt >= p->stmtCapacity )
+		{
+			p->stmtCapacity = p->stmtCapacity ? p->stmtCapacity * 2 : VV_PARSER_STMTS_DEFAULT_LEN;
+
+			vvSyntaxContainer **temp = ( vvSyntaxContainer ** ) realloc( p->stmts, p->stmtCapacity * sizeof( vvSyntaxContainer * ) );
+			assert( temp );
+			p->stmts = temp;
+		}
+
+		p->stmts[ p->stmtCnt++ ] = stmt;
+	}
+}
+
+vvResult vv_parseModule( vvParser *p, vvSyntaxTree **tree, vvError *err )
+{
+	p->stmtCnt = 0;
+
+	vvResult rsl = vv_try( err, pmodule, p );
+
+	// an explicit-stack parse leaves its frames behind when it unwinds
+	if ( rsl != VV_OK )
+		p->frameCnt = 0;
+
+	*tree = rsl == VV_OK ? vv_newSyntaxTree( p->stmts, p->stmtCnt ) : NULL;
+
+	return rsl;
 }
\ No newline at end of file
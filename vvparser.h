@@ -85,19 +85,118 @@ typedef struct vvSyntaxContainer
 	} attr;
 } vvSyntaxContainer;
 
+typedef uint32_t vvNode;
+
+#define VV_NODE_NONE UINT32_MAX
+
+// vvSyntaxContainer with indices in place of pointers
+typedef struct vvSyntaxNode
+{
+	uint32_t st;
+	// index into the token arrays, VV_NODE_NONE if the node holds none
+	uint32_t tk;
+
+	vvNode next;
+	vvNode children[ VV_PARSER_MAX_CHILDREN ];
+} vvSyntaxNode;
+
+/*
+A parsed module in one allocation of size bytes: the header, the nodes in
+depth first order, then the token payloads as separate arrays. Nothing in it
+is a pointer, so a copy or a file dump is a single memcpy / fwrite. The
+statements are chained through next starting at node 0.
+*/
+typedef struct vvSyntaxTree
+{
+	uint64_t size;
+	uint32_t nodeCnt, tkCnt;
+} vvSyntaxTree;
+
+#define vv_treeNodes( t ) ( ( vvSyntaxNode * ) ( ( t ) + 1 ) )
+#define vv_treeTkVals( t ) ( ( uint32_t * ) ( vv_treeNodes( t ) + ( t )->nodeCnt ) )
+#define vv_treeTkRows( t ) ( vv_treeTkVals( t ) + ( t )->tkCnt )
+#define vv_treeTkCols( t ) ( vv_treeTkRows( t ) + ( t )->tkCnt )
+#define vv_treeTkOffs( t ) ( vv_treeTkCols( t ) + ( t )->tkCnt )
+#define vv_treeTkLens( t ) ( vv_treeTkOffs( t ) + ( t )->tkCnt )
+#define vv_treeTkTypes( t ) ( ( unsigned char * ) ( vv_treeTkLens( t ) + ( t )->tkCnt ) )
+
+#define VV_SYNTAX_ARENA_BLOCK 32
+#define VV_SYNTAX_ARENA_BLOCK_MAX 4096
+
+// nodes sit in a chain of blocks in the order they were made and are released together
+typedef struct vvSyntaxArena
+{
+	struct vvSyntaxArena *next;
+	size_t used, capacity;
+} vvSyntaxArena;
+
+#define VV_PARSER_FRAMES_DEFAULT_LEN 64
+#define VV_PARSER_STMTS_DEFAULT_LEN 64
+
+// a grammar rule in progress when parsing with an explicit stack
+typedef struct vvParseFrame
+{
+	unsigned char type, state;
+	int priority;
+	vvSyntaxContainer *node, *previous;
+} vvParseFrame;
+
 typedef struct vvParser
 {
 	vvLexer *lex;
 	vvToken tkBuf;
+
+	vvSyntaxArena *arena;
+
+	// set to keep pending rules in frames instead of on the C stack, nesting
+	// depth is then only limited by memory
+	int explicitStack;
+	vvParseFrame *frames;
+	size_t frameCnt, frameCapacity;
+
+	// set when reading from a pre-lexed buffer instead of the lexer
+	vvTokenBuffer *tokens;
+	size_t tkIdx, lineIdx;
+
+	// set when the lexer runs ahead on a thread of its own
+	vvTokenRing *ring;
+
+	// set to have vv_parseModule run vv_optimizeStatement on every statement
+	int optimize;
+
+	// the top-level statements of vv_parseModule, kept for the next module
+	vvSyntaxContainer **stmts;
+	size_t stmtCnt, stmtCapacity;
 } vvParser;
 
+// inputs from this size on are worth a lexer thread, given a spare core
+#define VV_PIPELINE_MIN_LEN ( 1 << 20 )
+
 vvParser *vv_newParser( vvLexer *lex );
+vvParser *vv_newBufferedParser( vvLexer *lex, vvTokenBuffer *tokens );
+// lexes on another thread while parsing, lex must outlive the parser
+vvParser *vv_newPipelinedParser( vvLexer *lex );
+vvTokenType vv_parserPeek( vvParser *p, size_t n );
+// as vv_newParser( lex ) would leave it, keeping a node block and the frames; the nodes made so far are released
+void vv_parserReset( vvParser *p, vvLexer *lex );
+// also releases every node the parser made
 void vv_freeParser( vvParser *p );
-vvSyntaxContainer *vv_newSyntaxContainer( );
-void vv_freeSyntaxContainer( vvSyntaxContainer *syn );
+vvSyntaxContainer *vv_newSyntaxContainer( vvParser *p );
+// hands the nodes made so far to the caller, they then outlive the parser
+vvSyntaxArena *vv_parserTakeArena( vvParser *p );
+void vv_freeSyntaxArena( vvSyntaxArena *arena );
+
+// flattens the statements, and everything hanging off them, in order
+vvSyntaxTree *vv_newSyntaxTree( vvSyntaxContainer **stmts, size_t cnt );
+void vv_freeSyntaxTree( vvSyntaxTree *tree );
+vvToken vv_treeToken( vvSyntaxTree *tree, uint32_t tk );
+// calls fn on syn, its siblings and everything below them, in no particular order
+void vv_syntaxEach( vvSyntaxContainer *syn, void ( *fn )( vvSyntaxContainer *, void * ), void *ud );
 
 void parseStatement( vvParser *p, vvSyntaxContainer *rsl );
 void parseBlock( vvParser *p, vvSyntaxContainer *rsl );
 void parseExpr( vvParser *p, vvSyntaxContainer *rsl );
+// parses what is left of the input and flattens it into *tree, the nodes stay with the parser
+vvResult vv_parseModule( vvParser *p, vvSyntaxTree **tree, vvError *err );
 
 #endif
\ No newline at end of file
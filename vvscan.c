@@ -0,0 +1,247 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "vvscan.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#define VV_SCAN_WIDTH 32
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define VV_SCAN_WIDTH 16
+#endif
+
+// scalar line counting, pend is the break that may still pair with the next byte
+static const char *countLines( const char *p, const char *end, size_t *cnt, char *pend, const char **line )
+{
+	for ( ; p < end; p++ )
+	{
+		char c = *p;
+
+		if ( c == '\r' || c == '\n' )
+		{
+			if ( *pend && *pend != c )
+				*pend = 0;
+			else
+				( *cnt )++, *pend = c;
+
+			*line = p + 1;
+		}
+		else
+		{
+			*pend = 0;
+		}
+	}
+
+	return p;
+}
+
+#ifdef VV_SCAN_WIDTH
+
+#ifdef _MSC_VER
+#include <intrin.h>
+
+static unsigned ctz( uint32_t x )
+{
+	unsigned long idx;
+	_BitScanForward( &idx, x );
+	return ( unsigned ) idx;
+}
+
+static unsigned clz( uint32_t x )
+{
+	unsigned long idx;
+	_BitScanReverse( &idx, x );
+	return 31 - ( unsigned ) idx;
+}
+
+#define popcnt( x ) __popcnt( x )
+#else
+#define ctz( x ) ( ( unsigned ) __builtin_ctz( x ) )
+#define clz( x ) ( ( unsigned ) __builtin_clz( x ) )
+#define popcnt( x ) ( ( unsigned ) __builtin_popcount( x ) )
+#endif
+
+#if VV_SCAN_WIDTH == 32
+typedef __m256i vvVec;
+
+#define vload( p ) _mm256_load_si256( ( const __m256i * ) ( p ) )
+#define vloadu( p ) _mm256_loadu_si256( ( const __m256i * ) ( p ) )
+#define vmask( v ) ( ( uint32_t ) _mm256_movemask_epi8( v ) )
+#define veq( x, c ) _mm256_cmpeq_epi8( x, _mm256_set1_epi8( c ) )
+#define vor( a, b ) _mm256_or_si256( a, b )
+#define VV_SCAN_FULL 0xFFFFFFFFu
+#else
+typedef __m128i vvVec;
+
+#define vload( p ) _mm_load_si128( ( const __m128i * ) ( p ) )
+#define vloadu( p ) _mm_loadu_si128( ( const __m128i * ) ( p ) )
+#define vmask( v ) ( ( uint32_t ) _mm_movemask_epi8( v ) )
+#define veq( x, c ) _mm_cmpeq_epi8( x, _mm_set1_epi8( c ) )
+#define vor( a, b ) _mm_or_si128( a, b )
+#define VV_SCAN_FULL 0xFFFFu
+#endif
+
+#define maskSpace( x ) vmask( vor( vor( veq( x, ' ' ), veq( x, '\t' ) ), vor( veq( x, '\r' ), veq( x, '\n' ) ) ) )
+#define maskLineEnd( x ) vmask( vor( vor( veq( x, '\r' ), veq( x, '\n' ) ), veq( x, '\0' ) ) )
+
+#define notSpace( x ) ( ~maskSpace( x ) & VV_SCAN_FULL )
+
+/*
+Past the terminator the aligned loads read bytes that belong to no object,
+which address sanitizers report; the kernels opt out of that instrumentation.
+*/
+#if defined( __GNUC__ )
+#define VV_SCAN_UNCHECKED __attribute__( ( no_sanitize_address ) )
+#else
+#define VV_SCAN_UNCHECKED
+#endif
+
+#define unaligned( p ) ( ( uintptr_t ) ( p ) & ( VV_SCAN_WIDTH - 1 ) )
+
+#define isSpace( c ) ( ( c ) == ' ' || ( c ) == '\t' || ( c ) == '\r' || ( c ) == '\n' )
+#define isLineEnd( c ) ( ( c ) == '\r' || ( c ) == '\n' || ( c ) == '\0' )
+
+// bytes up to the first aligned block one at a time, then aligned blocks until STOP has a bit set
+#define SCAN_KERNEL( name, HEAD, STOP )                  \
+	VV_SCAN_UNCHECKED const char *name( const char *p ) \
+	{                                                    \
+		for ( ; unaligned( p ); p++ )                    \
+			if ( HEAD( *p ) )                            \
+				return p;                                \
+                                                         \
+		for ( ;; p += VV_SCAN_WIDTH )                    \
+		{                                                \
+			uint32_t m = STOP( vload( p ) );             \
+                                                         \
+			if ( m )                                     \
+				return p + ctz( m );                     \
+		}                                                \
+	}
+
+SCAN_KERNEL( vv_scanSpace, !isSpace, notSpace )
+SCAN_KERNEL( vv_scanLineEnd, isLineEnd, maskLineEnd )
+
+VV_SCAN_UNCHECKED const char *vv_scanBlockEnd( const char *p )
+{
+	uint32_t carry = 0;
+
+	// a "##" starting in the head is found here, so no '#' carries into the first block
+	for ( ; unaligned( p ); p++ )
+		if ( *p == '\0' || ( p[ 0 ] == '#' && p[ 1 ] == '#' ) )
+			return p;
+
+	for ( ;; p += VV_SCAN_WIDTH )
+	{
+		vvVec x = vload( p );
+		uint32_t hash = vmask( veq( x, '#' ) ), zero = vmask( veq( x, '\0' ) );
+
+		// a '#' closing the previous block pairs with a leading '#' here
+		if ( carry && ( hash & 1 ) )
+			return p - 1;
+
+		uint32_t stop = ( hash & ( hash >> 1 ) ) | zero;
+
+		if ( stop )
+			return p + ctz( stop );
+
+		carry = hash >> ( VV_SCAN_WIDTH - 1 );
+	}
+}
+
+size_t vv_scanLines( const char *p, const char *end, const char **line )
+{
+	size_t cnt = 0;
+	char pend = 0;
+
+	*line = p;
+
+	while ( end - p >= VV_SCAN_WIDTH )
+	{
+		vvVec x = vloadu( p );
+		uint32_t lf = vmask( veq( x, '\n' ) ), cr = vmask( veq( x, '\r' ) );
+
+		if ( cr )
+		{
+			p = countLines( p, p + VV_SCAN_WIDTH, &cnt, &pend, line );
+			continue;
+		}
+
+		if ( lf )
+		{
+			// a leading '\n' closes the "\r\n" pair left open by the previous block
+			cnt += popcnt( lf ) - ( pend == '\r' && ( lf & 1 ) );
+			*line = p + ( 32 - clz( lf ) );
+		}
+
+		pend = p[ VV_SCAN_WIDTH - 1 ] == '\n' ? '\n' : 0;
+		p += VV_SCAN_WIDTH;
+	}
+
+	countLines( p, end, &cnt, &pend, line );
+
+	return cnt;
+}
+
+#else
+
+const char *vv_scanSpace( const char *p )
+{
+	while ( *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' )
+		p++;
+
+	return p;
+}
+
+const char *vv_scanLineEnd( const char *p )
+{
+	while ( *p != '\r' && *p != '\n' && *p != '\0' )
+		p++;
+
+	return p;
+}
+
+const char *vv_scanBlockEnd( const char *p )
+{
+	while ( *p != '\0' && !( p[ 0 ] == '#' && p[ 1 ] == '#' ) )
+		p++;
+
+	return p;
+}
+
+size_t vv_scanLines( const char *p, const char *end, const char **line )
+{
+	size_t cnt = 0;
+	char pend = 0;
+
+	*line = p;
+	countLines( p, end, &cnt, &pend, line );
+
+	return cnt;
+}
+
+#endif
\ No newline at end of file
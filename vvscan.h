@@ -0,0 +1,52 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#ifndef VV_SCAN
+#define VV_SCAN
+
+#include <stdlib.h>
+
+/*
+Scanning kernels for the lexer. They work on NUL terminated input and stop at
+the terminator at the latest. The vector versions step to an alignment
+boundary a byte at a time and only issue aligned loads from there, which read
+at most to the end of the block holding the terminator and so never cross
+into a page it does not live in. Those loads are outside the input as far as
+C goes, so the kernels are built without address sanitizing.
+*/
+
+// first byte that is not ' ', '\t', '\r' or '\n'
+const char *vv_scanSpace( const char *p );
+// first '\r', '\n' or NUL
+const char *vv_scanLineEnd( const char *p );
+// first "##" or NUL
+const char *vv_scanBlockEnd( const char *p );
+
+// line breaks in [ p, end ), a "\r\n" or "\n\r" pair counting once;
+// *line receives the first byte after the last break
+size_t vv_scanLines( const char *p, const char *end, const char **line );
+
+#endif
\ No newline at end of file
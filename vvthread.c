@@ -0,0 +1,343 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "vvthread.h"
+#include "vvcom.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+typedef struct vvThreadStart
+{
+	vvThreadMain fn;
+	void *ud;
+} vvThreadStart;
+
+#ifdef _WIN32
+static DWORD WINAPI threadEntry( LPVOID arg )
+#else
+static void *threadEntry( void *arg )
+#endif
+{
+	vvThreadStart start = *( vvThreadStart * ) arg;
+	free( arg );
+
+	start.fn( start.ud );
+
+	return 0;
+}
+
+void vv_threadStart( vvThread *th, vvThreadMain fn, void *ud )
+{
+	vvThreadStart *start = ( vvThreadStart * ) malloc( sizeof( vvThreadStart ) );
+	assert( start );
+
+	start->fn = fn;
+	start->ud = ud;
+
+#ifdef _WIN32
+	*th = CreateThread( NULL, 0, threadEntry, start, 0, NULL );
+	if ( !*th )
+		vv_error( VV_ERR_INTERNAL, NULL, 0, 0, "Can't start a thread" );
+#else
+	if ( pthread_create( th, NULL, threadEntry, start ) )
+		vv_error( VV_ERR_INTERNAL, NULL, 0, 0, "Can't start a thread" );
+#endif
+}
+
+void vv_threadJoin( vvThread th )
+{
+#ifdef _WIN32
+	WaitForSingleObject( th, INFINITE );
+	CloseHandle( th );
+#else
+	pthread_join( th, NULL );
+#endif
+}
+
+size_t vv_cpuCount( )
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+
+	return info.dwNumberOfProcessors;
+#else
+	long n = sysconf( _SC_NPROCESSORS_ONLN );
+
+	return n > 0 ? ( size_t ) n : 1;
+#endif
+}
+
+#ifdef _WIN32
+// an aligned word is read and written whole, the fences keep it in order
+size_t vv_atomicLoad( volatile size_t *ptr )
+{
+	MemoryBarrier( );
+	size_t rsl = *ptr;
+	MemoryBarrier( );
+
+	return rsl;
+}
+
+void vv_atomicStore( volatile size_t *ptr, size_t val )
+{
+	MemoryBarrier( );
+	*ptr = val;
+	MemoryBarrier( );
+}
+
+static BOOL CALLBACK tonce( PINIT_ONCE once, PVOID fn, PVOID *ctx )
+{
+	( void ) once;
+	( void ) ctx;
+
+	( ( void ( * )( ) ) fn )( );
+
+	return TRUE;
+}
+
+void vv_once( vvOnce *once, void ( *fn )( ) )
+{
+	InitOnceExecuteOnce( once, tonce, ( PVOID ) fn, NULL );
+}
+#else
+size_t vv_atomicLoad( volatile size_t *ptr )
+{
+	return __atomic_load_n( ptr, __ATOMIC_SEQ_CST );
+}
+
+void vv_atomicStore( volatile size_t *ptr, size_t val )
+{
+	__atomic_store_n( ptr, val, __ATOMIC_SEQ_CST );
+}
+
+void vv_once( vvOnce *once, void ( *fn )( ) )
+{
+	pthread_once( once, fn );
+}
+#endif
+
+#ifdef _WIN32
+void vv_mutexInit( vvMutex *mtx )
+{
+	InitializeCriticalSection( mtx );
+}
+
+void vv_mutexLock( vvMutex *mtx )
+{
+	EnterCriticalSection( mtx );
+}
+
+void vv_mutexUnlock( vvMutex *mtx )
+{
+	LeaveCriticalSection( mtx );
+}
+
+void vv_mutexDestroy( vvMutex *mtx )
+{
+	DeleteCriticalSection( mtx );
+}
+
+void vv_condInit( vvCond *cnd )
+{
+	InitializeConditionVariable( cnd );
+}
+
+void vv_condWait( vvCond *cnd, vvMutex *mtx )
+{
+	SleepConditionVariableCS( cnd, mtx, INFINITE );
+}
+
+void vv_condSignal( vvCond *cnd )
+{
+	WakeConditionVariable( cnd );
+}
+
+void vv_condBroadcast( vvCond *cnd )
+{
+	WakeAllConditionVariable( cnd );
+}
+
+void vv_condDestroy( vvCond *cnd )
+{
+	( void ) cnd;
+}
+#else
+void vv_mutexInit( vvMutex *mtx )
+{
+	pthread_mutex_init( mtx, NULL );
+}
+
+void vv_mutexLock( vvMutex *mtx )
+{
+	pthread_mutex_lock( mtx );
+}
+
+void vv_mutexUnlock( vvMutex *mtx )
+{
+	pthread_mutex_unlock( mtx );
+}
+
+void vv_mutexDestroy( vvMutex *mtx )
+{
+	pthread_mutex_destroy( mtx );
+}
+
+void vv_condInit( vvCond *cnd )
+{
+	pthread_cond_init( cnd, NULL );
+}
+
+void vv_condWait( vvCond *cnd, vvMutex *mtx )
+{
+	pthread_cond_wait( cnd, mtx );
+}
+
+void vv_condSignal( vvCond *cnd )
+{
+	pthread_cond_signal( cnd );
+}
+
+void vv_condBroadcast( vvCond *cnd )
+{
+	pthread_cond_broadcast( cnd );
+}
+
+void vv_condDestroy( vvCond *cnd )
+{
+	pthread_cond_destroy( cnd );
+}
+#endif
+
+// takes indices of the current task until none are left, called with the lock held
+static void poolDrain( vvPool *pool )
+{
+	while ( pool->next < pool->count )
+	{
+		size_t idx = pool->next++;
+
+		vv_mutexUnlock( &pool->lock );
+		pool->task( pool->ctx, idx );
+		vv_mutexLock( &pool->lock );
+
+		if ( --pool->pending == 0 )
+			vv_condBroadcast( &pool->done );
+	}
+}
+
+static void poolWorker( void *ud )
+{
+	vvPool *pool = ( vvPool * ) ud;
+
+	vv_mutexLock( &pool->lock );
+
+	for ( ;; )
+	{
+		while ( !pool->quit && pool->next >= pool->count )
+			vv_condWait( &pool->work, &pool->lock );
+
+		if ( pool->quit )
+			break;
+
+		poolDrain( pool );
+	}
+
+	vv_mutexUnlock( &pool->lock );
+}
+
+vvPool *vv_newPool( size_t threads )
+{
+	vvPool *rsl = ( vvPool * ) malloc( sizeof( vvPool ) );
+	assert( rsl );
+
+	if ( threads == 0 )
+		threads = vv_cpuCount( ) - 1;
+
+	rsl->size = threads;
+	rsl->task = NULL;
+	rsl->ctx = NULL;
+	rsl->count = rsl->next = rsl->pending = 0;
+	rsl->quit = 0;
+
+	vv_mutexInit( &rsl->lock );
+	vv_condInit( &rsl->work );
+	vv_condInit( &rsl->done );
+
+	rsl->workers = ( vvThread * ) malloc( ( threads ? threads : 1 ) * sizeof( vvThread ) );
+	assert( rsl->workers );
+
+	for ( size_t i = 0; i < threads; i++ )
+		vv_threadStart( &rsl->workers[ i ], poolWorker, rsl );
+
+	return rsl;
+}
+
+void vv_freePool( vvPool *pool )
+{
+	vv_mutexLock( &pool->lock );
+	pool->quit = 1;
+	vv_condBroadcast( &pool->work );
+	vv_mutexUnlock( &pool->lock );
+
+	for ( size_t i = 0; i < pool->size; i++ )
+		vv_threadJoin( pool->workers[ i ] );
+
+	vv_condDestroy( &pool->done );
+	vv_condDestroy( &pool->work );
+	vv_mutexDestroy( &pool->lock );
+
+	free( pool->workers );
+	free( pool );
+}
+
+void vv_poolRun( vvPool *pool, vvPoolTask task, void *ctx, size_t count )
+{
+	if ( count == 0 )
+		return;
+
+	vv_mutexLock( &pool->lock );
+
+	pool->task = task;
+	pool->ctx = ctx;
+	pool->count = count;
+	pool->next = 0;
+	pool->pending = count;
+
+	vv_condBroadcast( &pool->work );
+
+	poolDrain( pool );
+
+	while ( pool->pending )
+		vv_condWait( &pool->done, &pool->lock );
+
+	pool->count = pool->next = 0;
+
+	vv_mutexUnlock( &pool->lock );
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+/*
+MIT License
+
+Copyright (c) 2022 Cluck
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#ifndef VV_THREAD
+#define VV_THREAD
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef HANDLE vvThread;
+typedef CRITICAL_SECTION vvMutex;
+typedef CONDITION_VARIABLE vvCond;
+typedef INIT_ONCE vvOnce;
+
+#define VV_ONCE_INIT INIT_ONCE_STATIC_INIT
+#else
+#include <pthread.h>
+
+typedef pthread_t vvThread;
+typedef pthread_mutex_t vvMutex;
+typedef pthread_cond_t vvCond;
+typedef pthread_once_t vvOnce;
+
+#define VV_ONCE_INIT PTHREAD_ONCE_INIT
+#endif
+
+#ifdef _WIN32
+#define VV_THREAD_LOCAL __declspec( thread )
+#else
+#define VV_THREAD_LOCAL __thread
+#endif
+
+typedef void ( *vvThreadMain )( void *ud );
+
+void vv_threadStart( vvThread *th, vvThreadMain fn, void *ud );
+void vv_threadJoin( vvThread th );
+size_t vv_cpuCount( );
+
+void vv_mutexInit( vvMutex *mtx );
+void vv_mutexLock( vvMutex *mtx );
+void vv_mutexUnlock( vvMutex *mtx );
+void vv_mutexDestroy( vvMutex *mtx );
+
+// sequentially consistent load and store of a word shared between threads
+size_t vv_atomicLoad( volatile size_t *ptr );
+void vv_atomicStore( volatile size_t *ptr, size_t val );
+
+// runs fn the first time it is called with once, later calls wait for that run to finish
+void vv_once( vvOnce *once, void ( *fn )( ) );
+
+void vv_condInit( vvCond *cnd );
+void vv_condWait( vvCond *cnd, vvMutex *mtx );
+void vv_condSignal( vvCond *cnd );
+void vv_condBroadcast( vvCond *cnd );
+void vv_condDestroy( vvCond *cnd );
+
+// runs task( ctx, i ) once for every i in [ 0, count )
+typedef void ( *vvPoolTask )( void *ctx, size_t idx );
+
+/*
+Fixed set of worker threads running one task at a time. vv_poolRun hands
+out the indices and returns when all of them have finished; the calling
+thread works on them too, so a pool of size 0 simply runs everything inline.
+*/
+typedef struct vvPool
+{
+	size_t size;
+	vvThread *workers;
+
+	vvMutex lock;
+	vvCond work, done;
+
+	vvPoolTask task;
+	void *ctx;
+	size_t count, next, pending;
+	int quit;
+} vvPool;
+
+// threads == 0 picks one thread per core besides the caller
+vvPool *vv_newPool( size_t threads );
+void vv_freePool( vvPool *pool );
+void vv_poolRun( vvPool *pool, vvPoolTask task, void *ctx, size_t count );
+
+#endif
\ No newline at end of file
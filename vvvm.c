@@ -56,7 +56,7 @@ size_t vv_callFramePush( vvCallFrame *frame, vvValue *val )
 {
 	if ( frame->top >= frame->len )
 	{
-		frame->len++;
+		frame->len = frame->len ? frame->len * 2 : 4;
 
 		vvValue *temp = ( vvValue * ) realloc( frame->stk, sizeof( vvValue ) * frame->len );
 		assert( temp );
@@ -76,7 +76,7 @@ vvValue *vv_callFramePop( vvCallFrame *frame )
 		return NULL;
 	}
 
-	return &frame->stk[ frame->top-- ];
+	return &frame->stk[ --frame->top ];
 }
 
 vvCallStack *vv_newCallStack( )
@@ -88,24 +88,30 @@ vvCallStack *vv_newCallStack( )
 	rsl->frames = ( vvCallFrame * ) calloc( 1, sizeof( vvCallFrame ) );
 	assert( rsl->frames );
 
+	rsl->loc = NULL;
+	rsl->locTop = rsl->locLen = 0;
+
 	return rsl;
 }
 
+// top is the running frame, frame 0 is the one of the entry function
 size_t vv_callStackPush( vvCallStack *stk, vvCallFrame frame )
 {
-	if ( stk->top >= stk->len )
+	if ( stk->top + 1 >= stk->len )
 	{
-		stk->len++;
+		size_t len = stk->len * 2;
 
-		vvCallFrame *temp = ( vvCallFrame * ) realloc( stk->frames, sizeof( vvCallFrame ) * stk->len );
+		vvCallFrame *temp = ( vvCallFrame * ) realloc( stk->frames, sizeof( vvCallFrame ) * len );
 		assert( temp );
 
+		memset( temp + stk->len, 0, sizeof( vvCallFrame ) * ( len - stk->len ) );
 		stk->frames = temp;
+		stk->len = len;
 	}
 
-	stk->frames[ stk->top ] = frame;
+	stk->frames[ ++stk->top ] = frame;
 
-	return stk->top++;
+	return stk->top;
 }
 
 void vv_callStackPop( vvCallStack *stk )
@@ -115,7 +121,35 @@ void vv_callStackPop( vvCallStack *stk )
 		return;
 	}
 
-	free( stk->frames[ stk->top-- ].stk );
+	free( stk->frames[ stk->top ].stk );
+	stk->frames[ stk->top-- ].stk = NULL;
+}
+
+// the running frame gets len locals, all nil
+void vv_callStackLocals( vvCallStack *stk, size_t len )
+{
+	vvCallFrame *frame = &stk->frames[ stk->top ];
+	size_t top = frame->base + len;
+
+	if ( top > stk->locLen )
+	{
+		size_t locLen = stk->locLen ? stk->locLen : 16;
+
+		while ( locLen < top )
+			locLen *= 2;
+
+		vvValue *temp = ( vvValue * ) realloc( stk->loc, sizeof( vvValue ) * locLen );
+		assert( temp );
+
+		stk->loc = temp;
+		stk->locLen = locLen;
+	}
+
+	// loc is still NULL while no frame has had locals
+	if ( len )
+		memset( stk->loc + frame->base, 0, sizeof( vvValue ) * len );
+
+	stk->locTop = top;
 }
 
 void vv_freeCallStack( vvCallStack *stk )
@@ -125,6 +159,7 @@ void vv_freeCallStack( vvCallStack *stk )
 		free( stk->frames[ i ].stk );
 	}
 	free( stk->frames );
+	free( stk->loc );
 	free( stk );
 }
 
@@ -144,38 +179,15 @@ vvValue *expandMemory( vvValue *mem, size_t len )
 	return temp;
 }
 
-const extern vvValue
-	TRUE_VAL = {
-		.vt = VAL_BOOL,
-		.val.cst_val = 1,
-	},
-	FALSE_VAL = {
-		.vt = VAL_BOOL,
-		.val.cst_val = 0,
-	},
-	NIL_VAL = {
-		.vt = VAL_NIL,
-		.val.cst_val = 0,
-	};
-
-size_t vv_valueEqual( vvValue *A, vvValue *B )
-{
-	if ( A->vt != B->vt )
-		return 0;
-	return A->val.cst_val == B->val.cst_val || A->val.num_val == B->val.num_val;
-}
-
-vvValue vv_valueToBool( vvValue *A )
+// grows the memory section to at least len slots, the new ones hold nil
+void vv_reserveMemory( vvVM *vm, size_t len )
 {
-	size_t rsl = 1;
-
-	if ( A->vt == VAL_NIL || A->vt == VAL_BOOL && A->val.cst_val == 0 )
-		rsl = 0;
+	if ( VV_REGISTER_COUNT + len <= vm->memLen )
+		return;
 
-	return ( vvValue ){
-		.vt = VAL_BOOL,
-		.val.cst_val = rsl,
-	};
+	vm->mem = expandMemory( vm->mem, len );
+	memset( vm->mem + vm->memLen, 0, sizeof( vvValue ) * ( VV_REGISTER_COUNT + len - vm->memLen ) );
+	vm->memLen = VV_REGISTER_COUNT + len;
 }
 
 vvVM *vv_newVM( char *fn, vvLexTable *tbl )
@@ -242,12 +254,13 @@ int vv_VMStep( vvVM *vm, vvOpData inst )
 	vvValue *mem = vm->mem;
 	vvCallFrame *frame = &vm->stk->frames[ vm->stk->top ];
 	size_t A = inst.A, B = inst.B, C = inst.C;
+	// A may be B or C, operands are read before the type of A is set
+	size_t rsl;
 
 	if ( inst.op >= OP_GE )
-		if ( mem[ A ].vt != VAL_NUMBER || mem[ B ].vt != VAL_NUMBER )
-			vv_error( "[%s %zd:%zd] Attempt to perform arithmetic on non-numbers",
-					  vm->fn,
-					  inst.info[ 0 ], inst.info[ 1 ] );
+		if ( mem[ B ].vt != VAL_NUMBER || mem[ C ].vt != VAL_NUMBER )
+			vv_error( VV_ERR_RUNTIME, vm->fn, inst.info[ 0 ], inst.info[ 1 ],
+					  "Attempt to perform arithmetic on non-numbers" );
 
 	switch ( inst.op )
 	{
@@ -259,62 +272,114 @@ int vv_VMStep( vvVM *vm, vvOpData inst )
 		case OP_LOAD:
 			mem[ A ] = mem[ B + VV_REGISTER_COUNT ];
 			break;
+		case OP_STOREL:
+			vm->stk->loc[ frame->base + A ] = mem[ B ];
+			break;
+		case OP_LOADL:
+			mem[ A ] = vm->stk->loc[ frame->base + B ];
+			break;
 		case OP_MOV:
 			mem[ A ] = mem[ B ];
 			break;
+		case OP_LOADK:
+			if ( B < VV_CONST_BUILTINS )
+				mem[ A ] = B == 0 ? TRUE_VAL : B == 1 ? FALSE_VAL : NIL_VAL;
+			else
+				mem[ A ] = vv_constValue( vv_lexTableConst( vm->tbl, B - VV_CONST_BUILTINS ) );
+			break;
+		case OP_LOADS:
+			mem[ A ].vt = VAL_STRING;
+			mem[ A ].val.cst_val = B;
+			break;
+		case OP_LOADF:
+			mem[ A ].vt = VAL_FUNCTION;
+			mem[ A ].val.cst_val = B;
+			break;
 		case OP_PUSH:
 			vv_callFramePush( frame, &mem[ A ] );
 			break;
+		// arguments a call left out are nil
 		case OP_POP:
-			mem[ A ] = *vv_callFramePop( frame );
+		{
+			vvValue *val = vv_callFramePop( frame );
+			mem[ A ] = val ? *val : NIL_VAL;
 			break;
+		}
 		case OP_PEEK:
-			mem[ A ] = frame->stk[ frame->top ];
+			mem[ A ] = frame->stk[ frame->top - 1 ];
 			break;
 		case OP_DUP:
-			vv_callFramePush( frame, &frame->stk[ frame->top ] );
+			vv_callFramePush( frame, &frame->stk[ frame->top - 1 ] );
 			break;
+		// A holds the function, the B arguments move to its frame with the first one on top
 		case OP_CALL:
-			vv_callStackPush( vm->stk,
-							  vv_newCallFrame(
-								  frame->from.adr,
-								  frame->from.func,
-								  0,
-								  A ) );
+		{
+			if ( mem[ A ].vt != VAL_FUNCTION || mem[ A ].val.cst_val >= vm->len ||
+				 vm->insts[ mem[ A ].val.cst_val ] == NULL )
+				vv_error( VV_ERR_RUNTIME, vm->fn, inst.info[ 0 ], inst.info[ 1 ],
+						  "Attempt to call a non-function" );
+
+			size_t func = mem[ A ].val.cst_val;
+
+			vv_callStackPush( vm->stk, vv_newCallFrame( vm->idx.adr, vm->idx.func, 0, func ) );
+			vm->stk->frames[ vm->stk->top ].base = vm->stk->locTop;
+			// the push may have moved the frames
+			frame = &vm->stk->frames[ vm->stk->top - 1 ];
+
 			for ( ; B; B-- )
 			{
 				vv_callFramePush( &vm->stk->frames[ vm->stk->top ], vv_callFramePop( frame ) );
 			}
-			break;
+
+			vm->idx = ( vvCallInfo ){ 0, func };
+			return VM_JUMP;
+		}
+		// back after the CALL with A values pushed to the caller
 		case OP_LEAV:
+			if ( vm->stk->top == 0 )
+				return VM_HALT;
+
 			for ( ; A; A-- )
 			{
-				vv_callFramePush( &vm->stk->frames[ vm->stk->top - 1 ], vv_callFramePop( &vm->stk->frames[ vm->stk->top ] ) );
+				vv_callFramePush( &vm->stk->frames[ vm->stk->top - 1 ], vv_callFramePop( frame ) );
 			}
+			vm->idx = frame->from;
+			vm->stk->locTop = frame->base;
 			vv_callStackPop( vm->stk );
 			break;
+		case OP_FRAME:
+			vv_callStackLocals( vm->stk, A );
+			break;
 		case OP_JMP:
 			vm->idx.adr = A;
-			break;
+			return VM_JUMP;
 		case OP_JMPT:
 			if ( vv_valueToBool( &mem[ B ] ).val.cst_val )
+			{
 				vm->idx.adr = A;
+				return VM_JUMP;
+			}
 			break;
 		case OP_JMPF:
 			if ( !vv_valueToBool( &mem[ B ] ).val.cst_val )
+			{
 				vm->idx.adr = A;
+				return VM_JUMP;
+			}
 			break;
 		case OP_NOT:
 			mem[ A ] = vv_valueToBool( &mem[ B ] );
 			mem[ A ].val.cst_val = !mem[ A ].val.cst_val;
 			break;
 		case OP_EQ:
+			rsl = vv_valueEqual( &mem[ B ], &mem[ C ] );
 			mem[ A ].vt = VAL_BOOL;
-			mem[ A ].val.cst_val = vv_valueEqual( &mem[ B ], &mem[ C ] );
+			mem[ A ].val.cst_val = rsl;
 			break;
 		case OP_NEQ:
+			rsl = !vv_valueEqual( &mem[ B ], &mem[ C ] );
 			mem[ A ].vt = VAL_BOOL;
-			mem[ A ].val.cst_val = !vv_valueEqual( &mem[ B ], &mem[ C ] );
+			mem[ A ].val.cst_val = rsl;
 			break;
 		case OP_GE:
 			mem[ A ].vt = VAL_BOOL;
@@ -333,20 +398,21 @@ int vv_VMStep( vvVM *vm, vvOpData inst )
 			mem[ A ].val.cst_val = mem[ B ].val.num_val < mem[ C ].val.num_val;
 			break;
 		case OP_AND:
+			rsl = vv_valueToBool( &mem[ B ] ).val.cst_val &&
+				  vv_valueToBool( &mem[ C ] ).val.cst_val;
 			mem[ A ].vt = VAL_BOOL;
-			mem[ A ].val.cst_val = vv_valueToBool( &mem[ B ] ).val.cst_val &&
-								   vv_valueToBool( &mem[ C ] ).val.cst_val;
+			mem[ A ].val.cst_val = rsl;
 			break;
 		case OP_OR:
+			rsl = vv_valueToBool( &mem[ B ] ).val.cst_val ||
+				  vv_valueToBool( &mem[ C ] ).val.cst_val;
 			mem[ A ].vt = VAL_BOOL;
-			mem[ A ].val.cst_val = vv_valueToBool( &mem[ B ] ).val.cst_val ||
-								   vv_valueToBool( &mem[ C ] ).val.cst_val;
+			mem[ A ].val.cst_val = rsl;
 			break;
 		case OP_INV:
 			if ( mem[ B ].vt != VAL_NUMBER )
-				vv_error( "[%s %zd:%zd] Attempt to perform arithmetic on non-numbers",
-						  vm->fn,
-						  inst.info[ 0 ], inst.info[ 1 ] );
+				vv_error( VV_ERR_RUNTIME, vm->fn, inst.info[ 0 ], inst.info[ 1 ],
+						  "Attempt to perform arithmetic on non-numbers" );
 			mem[ A ].vt = VAL_NUMBER;
 			mem[ A ].val.num_val = -mem[ B ].val.num_val;
 			break;
@@ -364,9 +430,8 @@ int vv_VMStep( vvVM *vm, vvOpData inst )
 			break;
 		case OP_DIV:
 			if ( mem[ C ].val.num_val == 0. )
-				vv_error( "[%s %zd:%zd] Attempt to divide with 0",
-						  vm->fn,
-						  inst.info[ 0 ], inst.info[ 1 ] );
+				vv_error( VV_ERR_RUNTIME, vm->fn, inst.info[ 0 ], inst.info[ 1 ],
+						  "Attempt to divide with 0" );
 			mem[ A ].vt = VAL_NUMBER;
 			mem[ A ].val.num_val = mem[ B ].val.num_val / mem[ C ].val.num_val;
 			break;
@@ -375,18 +440,28 @@ int vv_VMStep( vvVM *vm, vvOpData inst )
 	return VM_NEXT;
 }
 
-void vv_VMExecute( vvVM *vm )
+static void vmrun( void *ud )
 {
+	vvVM *vm = ( vvVM * ) ud;
 	int flag;
-	vvOpData curr = vm->insts[ vm->idx.func ][ vm->idx.adr ];
 
-	while ( flag = vv_VMStep( vm, curr ) )
-		curr = vm->insts[ vm->idx.func ][ ++vm->idx.adr ];
+	while ( ( flag = vv_VMStep( vm, vm->insts[ vm->idx.func ][ vm->idx.adr ] ) ) )
+		if ( flag == VM_NEXT )
+			vm->idx.adr++;
+}
+
+vvResult vv_VMExecute( vvVM *vm, vvError *err )
+{
+	return vv_try( err, vmrun, vm );
 }
 
 void vv_freeVM( vvVM *vm )
 {
 	free( vm->mem );
 	vv_freeCallStack( vm->stk );
+
+	for ( size_t i = 0; i < vm->len; i++ )
+		free( vm->insts[ i ] );
 	free( vm->insts );
+	free( vm );
 }
\ No newline at end of file
@@ -34,41 +34,30 @@ typedef struct vvCallInfo
 	size_t adr, func;
 } vvCallInfo;
 
-typedef enum vvValueType
-{
-	VAL_NIL,
-	VAL_BOOL,
-	VAL_NUMBER,
-	VAL_STRING,
-	VAL_FUNCTION,
-} vvValueType;
-
-typedef struct vvValue
-{
-	vvValueType vt;
-
-	union
-	{
-		size_t cst_val; // NIL BOOL STRING FUNCTION
-		float num_val;	// NUMBER
-	} val;
-} vvValue;
-
 typedef struct vvCallFrame
 {
 	vvCallInfo from, to;
 
 	vvValue *stk;
 	size_t top, len;
+
+	// first of its locals in the local stack
+	size_t base;
 } vvCallFrame;
 
 typedef struct vvCallStack
 {
 	vvCallFrame *frames;
 	size_t top, len;
+
+	// the locals of all frames, a callee's come after the ones of its caller
+	vvValue *loc;
+	size_t locTop, locLen;
 } vvCallStack;
 
+#ifndef VV_REGISTER_COUNT
 #define VV_REGISTER_COUNT 8
+#endif
 
 typedef struct vvVM
 {
@@ -85,16 +74,20 @@ typedef struct vvVM
 	vvLexTable *tbl;
 } vvVM;
 
+#define VM_JUMP 2
 #define VM_NEXT 1
 #define VM_HALT 0
 
-const extern vvValue TRUE_VAL, FALSE_VAL, NIL_VAL;
-
+// the VM takes dat, it is freed with the VM or by vv_removeFunction
 size_t vv_addFunction( vvVM *vm, vvOpData *dat );
 void vv_removeFunction( vvVM *vm, size_t idx );
 
-vvVM *vv_newVM( );
-void vv_VMExecute( vvVM *vm );
+vvVM *vv_newVM( char *fn, vvLexTable *tbl );
+void vv_reserveMemory( vvVM *vm, size_t len );
+// runs inst, vm->idx.adr is for the caller to move on when it gives VM_NEXT, errors go through vv_error
+int vv_VMStep( vvVM *vm, vvOpData inst );
+// stops at the first runtime error, vm->idx is left on the failed instruction
+vvResult vv_VMExecute( vvVM *vm, vvError *err );
 void vv_freeVM( vvVM *vm );
 
 #endif
\ No newline at end of file